@@ -0,0 +1,14 @@
+#version 330 core
+out vec4 FragColor;
+
+in float Shade;
+
+// Every instance in a draw is the same color
+uniform vec3 color;
+
+void main()
+{
+	FragColor = vec4(color * Shade, 1.0f);
+}
+
+// vim: set ft=glsl:
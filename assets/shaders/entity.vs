@@ -0,0 +1,20 @@
+#version 330 core
+// Unit cube standing on the origin, see src/instancing.c
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+// Model matrix, one per instance, or set once per draw without instancing
+layout (location = 2) in mat4 aModel;
+
+out float Shade;
+
+uniform mat4 viewProjection;
+
+void main() {
+	gl_Position = viewProjection * aModel * vec4(aPos, 1.0f);
+
+	// Lit from above and to one side, so the faces of a box stand apart
+	vec3 light = normalize(vec3(0.4f, 1.0f, 0.3f));
+	Shade = 0.55f + 0.45f * max(dot(aNormal, light), 0.0f);
+}
+
+// vim: set ft=glsl:
@@ -2,12 +2,16 @@
 out vec4 FragColor;
 
 in vec2 TexCoord;
+in float Light;
+flat in uint Tile;
 
-uniform sampler2D grass;
+// One layer per block tile
+uniform sampler2DArray blocks;
 
 void main()
 {
-	FragColor = texture(grass, TexCoord);
+	vec4 color = texture(blocks, vec3(TexCoord, float(Tile)));
+	FragColor = vec4(color.rgb * Light, color.a);
 }
 
 // vim: set ft=glsl:
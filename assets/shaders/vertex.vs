@@ -1,17 +1,43 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 aTexCoord;
+// Packed chunk vertex, see src/vertex.h
+// x: x:5 y:5 z:5 normal:3 ao:2 sky:4 block:4
+// y: tile:16
+layout (location = 0) in uvec2 aData;
+// World position of the chunk, one per draw
+layout (location = 1) in vec3 aOrigin;
 
 out vec2 TexCoord;
+out float Light;
+flat out uint Tile;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
 
 void main() {
-	gl_Position = projection * view * model * vec4(aPos, 1.0f);
-	TexCoord = vec2(aTexCoord.x, aTexCoord.y);
+	vec3 aPos = vec3(aData.x & 31u, (aData.x >> 5u) & 31u, (aData.x >> 10u) & 31u);
+	uint axis = ((aData.x >> 15u) & 7u) / 2u;
+
+	gl_Position = projection * view * vec4(aOrigin + aPos, 1.0f);
+	Tile = aData.y & 65535u;
+
+	// Each level is 80% as bright as the one above it
+	uint sky = (aData.x >> 20u) & 15u;
+	uint block = (aData.x >> 24u) & 15u;
+	Light = pow(0.8f, 15.0f - float(max(sky, block)));
+
+	// Corners next to opaque blocks go down to half as bright
+	float ao = float((aData.x >> 18u) & 3u);
+	Light *= 0.5f + ao / 6.0f;
+
+	// Textures are upright on the sides and follow x/z on top and bottom
+	if (axis == 0u) {
+		TexCoord = aPos.zy;
+	} else if (axis == 1u) {
+		TexCoord = aPos.xz;
+	} else {
+		TexCoord = aPos.xy;
+	}
 }
 
 // vim: set ft=glsl:
@@ -0,0 +1,532 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <glad/glad.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "entity.h"
+#include "headless.h"
+#include "profiler.h"
+#include "scene.h"
+#include "scenes.h"
+#include "timer.h"
+
+#define BENCH_WIDTH 1280
+#define BENCH_HEIGHT 720
+
+#define DEFAULT_OUTPUT "bench.json"
+
+// Regressions smaller than this many percent are treated as noise
+#define DEFAULT_THRESHOLD 10.0
+
+// Frames drawn after the rest with one draw per entity, to compare against
+#define PER_DRAW_FRAMES 60
+
+// Values this small are timer noise, any change to them is meaningless
+#define NOISE_FLOOR 0.01
+
+typedef struct Metric {
+  char name[64];
+  double value;
+} Metric;
+
+// Every metric is lower is better, so they can all be compared the same way
+typedef struct Results {
+  Metric *metrics;
+  size_t count, capacity;
+} Results;
+
+static void addMetric(Results *results, const char *scene, const char *name,
+                      double value) {
+  if (results->count == results->capacity) {
+    results->capacity = results->capacity ? results->capacity * 2 : 64;
+    results->metrics =
+        realloc(results->metrics, results->capacity * sizeof(Metric));
+  }
+
+  Metric *metric = &results->metrics[results->count++];
+  snprintf(metric->name, sizeof(metric->name), "%s.%s", scene, name);
+  metric->value = value;
+}
+
+static void addPercentiles(Results *results, const char *scene,
+                           const char *name, const double *values,
+                           size_t count, double scale) {
+  const double ranks[] = {50.0, 95.0, 99.0};
+  for (int i = 0; i < 3; i++) {
+    char metric[48];
+    snprintf(metric, sizeof(metric), "%s_p%.0f", name, ranks[i]);
+    addMetric(results, scene, metric,
+              benchPercentile(values, count, ranks[i]) * scale);
+  }
+}
+
+// Highest resident memory of the whole process so far
+static double peakMemoryMB(void) {
+#ifdef _WIN32
+  return 0.0;
+#else
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+  return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+static void benchCamera(const BenchScene *benchScene, const Scene *scene,
+                        double time, float eye[3], float target[3]) {
+  if (benchScene->path != NULL) {
+    cameraPathAt(benchScene->path, benchScene->pathLength, time, eye, target);
+  } else {
+    orbitCamera(scene, time, eye, target);
+  }
+}
+
+// Cycles through placing stone on the ground, taking it away, placing a
+// lamp and taking that away, each time at a new spot around the target
+typedef struct Editor {
+  uint32_t random;
+  int step;
+  int x, y, z;
+} Editor;
+
+static void editBlock(Editor *editor, Scene *scene, const float target[3],
+                      int radius) {
+  int step = editor->step++ % 4;
+  if (step == 0 || step == 2) {
+    int top = scene->config.worldHeight * CHUNK_SIZE - 1;
+    for (int tries = 0; tries < 16; tries++) {
+      editor->random = editor->random * 1664525u + 1013904223u;
+      int x = (int)target[0] + (int)(editor->random >> 8) % (2 * radius + 1) -
+              radius;
+      int z = (int)target[2] + (int)(editor->random >> 20) % (2 * radius + 1) -
+              radius;
+
+      // On top of the highest block, if there is room above it
+      int y = top;
+      while (y >= 0 && worldGetBlock(scene->world, x, y, z) == BLOCK_AIR) {
+        y--;
+      }
+      if (y >= 0 && y < top) {
+        editor->x = x;
+        editor->y = y + 1;
+        editor->z = z;
+        break;
+      }
+    }
+  }
+
+  BlockId placed = step == 0 ? BLOCK_STONE : BLOCK_LAMP;
+  sceneSetBlock(scene, editor->x, editor->y, editor->z,
+                step % 2 == 0 ? placed : BLOCK_AIR);
+}
+
+// A tenth are mobs standing on the ground, the rest particles hanging still
+// in the air above it
+static void spawnEntities(EntityStore *entities, const Scene *scene,
+                          int count, uint32_t random) {
+  int size = scene->config.worldSize * CHUNK_SIZE;
+  int top = scene->config.worldHeight * CHUNK_SIZE - 1;
+  for (int i = 0; i < count; i++) {
+    bool mob = i % 10 == 0;
+    EntityId entity = createEntity(
+        entities, mob ? COMPONENT_POSITION | COMPONENT_VELOCITY |
+                            COMPONENT_BOX | COMPONENT_TRANSFORM
+                      : COMPONENT_POSITION | COMPONENT_TRANSFORM);
+
+    random = random * 1664525u + 1013904223u;
+    int x = (int)(random >> 8) % size, z = (int)(random >> 20) % size;
+    int y = top;
+    while (y > 0 && worldGetBlock(scene->world, x, y, z) == BLOCK_AIR) {
+      y--;
+    }
+
+    float position[3] = {x + 0.5f, y + 1.0f, z + 0.5f};
+    if (mob) {
+      entitySetBox(entities, entity, 0.3f, 1.8f, 1.0f);
+    } else {
+      position[1] += (float)(random & 15u);
+      entitySetScale(entities, entity, 0.1f);
+    }
+    entitySetPosition(entities, entity, position);
+  }
+}
+
+static void drawEntities(Scene *scene, const EntityStore *entities,
+                         const float eye[3], const float target[3]) {
+  const float boxColor[3] = {0.8f, 0.45f, 0.3f};
+  const float particleColor[3] = {1.0f, 0.9f, 0.5f};
+
+  instanceRendererFrame(&scene->instances);
+  for (int a = 0; a < entities->archetypeCount; a++) {
+    const Archetype *archetype = &entities->archetypes[a];
+    if (archetype->mask & COMPONENT_TRANSFORM) {
+      sceneRenderInstances(
+          scene, eye, target, (const float(*)[16])archetype->transform,
+          archetype->count,
+          archetype->mask & COMPONENT_BOX ? boxColor : particleColor);
+    }
+  }
+}
+
+static void runScene(const BenchScene *benchScene, int frames,
+                     Results *results) {
+  printf("%s: %dx%dx%d chunks, view distance %d, seed %u, %d frames\n",
+         benchScene->name, benchScene->worldSize, benchScene->worldHeight,
+         benchScene->worldSize, benchScene->viewDistance, benchScene->seed,
+         frames);
+
+  // Never saved, so every run generates the same world. Bounded worlds are
+  // loaded whole, from anywhere along the paths
+  SceneConfig config = {benchScene->seed, benchScene->viewDistance,
+                        benchScene->worldSize, benchScene->worldHeight, NULL};
+  if (config.viewDistance == 0) {
+    config.viewDistance = 2 * config.worldSize;
+  }
+  Scene *scene = createScene(&config, BENCH_WIDTH, BENCH_HEIGHT);
+
+  float eye[3], target[3];
+  benchCamera(benchScene, scene, 0.0, eye, target);
+  double loadStart = timerNow();
+  while (!sceneLoaded(scene)) {
+    sceneUpdate(scene, eye, target);
+  }
+  glFinish();
+  double loadTime = timerNow() - loadStart;
+
+  double *frameTimes = malloc((size_t)frames * sizeof(double));
+  double *gpuTimes = malloc((size_t)frames * sizeof(double));
+  double *editTimes = malloc((size_t)frames * sizeof(double));
+  size_t gpuTimeCount = 0, editCount = 0;
+  size_t triangles = 0;
+  Editor editor = {benchScene->seed, 0, 0, 0, 0};
+
+  EntityStore entities;
+  initEntityStore(&entities);
+  spawnEntities(&entities, scene, benchScene->entities, benchScene->seed);
+  double *submitTimes = malloc((size_t)frames * sizeof(double));
+  size_t entityDrawCalls = 0;
+
+  for (int i = 0; i < frames; i++) {
+    double start = timerNow();
+
+    // Fixed timestep, so every run draws the same frames. Streaming scenes
+    // still differ in when chunks arrive
+    benchCamera(benchScene, scene, i * HEADLESS_FRAME_STEP, eye, target);
+
+    // From setting the block to every mesh it changed being uploaded, so
+    // it's drawn this frame
+    if (benchScene->editRadius > 0) {
+      double editStart = timerNow();
+      editBlock(&editor, scene, target, benchScene->editRadius);
+      sceneFlushEdits(scene);
+      editTimes[editCount++] = timerNow() - editStart;
+    }
+
+    sceneUpdate(scene, eye, target);
+    sceneRender(scene, eye, target);
+    if (benchScene->entities > 0) {
+      moveSystem(&entities, (float)HEADLESS_FRAME_STEP);
+      physicsSystem(&entities, scene->world, (float)HEADLESS_FRAME_STEP);
+      transformSystem(&entities);
+      drawEntities(scene, &entities, eye, target);
+      submitTimes[i] = scene->instances.stats.submitSeconds;
+      entityDrawCalls += scene->instances.stats.drawCalls;
+    }
+    glFinish();
+    frameTimes[i] = timerNow() - start;
+    triangles += scene->chunkRenderer.stats.triangles;
+
+    // GPU results arrive a few frames late
+    gpuTimersFrame(&scene->gpuTimers);
+    if (i >= GPU_TIMER_FRAMES) {
+      gpuTimes[gpuTimeCount++] = scene->gpuTimers.lastFrameTime;
+    }
+    profileFrame();
+  }
+
+  // The same entities again, drawn one at a time
+  double perDrawSubmit[PER_DRAW_FRAMES];
+  size_t perDrawCalls = 0;
+  if (benchScene->entities > 0) {
+    scene->instances.instanced = false;
+    for (int i = 0; i < PER_DRAW_FRAMES; i++) {
+      sceneRender(scene, eye, target);
+      drawEntities(scene, &entities, eye, target);
+      glFinish();
+      perDrawSubmit[i] = scene->instances.stats.submitSeconds;
+      perDrawCalls += scene->instances.stats.drawCalls;
+      gpuTimersFrame(&scene->gpuTimers);
+    }
+    scene->instances.instanced = true;
+  }
+
+  size_t worldBytes = 0, iter = 0;
+  Chunk *chunk;
+  while ((chunk = worldNextChunk(scene->world, &iter)) != NULL) {
+    worldBytes += chunkMemoryUsage(chunk);
+  }
+
+  GpuArenaStats memory;
+  gpuArenaStats(&scene->chunkRenderer.arena, &memory);
+
+  const char *name = benchScene->name;
+  addMetric(results, name, "load_ms", loadTime * 1000.0);
+  addPercentiles(results, name, "mesh_us", scene->meshTimes,
+                 scene->meshTimeCount, 1e6);
+  addPercentiles(results, name, "frame_ms", frameTimes, (size_t)frames,
+                 1000.0);
+  addPercentiles(results, name, "gpu_ms", gpuTimes, gpuTimeCount, 1000.0);
+  if (editCount > 0) {
+    addPercentiles(results, name, "edit_ms", editTimes, editCount, 1000.0);
+    addMetric(results, name, "chunks_meshed_per_edit",
+              (double)scene->editsMeshed / editCount);
+  }
+  if (benchScene->entities > 0) {
+    addPercentiles(results, name, "entity_submit_ms", submitTimes,
+                   (size_t)frames, 1000.0);
+    addMetric(results, name, "entity_draw_calls",
+              (double)entityDrawCalls / frames);
+    addPercentiles(results, name, "entity_per_draw_submit_ms", perDrawSubmit,
+                   PER_DRAW_FRAMES, 1000.0);
+    addMetric(results, name, "entity_per_draw_calls",
+              (double)perDrawCalls / PER_DRAW_FRAMES);
+  }
+  addMetric(results, name, "triangles_per_frame",
+            (double)triangles / frames);
+  addMetric(results, name, "mesh_memory_peak_mb",
+            memory.peakUsed / (1024.0 * 1024.0));
+  addMetric(results, name, "world_memory_mb", worldBytes / (1024.0 * 1024.0));
+
+  printf("  load %.1f ms, frame p50 %.2f ms p99 %.2f ms\n", loadTime * 1000.0,
+         benchPercentile(frameTimes, (size_t)frames, 50.0) * 1000.0,
+         benchPercentile(frameTimes, (size_t)frames, 99.0) * 1000.0);
+  if (editCount > 0) {
+    printf("  edit to drawn p50 %.2f ms p99 %.2f ms, %.1f chunks meshed per "
+           "edit\n",
+           benchPercentile(editTimes, editCount, 50.0) * 1000.0,
+           benchPercentile(editTimes, editCount, 99.0) * 1000.0,
+           (double)scene->editsMeshed / editCount);
+  }
+  if (benchScene->entities > 0) {
+    printf("  %d entities, submit p50 %.3f ms in %.0f draw calls, %.3f ms "
+           "in %.0f drawn one at a time\n",
+           benchScene->entities,
+           benchPercentile(submitTimes, (size_t)frames, 50.0) * 1000.0,
+           (double)entityDrawCalls / frames,
+           benchPercentile(perDrawSubmit, PER_DRAW_FRAMES, 50.0) * 1000.0,
+           (double)perDrawCalls / PER_DRAW_FRAMES);
+  }
+
+  freeEntityStore(&entities);
+  free(submitTimes);
+  free(frameTimes);
+  free(editTimes);
+  free(gpuTimes);
+  destroyScene(scene);
+}
+
+static bool writeResults(const Results *results, const char *path) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    printf("Failed to open %s\n", path);
+    return false;
+  }
+
+  // One metric per line, which is all compare needs to read it back
+  fprintf(file, "{\n  \"renderer\": \"%s\",\n  \"metrics\": {\n",
+          (const char *)glGetString(GL_RENDERER));
+  for (size_t i = 0; i < results->count; i++) {
+    fprintf(file, "    \"%s\": %.6f%s\n", results->metrics[i].name,
+            results->metrics[i].value, i + 1 < results->count ? "," : "");
+  }
+  fprintf(file, "  }\n}\n");
+
+  printf("Wrote %zu metrics to %s\n", results->count, path);
+  return fclose(file) == 0;
+}
+
+static bool readResults(const char *path, Results *results) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    printf("Failed to open %s\n", path);
+    return false;
+  }
+
+  char line[256];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    char name[64];
+    double value;
+    if (sscanf(line, " \"%63[^\"]\": %lf", name, &value) == 2) {
+      char *dot = strchr(name, '.');
+      if (dot != NULL) {
+        *dot = '\0';
+        addMetric(results, name, dot + 1, value);
+      }
+    }
+  }
+
+  fclose(file);
+  return true;
+}
+
+static const Metric *findMetric(const Results *results, const char *name) {
+  for (size_t i = 0; i < results->count; i++) {
+    if (strcmp(results->metrics[i].name, name) == 0) {
+      return &results->metrics[i];
+    }
+  }
+  return NULL;
+}
+
+static int compareResults(int argc, char **argv) {
+  if (argc < 2) {
+    printf("Usage: compare <baseline> <current> [threshold %%]\n");
+    return 2;
+  }
+  double threshold = argc > 2 ? atof(argv[2]) : DEFAULT_THRESHOLD;
+
+  Results baseline = {0}, current = {0};
+  if (!readResults(argv[0], &baseline) || !readResults(argv[1], &current)) {
+    return 2;
+  }
+
+  int regressions = 0;
+  printf("%-36s %12s %12s %9s\n", "metric", "baseline", "current", "change");
+  for (size_t i = 0; i < baseline.count; i++) {
+    const Metric *base = &baseline.metrics[i];
+    const Metric *now = findMetric(&current, base->name);
+    if (now == NULL) {
+      printf("%-36s %12.3f %12s\n", base->name, base->value, "missing");
+      continue;
+    }
+
+    double change =
+        base->value > 0.0 ? (now->value - base->value) / base->value * 100.0
+                          : 0.0;
+    bool regressed = change > threshold && now->value > NOISE_FLOOR;
+    regressions += regressed;
+    printf("%-36s %12.3f %12.3f %+8.1f%%%s\n", base->name, base->value,
+           now->value, change, regressed ? "  REGRESSED" : "");
+  }
+
+  printf("%d regression%s over %.1f%%\n", regressions,
+         regressions == 1 ? "" : "s", threshold);
+  free(baseline.metrics);
+  free(current.metrics);
+  return regressions > 0 ? 1 : 0;
+}
+
+static int runScenes(const BenchScene *scenes, int sceneCount, int frames,
+                     const char *output) {
+  Headless headless;
+  if (!initHeadless(&headless, BENCH_WIDTH, BENCH_HEIGHT)) {
+    freeHeadless(&headless);
+    return 2;
+  }
+  profileThreadName("main");
+
+  Results results = {0};
+  for (int i = 0; i < sceneCount; i++) {
+    runScene(&scenes[i], frames > 0 ? frames : scenes[i].frames, &results);
+  }
+  addMetric(&results, "process", "memory_peak_mb", peakMemoryMB());
+
+  bool ok = writeResults(&results, output);
+  free(results.metrics);
+  freeHeadless(&headless);
+  profileShutdown();
+  return ok ? 0 : 2;
+}
+
+// Every per frame average divides by the frame count
+static bool parseFrames(const char *arg, int *frames) {
+  *frames = atoi(arg);
+  if (*frames <= 0) {
+    printf("Frame count must be at least 1, not %s\n", arg);
+    return false;
+  }
+  return true;
+}
+
+static void printUsage(void) {
+  printf("Usage:\n");
+  printf("  minecraft-bench run [output] [scene|all] [frames]\n");
+  printf("  minecraft-bench path <camera file> [output] [frames]\n");
+  printf("  minecraft-bench compare <baseline> <current> [threshold %%]\n");
+  printf("  minecraft-bench list\n");
+}
+
+int main(int argc, char **argv) {
+  const char *command = argc > 1 ? argv[1] : "run";
+
+  if (strcmp(command, "list") == 0) {
+    for (int i = 0; i < benchSceneCount; i++) {
+      printf("%-10s %2dx%dx%-2d chunks, seed %u, %d frames\n",
+             benchScenes[i].name, benchScenes[i].worldSize,
+             benchScenes[i].worldHeight, benchScenes[i].worldSize,
+             benchScenes[i].seed, benchScenes[i].frames);
+    }
+    return 0;
+  }
+
+  if (strcmp(command, "compare") == 0) {
+    return compareResults(argc - 2, argv + 2);
+  }
+
+  if (strcmp(command, "run") == 0) {
+    const char *output = argc > 2 ? argv[2] : DEFAULT_OUTPUT;
+    const char *name = argc > 3 ? argv[3] : "all";
+    int frames = 0; // Each scene's own
+    if (argc > 4 && !parseFrames(argv[4], &frames)) {
+      return 2;
+    }
+
+    if (strcmp(name, "all") == 0) {
+      return runScenes(benchScenes, benchSceneCount, frames, output);
+    }
+
+    const BenchScene *scene = findBenchScene(name);
+    if (scene == NULL) {
+      printf("Unknown scene %s\n", name);
+      return 2;
+    }
+    return runScenes(scene, 1, frames, output);
+  }
+
+  if (strcmp(command, "path") == 0 && argc > 2) {
+    BenchScene scene = {"path", WORLD_SEED, WORLD_SIZE, WORLD_HEIGHT, 0, 0,
+                        NULL, 0, 0, 0};
+    CameraKey *path;
+    if (!loadCameraPath(argv[2], &path, &scene.pathLength)) {
+      return 2;
+    }
+    scene.path = path;
+
+    // Long enough to reach the last key
+    scene.frames =
+        (int)(path[scene.pathLength - 1].time / HEADLESS_FRAME_STEP) + 1;
+    if (argc > 4 && !parseFrames(argv[4], &scene.frames)) {
+      free(path);
+      return 2;
+    }
+
+    int result =
+        runScenes(&scene, 1, 0, argc > 3 ? argv[3] : DEFAULT_OUTPUT);
+    free(path);
+    return result;
+  }
+
+  printUsage();
+  return 2;
+}
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scenes.h"
+
+// High over a 16x16 chunk world, sweeping across it
+static const CameraKey flyoverPath[] = {
+    {0.0f, {-20.0f, 100.0f, -20.0f}, {128.0f, 30.0f, 128.0f}},
+    {4.0f, {128.0f, 80.0f, 40.0f}, {200.0f, 40.0f, 200.0f}},
+    {8.0f, {240.0f, 110.0f, 240.0f}, {128.0f, 30.0f, 128.0f}},
+    {10.0f, {128.0f, 60.0f, 260.0f}, {128.0f, 40.0f, 0.0f}},
+};
+
+// Close to the ground, where most of the world is hidden behind hills
+static const CameraKey groundPath[] = {
+    {0.0f, {8.0f, 55.0f, 96.0f}, {48.0f, 50.0f, 96.0f}},
+    {5.0f, {184.0f, 55.0f, 96.0f}, {224.0f, 50.0f, 96.0f}},
+    {10.0f, {96.0f, 70.0f, 184.0f}, {96.0f, 40.0f, 96.0f}},
+};
+
+// Straight across an endless world at 25 chunks a second, far faster than
+// chunks can be generated, so anything that waits on streaming shows up
+static const CameraKey streamPath[] = {
+    {0.0f, {0.0f, 100.0f, 8.0f}, {100.0f, 60.0f, 8.0f}},
+    {10.0f, {4000.0f, 100.0f, 8.0f}, {4100.0f, 60.0f, 8.0f}},
+};
+
+// Still, over the ground being edited, at the game's view distance
+static const CameraKey editPath[] = {
+    {0.0f, {0.0f, 90.0f, 0.0f}, {48.0f, 50.0f, 48.0f}},
+};
+
+#define PATH(keys) keys, (int)(sizeof(keys) / sizeof(keys[0]))
+
+const BenchScene benchScenes[] = {
+    {"orbit", 1337u, 8, 6, 0, 600, NULL, 0, 0, 0},
+    {"flyover", 1337u, 16, 6, 0, 600, PATH(flyoverPath), 0, 0},
+    {"ground", 42u, 12, 6, 0, 600, PATH(groundPath), 0, 0},
+    {"stream", 1337u, 0, 6, 10, 600, PATH(streamPath), 0, 0},
+    {"edit", 1337u, 0, 6, 12, 600, PATH(editPath), 24, 0},
+    {"entities", 1337u, 8, 6, 0, 600, NULL, 0, 0, 20000},
+};
+
+const int benchSceneCount = sizeof(benchScenes) / sizeof(benchScenes[0]);
+
+const BenchScene *findBenchScene(const char *name) {
+  for (int i = 0; i < benchSceneCount; i++) {
+    if (strcmp(benchScenes[i].name, name) == 0) {
+      return &benchScenes[i];
+    }
+  }
+  return NULL;
+}
+
+void cameraPathAt(const CameraKey *path, int length, double time,
+                  float eye[3], float target[3]) {
+  int next = 0;
+  while (next < length && path[next].time <= time) {
+    next++;
+  }
+
+  const CameraKey *a = &path[next > 0 ? next - 1 : 0];
+  const CameraKey *b = &path[next < length ? next : length - 1];
+  float t = b->time > a->time ? (float)((time - a->time) / (b->time - a->time))
+                              : 0.0f;
+
+  for (int i = 0; i < 3; i++) {
+    eye[i] = a->eye[i] + (b->eye[i] - a->eye[i]) * t;
+    target[i] = a->target[i] + (b->target[i] - a->target[i]) * t;
+  }
+}
+
+bool loadCameraPath(const char *fileName, CameraKey **path, int *length) {
+  FILE *file = fopen(fileName, "r");
+  if (file == NULL) {
+    printf("Failed to open camera path %s\n", fileName);
+    return false;
+  }
+
+  int capacity = 16;
+  *path = malloc(capacity * sizeof(CameraKey));
+  *length = 0;
+
+  char line[256];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (line[0] == '#') {
+      continue;
+    }
+
+    CameraKey key;
+    if (sscanf(line, "%f %f %f %f %f %f %f", &key.time, &key.eye[0],
+               &key.eye[1], &key.eye[2], &key.target[0], &key.target[1],
+               &key.target[2]) != 7) {
+      continue;
+    }
+
+    if (*length == capacity) {
+      capacity *= 2;
+      *path = realloc(*path, capacity * sizeof(CameraKey));
+    }
+    (*path)[(*length)++] = key;
+  }
+  fclose(file);
+
+  if (*length == 0) {
+    printf("No camera keys in %s\n", fileName);
+    free(*path);
+    *path = NULL;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,45 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Where the camera is at a point in time, the path moves in a straight line
+// from one key to the next
+typedef struct CameraKey {
+  float time;
+  float eye[3];
+  float target[3];
+} CameraKey;
+
+typedef struct BenchScene {
+  const char *name;
+  uint32_t seed;
+  int worldSize, worldHeight; // In chunks, a size of 0 has no limit
+  int viewDistance; // 0 keeps the whole world loaded
+  int frames;
+  // NULL follows the same orbit as the game window
+  const CameraKey *path;
+  int pathLength;
+  // Every frame a block is placed or removed this many blocks or less
+  // from the camera target, 0 for none
+  int editRadius;
+  // Entities spread over the world and drawn every frame, 0 for none
+  int entities;
+} BenchScene;
+
+extern const BenchScene benchScenes[];
+extern const int benchSceneCount;
+
+const BenchScene *findBenchScene(const char *name);
+
+// Camera at time seconds along the path, held at either end
+void cameraPathAt(const CameraKey *path, int length, double time,
+                  float eye[3], float target[3]);
+
+// Reads a camera path from a text file with one key per line:
+//   time eyeX eyeY eyeZ targetX targetY targetZ
+// Lines starting with # are skipped. Keys must be in time order
+bool loadCameraPath(const char *fileName, CameraKey **path, int *length);
+
+#endif
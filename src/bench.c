@@ -0,0 +1,1491 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include <cglm/cglm.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "chunk.h"
+#include "entity.h"
+#include "frustum.h"
+#include "light.h"
+#include "mesher.h"
+#include "noise.h"
+#include "physics.h"
+#include "raycast.h"
+#include "region.h"
+#include "terrain.h"
+#include "threadpool.h"
+#include "timer.h"
+#include "world.h"
+
+typedef struct Benchmark {
+  const char *name;
+  const char *usage;
+  int (*run)(int argc, char **argv);
+} Benchmark;
+
+static uint32_t benchRandom(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+static int intArg(int argc, char **argv, int index, int fallback) {
+  return argc > index ? atoi(argv[index]) : fallback;
+}
+
+static int compareDoubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+double benchPercentile(const double *values, size_t count, double rank) {
+  if (count == 0) {
+    return 0.0;
+  }
+
+  double *sorted = malloc(count * sizeof(double));
+  memcpy(sorted, values, count * sizeof(double));
+  qsort(sorted, count, sizeof(double), compareDoubles);
+
+  size_t nearest = (size_t)ceil(rank / 100.0 * (double)count);
+  double value = sorted[nearest > 0 ? nearest - 1 : 0];
+  free(sorted);
+  return value;
+}
+
+static void reportRate(const char *label, double ops, double seconds) {
+  printf("  %-24s %8.2f ms %10.2f Mops/s\n", label, seconds * 1000.0,
+         ops / seconds / 1e6);
+}
+
+// Whether two chunks hold the same blocks, however they are packed
+static bool sameBlocks(const Chunk *a, const Chunk *b) {
+  BlockId blocksA[CHUNK_VOLUME], blocksB[CHUNK_VOLUME];
+  chunkGetBlocks(a, blocksA);
+  chunkGetBlocks(b, blocksB);
+  return memcmp(blocksA, blocksB, sizeof(blocksA)) == 0;
+}
+
+// Every benchmark generates the same terrain
+#define BENCH_SEED 1337u
+
+// size x height x size chunks of generated terrain
+static World *createBenchWorld(int size, int height) {
+  Terrain terrain;
+  initTerrain(&terrain, BENCH_SEED);
+
+  World *world = createWorld();
+  for (int y = 0; y < height; y++) {
+    for (int z = 0; z < size; z++) {
+      for (int x = 0; x < size; x++) {
+        generateChunk(&terrain, worldCreateChunk(world, x, y, z));
+      }
+    }
+  }
+  return world;
+}
+
+// === Chunk storage === //
+
+static int benchChunk(int argc, char **argv) {
+  int size = intArg(argc, argv, 0, 8);
+  int blocks = size * CHUNK_SIZE;
+  double ops = (double)blocks * blocks * blocks;
+
+  printf("chunk: %dx%dx%d chunks (%.0f blocks)\n", size, size, size, ops);
+
+  World *world = createWorld();
+  uint32_t checksum = 0;
+  double start;
+
+  start = timerNow();
+  for (int y = 0; y < blocks; y++) {
+    for (int z = 0; z < blocks; z++) {
+      for (int x = 0; x < blocks; x++) {
+        worldSetBlock(world, x, y, z, (BlockId)(1 + ((x ^ y ^ z) & 3)));
+      }
+    }
+  }
+  reportRate("sequential set", ops, timerNow() - start);
+
+  start = timerNow();
+  for (int y = 0; y < blocks; y++) {
+    for (int z = 0; z < blocks; z++) {
+      for (int x = 0; x < blocks; x++) {
+        checksum += worldGetBlock(world, x, y, z);
+      }
+    }
+  }
+  reportRate("sequential get", ops, timerNow() - start);
+
+  uint32_t rng = 0x9e3779b9u;
+  start = timerNow();
+  for (double i = 0; i < ops; i++) {
+    int x = benchRandom(&rng) % blocks;
+    int y = benchRandom(&rng) % blocks;
+    int z = benchRandom(&rng) % blocks;
+    checksum += worldGetBlock(world, x, y, z);
+  }
+  reportRate("random get", ops, timerNow() - start);
+
+  rng = 0x9e3779b9u;
+  start = timerNow();
+  for (double i = 0; i < ops; i++) {
+    int x = benchRandom(&rng) % blocks;
+    int y = benchRandom(&rng) % blocks;
+    int z = benchRandom(&rng) % blocks;
+    worldSetBlock(world, x, y, z, (BlockId)(i < ops / 2 ? 1 : 2));
+  }
+  reportRate("random set", ops, timerNow() - start);
+
+  // Same access pattern with the chunk lookup hoisted out of the loop
+  start = timerNow();
+  size_t iter = 0;
+  Chunk *chunk;
+  while ((chunk = worldNextChunk(world, &iter)) != NULL) {
+    for (int i = 0; i < CHUNK_VOLUME; i++) {
+      int x = i & CHUNK_MASK;
+      int z = (i >> CHUNK_SHIFT) & CHUNK_MASK;
+      int y = i >> (2 * CHUNK_SHIFT);
+      checksum += chunkGetBlock(chunk, x, y, z);
+    }
+  }
+  reportRate("in-chunk get", ops, timerNow() - start);
+
+  // Random access within chunks against the same blocks unpacked, which is
+  // what every chunk used to store
+  size_t chunkCount = world->chunkCount;
+  Chunk **chunks = malloc(chunkCount * sizeof(Chunk *));
+  BlockId(*unpacked)[CHUNK_VOLUME] = malloc(chunkCount * sizeof(*unpacked));
+  iter = 0;
+  for (size_t c = 0; (chunk = worldNextChunk(world, &iter)) != NULL; c++) {
+    chunks[c] = chunk;
+    chunkGetBlocks(chunk, unpacked[c]);
+  }
+
+  double seconds[4];
+  for (int test = 0; test < 4; test++) {
+    bool packed = test < 2, set = test & 1;
+    rng = 0x9e3779b9u;
+    start = timerNow();
+    for (double i = 0; i < ops; i++) {
+      uint32_t r = benchRandom(&rng);
+      size_t c = r % chunkCount;
+      int x = (r >> 20) & CHUNK_MASK;
+      int y = (r >> 24) & CHUNK_MASK;
+      int z = (r >> 28) & CHUNK_MASK;
+      BlockId block = (BlockId)(1 + (r & 1));
+      if (packed && set) {
+        chunkSetBlock(chunks[c], x, y, z, block);
+      } else if (packed) {
+        checksum += chunkGetBlock(chunks[c], x, y, z);
+      } else if (set) {
+        unpacked[c][CHUNK_INDEX(x, y, z)] = block;
+      } else {
+        checksum += unpacked[c][CHUNK_INDEX(x, y, z)];
+      }
+    }
+    seconds[test] = timerNow() - start;
+  }
+  reportRate("packed random get", ops, seconds[0]);
+  reportRate("unpacked random get", ops, seconds[2]);
+  reportRate("packed random set", ops, seconds[1]);
+  reportRate("unpacked random set", ops, seconds[3]);
+  printf("  packed/unpacked time: get %.2fx, set %.2fx\n",
+         seconds[0] / seconds[2], seconds[1] / seconds[3]);
+
+  // Both had the same blocks set, so however the palettes were repacked
+  // along the way they have to hold the same blocks now
+  size_t mismatches = 0;
+  BlockId packedBlocks[CHUNK_VOLUME];
+  for (size_t c = 0; c < chunkCount; c++) {
+    chunkGetBlocks(chunks[c], packedBlocks);
+    mismatches +=
+        memcmp(packedBlocks, unpacked[c], sizeof(packedBlocks)) != 0;
+  }
+  free(unpacked);
+  free(chunks);
+  if (mismatches > 0) {
+    printf("  %zu packed chunks don't match their unpacked copies\n",
+           mismatches);
+    destroyWorld(world);
+    return 1;
+  }
+
+  size_t memory = world->capacity * sizeof(Chunk *);
+  iter = 0;
+  while ((chunk = worldNextChunk(world, &iter)) != NULL) {
+    memory += chunkMemoryUsage(chunk);
+  }
+
+  printf("  chunks: %zu, memory: %.2f MiB (%.2f bytes/block)\n",
+         world->chunkCount, memory / (1024.0 * 1024.0), memory / ops);
+  printf("  checksum: %u\n", checksum);
+  destroyWorld(world);
+
+  // Generated terrain is where most chunks come from, and most of it is a
+  // single block or a handful
+  world = createBenchWorld(size, 6);
+  size_t terrainMemory = 0, uniform = 0;
+  iter = 0;
+  while ((chunk = worldNextChunk(world, &iter)) != NULL) {
+    terrainMemory += chunkMemoryUsage(chunk);
+    uniform += chunkIsUniform(chunk);
+  }
+  double unpackedBytes = sizeof(Chunk) + CHUNK_VOLUME * sizeof(BlockId);
+  double perChunk = (double)terrainMemory / world->chunkCount;
+  printf("  terrain: %zu chunks (%zu uniform), %.0f bytes/chunk, "
+         "%.1fx smaller than unpacked\n",
+         world->chunkCount, uniform, perChunk, unpackedBytes / perChunk);
+
+  destroyWorld(world);
+  return 0;
+}
+
+// === Meshing === //
+
+static int benchMesh(int argc, char **argv) {
+  int size = intArg(argc, argv, 0, 8);
+  static const char *modeNames[MESH_MODE_COUNT] = {"naive", "culled",
+                                                   "greedy"};
+
+  World *world = createBenchWorld(size, 5);
+  size_t chunkCount = world->chunkCount;
+
+  // Gather up front so only the meshing itself is timed
+  MeshInput *inputs = malloc(chunkCount * sizeof(MeshInput));
+  size_t iter = 0, emptyChunks = 0;
+  Chunk *chunk;
+  double start = timerNow();
+  for (size_t i = 0; (chunk = worldNextChunk(world, &iter)) != NULL; i++) {
+    gatherMeshInput(world, chunk, &inputs[i]);
+  }
+  double gatherSeconds = timerNow() - start;
+
+  iter = 0;
+  while ((chunk = worldNextChunk(world, &iter)) != NULL) {
+    emptyChunks += meshIsEmpty(world, chunk);
+  }
+
+  printf("mesh: %zu chunks of terrain\n", chunkCount);
+  printf("  %-8s %10s %12s %14s %12s\n", "mode", "ms", "us/chunk",
+         "tris/chunk", "vertex MiB");
+
+  Mesh mesh;
+  initMesh(&mesh);
+
+  double greedySeconds = 0, greedyTriangles = 0, noSkipSeconds = 0;
+  double noAoSeconds = 0, noAoTriangles = 0;
+  for (int mode = 0; mode <= MESH_MODE_COUNT + 1; mode++) {
+    // Greedy again without ambient occlusion, then with every cell occupied
+    // and nothing opaque, which is what it did before it could skip anything
+    bool noAo = mode == MESH_MODE_COUNT;
+    bool noSkip = mode == MESH_MODE_COUNT + 1;
+    for (size_t i = 0; (noAo || noSkip) && i < chunkCount; i++) {
+      inputs[i].ambientOcclusion = noSkip;
+      if (noSkip) {
+        inputs[i].occupied = UINT64_MAX;
+        inputs[i].opaque = 0;
+        inputs[i].opaqueBorders = 0;
+      }
+    }
+
+    double triangles = 0, vertexBytes = 0;
+    start = timerNow();
+
+    for (size_t i = 0; i < chunkCount; i++) {
+      meshChunk(&inputs[i], mode >= MESH_GREEDY ? MESH_GREEDY : (MeshMode)mode,
+                &mesh);
+      triangles += mesh.indexCount / 3;
+      vertexBytes += mesh.vertexCount * sizeof(PackedVertex) +
+                     mesh.indexCount * sizeof(uint32_t);
+    }
+
+    double seconds = timerNow() - start;
+    printf("  %-8s %10.2f %12.2f %14.1f %12.2f\n",
+           noSkip ? "noskip" : (noAo ? "noao" : modeNames[mode]),
+           seconds * 1000.0,
+           seconds * 1e6 / chunkCount, triangles / chunkCount,
+           vertexBytes / (1024.0 * 1024.0));
+
+    if (mode == MESH_GREEDY) {
+      greedySeconds = seconds;
+      greedyTriangles = triangles;
+    } else if (noAo) {
+      noAoSeconds = seconds;
+      noAoTriangles = triangles;
+    } else if (noSkip) {
+      noSkipSeconds = seconds;
+      if (triangles != greedyTriangles) {
+        printf("  skipping changed the mesh from %.0f to %.0f triangles\n",
+               triangles, greedyTriangles);
+      }
+    }
+  }
+
+  // Occlusion is worked out for visible faces only, and splits up quads
+  // whose corners differ
+  printf("  ambient occlusion costs %.2f ms of %.2f ms greedy meshing "
+         "(%.0f%%), %.0f%% more triangles\n",
+         (greedySeconds - noAoSeconds) * 1000.0, greedySeconds * 1000.0,
+         (greedySeconds - noAoSeconds) / greedySeconds * 100.0,
+         (greedyTriangles - noAoTriangles) / noAoTriangles * 100.0);
+
+  // Scenes don't gather or mesh chunks with nothing to draw at all, and
+  // greedy meshing skips layers of cells with nothing visible in the rest
+  double skipped = noSkipSeconds - greedySeconds;
+  printf("  skipped %.2f ms of %.2f ms greedy meshing (%.0f%%)\n",
+         skipped * 1000.0, noSkipSeconds * 1000.0,
+         skipped / noSkipSeconds * 100.0);
+  printf("  %zu of %zu chunks are empty or enclosed, skipping ~%.2f ms of "
+         "gathering\n",
+         emptyChunks, chunkCount,
+         gatherSeconds * emptyChunks / chunkCount * 1000.0);
+
+  freeMesh(&mesh);
+  free(inputs);
+  destroyWorld(world);
+  return 0;
+}
+
+// === Lighting === //
+
+// Lights a size x height x size world from the top down, like it would be
+// streamed in, and returns the seconds taken
+static double lightWorld(LightEngine *engine, int size, int height) {
+  size_t iter = 0;
+  Chunk *chunk;
+  while ((chunk = worldNextChunk(engine->world, &iter)) != NULL) {
+    chunkFillLight(chunk, 0);
+  }
+
+  double start = timerNow();
+  for (int y = height - 1; y >= 0; y--) {
+    for (int z = 0; z < size; z++) {
+      for (int x = 0; x < size; x++) {
+        lightChunkLoaded(engine, worldGetChunk(engine->world, x, y, z));
+      }
+    }
+  }
+  return timerNow() - start;
+}
+
+// Copies out the light of every chunk, or counts the blocks that differ
+// from an earlier copy
+static size_t lightSnapshot(const World *world, uint8_t *light, bool compare) {
+  size_t iter = 0, differences = 0;
+  Chunk *chunk;
+  for (uint8_t *out = light; (chunk = worldNextChunk(world, &iter)) != NULL;
+       out += CHUNK_VOLUME) {
+    for (int i = 0; i < CHUNK_VOLUME; i++) {
+      uint8_t value =
+          chunkGetLight(chunk, i & CHUNK_MASK, i >> (2 * CHUNK_SHIFT),
+                        (i >> CHUNK_SHIFT) & CHUNK_MASK);
+      differences += compare && out[i] != value;
+      out[i] = value;
+    }
+  }
+  return differences;
+}
+
+static int benchLight(int argc, char **argv) {
+  int size = intArg(argc, argv, 0, 8);
+  int height = intArg(argc, argv, 1, 6);
+  int edits = intArg(argc, argv, 2, 500);
+
+  World *world = createBenchWorld(size, height);
+  size_t chunkCount = world->chunkCount;
+  uint8_t *light = malloc(chunkCount * CHUNK_VOLUME);
+  LightEngine engine;
+  initLightEngine(&engine, world, height);
+
+  printf("light: %dx%dx%d chunks of terrain\n", size, height, size);
+
+  // Flooding every chunk first, so the shortcuts for uniform chunks can be
+  // checked against it
+  engine.uniformShortcuts = false;
+  double floodSeconds = lightWorld(&engine, size, height);
+  size_t floodVisited = engine.stats.visited;
+  lightSnapshot(world, light, false);
+
+  engine.uniformShortcuts = true;
+  memset(&engine.stats, 0, sizeof(engine.stats));
+  double seconds = lightWorld(&engine, size, height);
+  size_t differences = lightSnapshot(world, light, true);
+
+  size_t memory = 0, iter = 0;
+  Chunk *chunk;
+  while ((chunk = worldNextChunk(world, &iter)) != NULL) {
+    memory += chunk->light != NULL ? CHUNK_VOLUME : 0;
+  }
+
+  printf("  flood all    %10.2f ms %8.1f us/chunk %10zu blocks visited\n",
+         floodSeconds * 1000.0, floodSeconds * 1e6 / chunkCount,
+         floodVisited);
+  printf("  shortcuts    %10.2f ms %8.1f us/chunk %10zu blocks visited\n",
+         seconds * 1000.0, seconds * 1e6 / chunkCount, engine.stats.visited);
+  printf("  skipped %.2f ms (%.0f%%), %zu of %zu chunks lit without "
+         "flooding, %.2f MiB of light\n",
+         (floodSeconds - seconds) * 1000.0,
+         (floodSeconds - seconds) / floodSeconds * 100.0,
+         engine.stats.uniformChunks, chunkCount, memory / (1024.0 * 1024.0));
+  if (differences > 0) {
+    printf("  %zu blocks lit differently by the shortcuts\n", differences);
+  }
+
+  // Single blocks set on the surface and then set back, so the world should
+  // end up lit exactly as it started
+  enum { PLACE, REMOVE, LAMP_ON, LAMP_OFF, EDIT_KINDS };
+  static const char *editNames[EDIT_KINDS] = {"place", "remove", "lamp on",
+                                              "lamp off"};
+  double *times = malloc(EDIT_KINDS * (size_t)edits * sizeof(double));
+  size_t visited[EDIT_KINDS] = {0};
+
+  uint32_t rng = 0x9e3779b9u;
+  int top = height * CHUNK_SIZE - 1;
+  for (int i = 0; i < edits; i++) {
+    int x = benchRandom(&rng) % (size * CHUNK_SIZE);
+    int z = benchRandom(&rng) % (size * CHUNK_SIZE);
+    int y = top;
+    while (y > 0 && worldGetBlock(world, x, y - 1, z) == BLOCK_AIR) {
+      y--;
+    }
+    if (y == top) {
+      y--;
+    }
+
+    for (int kind = 0; kind < EDIT_KINDS; kind++) {
+      static const BlockId placed[EDIT_KINDS] = {BLOCK_STONE, BLOCK_AIR,
+                                                 BLOCK_LAMP, BLOCK_AIR};
+      size_t before = engine.stats.visited;
+      double start = timerNow();
+      lightSetBlock(&engine, x, y, z, placed[kind]);
+      times[kind * edits + i] = timerNow() - start;
+      visited[kind] += engine.stats.visited - before;
+    }
+  }
+
+  printf("  %-10s %10s %10s %10s %14s\n", "edit", "p50 us", "p99 us",
+         "max us", "blocks visited");
+  for (int kind = 0; kind < EDIT_KINDS; kind++) {
+    double *kindTimes = &times[kind * edits];
+    printf("  %-10s %10.1f %10.1f %10.1f %14.1f\n", editNames[kind],
+           benchPercentile(kindTimes, edits, 50.0) * 1e6,
+           benchPercentile(kindTimes, edits, 99.0) * 1e6,
+           benchPercentile(kindTimes, edits, 100.0) * 1e6,
+           (double)visited[kind] / edits);
+  }
+
+  differences = lightSnapshot(world, light, true);
+  if (differences > 0) {
+    printf("  %zu blocks lit differently after undoing every edit\n",
+           differences);
+  }
+
+  free(times);
+  free(light);
+  freeLightEngine(&engine);
+  destroyWorld(world);
+  return differences > 0 ? 1 : 0;
+}
+
+// === Terrain generation === //
+
+static int benchTerrain(int argc, char **argv) {
+  int size = intArg(argc, argv, 0, 16);
+  int height = intArg(argc, argv, 1, 6);
+  const char *dumpFile = argc > 3 ? argv[3] : NULL;
+
+  if (argc > 2 && !setNoiseBackend(argv[2])) {
+    printf("Noise backend %s is not supported here\n", argv[2]);
+    return 1;
+  }
+
+  Terrain terrain;
+  initTerrain(&terrain, BENCH_SEED);
+  Chunk *chunk = createChunk(0, 0, 0);
+  FILE *dump = dumpFile ? fopen(dumpFile, "wb") : NULL;
+
+  // FNV-1a over every block, so runs can be compared at a glance
+  uint32_t checksum = 2166136261u;
+  int chunkCount = size * size * height;
+  double seconds = 0;
+
+  for (int y = 0; y < height; y++) {
+    for (int z = 0; z < size; z++) {
+      for (int x = 0; x < size; x++) {
+        chunk->x = x;
+        chunk->y = y;
+        chunk->z = z;
+
+        double start = timerNow();
+        generateChunk(&terrain, chunk);
+        seconds += timerNow() - start;
+
+        BlockId blocks[CHUNK_VOLUME];
+        chunkGetBlocks(chunk, blocks);
+        for (int i = 0; i < CHUNK_VOLUME; i++) {
+          checksum = (checksum ^ blocks[i]) * 16777619u;
+        }
+        if (dump) {
+          fwrite(blocks, sizeof(blocks), 1, dump);
+        }
+      }
+    }
+  }
+
+  if (dump) {
+    fclose(dump);
+  }
+
+  printf("terrain: %dx%dx%d chunks, seed %u, noise backend %s\n", size, height,
+         size, BENCH_SEED, noiseBackend());
+  printf("  %.2f ms, %.0f chunks/s, %.2f Mblocks/s\n", seconds * 1000.0,
+         chunkCount / seconds,
+         chunkCount * (double)CHUNK_VOLUME / seconds / 1e6);
+  printf("  checksum: %08x\n", checksum);
+
+  destroyChunk(chunk);
+  return 0;
+}
+
+// === Frustum culling === //
+
+static int benchFrustum(int argc, char **argv) {
+  int size = intArg(argc, argv, 0, 64);
+  int height = 8;
+  int frames = intArg(argc, argv, 1, 600);
+
+  ChunkBounds bounds;
+  initChunkBounds(&bounds);
+  for (int y = 0; y < height; y++) {
+    for (int z = 0; z < size; z++) {
+      for (int x = 0; x < size; x++) {
+        float min[3] = {x * CHUNK_SIZE, y * CHUNK_SIZE, z * CHUNK_SIZE};
+        float max[3] = {min[0] + CHUNK_SIZE, min[1] + CHUNK_SIZE,
+                        min[2] + CHUNK_SIZE};
+        addChunkBounds(&bounds, min, max);
+      }
+    }
+  }
+
+  uint32_t *visible = malloc(bounds.count * sizeof(uint32_t));
+  mat4 projection, view, viewProjection;
+  glm_perspective(glm_rad(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f, projection);
+
+  // Fly a circle over the middle of the grid, looking outwards and down
+  float center = size * CHUNK_SIZE * 0.5f;
+  double total = 0, worst = 0;
+  CullStats stats, sum = {0, 0, 0};
+
+  for (int frame = 0; frame < frames; frame++) {
+    float angle = (float)frame / frames * 2.0f * GLM_PIf;
+    vec3 eye = {center + cosf(angle) * center * 0.5f, 100.0f,
+                center + sinf(angle) * center * 0.5f};
+    vec3 target = {eye[0] + cosf(angle * 3.0f) * 10.0f, 90.0f,
+                   eye[2] + sinf(angle * 3.0f) * 10.0f};
+    glm_lookat(eye, target, (vec3){0.0f, 1.0f, 0.0f}, view);
+    glm_mat4_mul(projection, view, viewProjection);
+
+    double start = timerNow();
+    Frustum frustum;
+    extractFrustum(viewProjection[0], &frustum);
+    cullChunkBounds(&frustum, &bounds, visible, &stats);
+    double seconds = timerNow() - start;
+
+    total += seconds;
+    worst = seconds > worst ? seconds : worst;
+    sum.visible += stats.visible;
+    sum.culled += stats.culled;
+  }
+
+  printf("frustum: %zu chunks, %d frames\n", bounds.count, frames);
+  printf("  %.2f us/frame average, %.2f us worst, %.2f ns/chunk\n",
+         total / frames * 1e6, worst * 1e6,
+         total / frames / bounds.count * 1e9);
+  printf("  %zu visible, %zu culled per frame on average\n",
+         sum.visible / frames, sum.culled / frames);
+
+  free(visible);
+  freeChunkBounds(&bounds);
+  return 0;
+}
+
+// === Threaded meshing === //
+
+#define MESHPOOL_QUEUE_SIZE 256
+
+// Meshes jobCount chunks on a pool of threadCount workers, returns seconds
+static double meshOnPool(const MeshInput *inputs, size_t inputCount,
+                         int jobCount, int threadCount) {
+  ThreadPool *pool = createThreadPool(threadCount, MESHPOOL_QUEUE_SIZE);
+
+  int freeCount = MESHPOOL_QUEUE_SIZE;
+  MeshJob *freeJobs[MESHPOOL_QUEUE_SIZE];
+  for (int i = 0; i < freeCount; i++) {
+    freeJobs[i] = createMeshJob();
+  }
+
+  int submitted = 0, completed = 0;
+  Job *done[MESHPOOL_QUEUE_SIZE];
+  double start = timerNow();
+
+  while (completed < jobCount) {
+    while (submitted < jobCount && freeCount > 0) {
+      MeshJob *job = freeJobs[freeCount - 1];
+      job->mode = MESH_GREEDY;
+      job->input = inputs[submitted % inputCount];
+      if (!threadPoolSubmit(pool, &job->job)) {
+        break;
+      }
+      freeCount--;
+      submitted++;
+    }
+
+    size_t count = threadPoolPoll(pool, done, MESHPOOL_QUEUE_SIZE);
+    for (size_t i = 0; i < count; i++) {
+      freeJobs[freeCount++] = (MeshJob *)done[i];
+    }
+    completed += (int)count;
+  }
+
+  double seconds = timerNow() - start;
+
+  destroyThreadPool(pool);
+  for (int i = 0; i < freeCount; i++) {
+    destroyMeshJob(freeJobs[i]);
+  }
+  return seconds;
+}
+
+static int benchMeshPool(int argc, char **argv) {
+  int jobCount = intArg(argc, argv, 0, 4096);
+  int maxThreads = intArg(argc, argv, 1, cpuCount());
+
+  World *world = createBenchWorld(8, 5);
+  MeshInput *inputs = malloc(world->chunkCount * sizeof(MeshInput));
+  size_t inputCount = 0;
+
+  size_t iter = 0;
+  Chunk *chunk;
+  while ((chunk = worldNextChunk(world, &iter)) != NULL) {
+    gatherMeshInput(world, chunk, &inputs[inputCount++]);
+  }
+
+  printf("meshpool: %d chunks, up to %d threads (%d cpus)\n", jobCount,
+         maxThreads, cpuCount());
+  printf("  %-8s %10s %14s %10s %12s\n", "threads", "ms", "chunks/s",
+         "speedup", "efficiency");
+
+  double baseline = 0;
+  for (int threads = 1; threads <= maxThreads;
+       threads = threads < maxThreads && threads * 2 > maxThreads
+                     ? maxThreads
+                     : threads * 2) {
+    double seconds = meshOnPool(inputs, inputCount, jobCount, threads);
+    if (threads == 1) {
+      baseline = seconds;
+    }
+
+    double speedup = baseline / seconds;
+    printf("  %-8d %10.2f %14.0f %9.2fx %11.0f%%\n", threads,
+           seconds * 1000.0, jobCount / seconds, speedup,
+           speedup / threads * 100.0);
+  }
+
+  free(inputs);
+  destroyWorld(world);
+  return 0;
+}
+
+// === Raycasting === //
+
+#define RAYCAST_BATCH 1024
+
+// The plain traversal, reading every block through the world
+static bool referenceRaycast(const World *world, const RayQuery *query,
+                             RayHit *hit) {
+  const float *o = query->origin, *d = query->direction;
+  float length = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+  int pos[3], step[3];
+  float next[3], delta[3];
+  for (int i = 0; i < 3; i++) {
+    float dir = d[i] / length;
+    pos[i] = (int)floorf(o[i]);
+    step[i] = dir > 0.0f ? 1 : (dir < 0.0f ? -1 : 0);
+    delta[i] = dir != 0.0f ? fabsf(1.0f / dir) : INFINITY;
+    next[i] = dir > 0.0f   ? (floorf(o[i]) + 1.0f - o[i]) / dir
+              : dir < 0.0f ? (o[i] - floorf(o[i])) / -dir
+                           : INFINITY;
+  }
+
+  float distance = 0.0f;
+  while (distance <= query->maxDistance) {
+    BlockId block = worldGetBlock(world, pos[0], pos[1], pos[2]);
+    if (block != BLOCK_AIR) {
+      hit->hit = true;
+      hit->x = pos[0];
+      hit->y = pos[1];
+      hit->z = pos[2];
+      return true;
+    }
+    int axis = next[0] < next[1] ? 0 : 1;
+    axis = next[2] < next[axis] ? 2 : axis;
+    distance = next[axis];
+    pos[axis] += step[axis];
+    next[axis] += delta[axis];
+  }
+  hit->hit = false;
+  return false;
+}
+
+// Casts every ray in batches on a pool of threadCount workers
+static double raycastOnPool(const World *world, const RayQuery *rays,
+                            size_t count, RayHit *hits, int threadCount) {
+  size_t jobCount = (count + RAYCAST_BATCH - 1) / RAYCAST_BATCH;
+  ThreadPool *pool = createThreadPool(threadCount, jobCount);
+  RaycastJob *jobs = malloc(jobCount * sizeof(RaycastJob));
+
+  double start = timerNow();
+  for (size_t i = 0; i < jobCount; i++) {
+    size_t first = i * RAYCAST_BATCH;
+    size_t batch = count - first < RAYCAST_BATCH ? count - first
+                                                 : RAYCAST_BATCH;
+    initRaycastJob(&jobs[i], world, &rays[first], batch, &hits[first]);
+    threadPoolSubmit(pool, &jobs[i].job);
+  }
+
+  size_t completed = 0;
+  Job *done[64];
+  while (completed < jobCount) {
+    completed += threadPoolPoll(pool, done, 64);
+  }
+  double seconds = timerNow() - start;
+
+  destroyThreadPool(pool);
+  free(jobs);
+  return seconds;
+}
+
+static int benchRaycast(int argc, char **argv) {
+  int rayCount = intArg(argc, argv, 0, 1 << 20);
+  float maxDistance = (float)intArg(argc, argv, 1, 64);
+  int maxThreads = intArg(argc, argv, 2, cpuCount());
+  int size = 8, height = 6;
+
+  World *world = createBenchWorld(size, height);
+
+  // From up to 8 blocks over the ground, in every direction, like picking
+  // blocks and checking what can see what
+  RayQuery *rays = malloc((size_t)rayCount * sizeof(RayQuery));
+  uint32_t random = BENCH_SEED;
+  float extent = (float)(size * CHUNK_SIZE);
+  for (int i = 0; i < rayCount; i++) {
+    RayQuery *ray = &rays[i];
+    ray->origin[0] = (benchRandom(&random) & 0xffff) / 65536.0f * extent;
+    ray->origin[2] = (benchRandom(&random) & 0xffff) / 65536.0f * extent;
+
+    int ground = height * CHUNK_SIZE - 1;
+    while (ground > 0 && worldGetBlock(world, (int)ray->origin[0], ground,
+                                       (int)ray->origin[2]) == BLOCK_AIR) {
+      ground--;
+    }
+    ray->origin[1] =
+        ground + 1.0f + (benchRandom(&random) & 0xffff) / 65536.0f * 8.0f;
+    for (int j = 0; j < 3; j++) {
+      ray->direction[j] = (benchRandom(&random) & 0xffff) / 32768.0f - 1.0f;
+    }
+    ray->maxDistance = maxDistance;
+  }
+  RayHit *hits = malloc((size_t)rayCount * sizeof(RayHit));
+  RayHit *reference = malloc((size_t)rayCount * sizeof(RayHit));
+
+  printf("raycast: %d rays up to %.0f blocks over %dx%dx%d chunks\n",
+         rayCount, maxDistance, size, height, size);
+
+  double start = timerNow();
+  size_t hitCount = 0;
+  for (int i = 0; i < rayCount; i++) {
+    hitCount += referenceRaycast(world, &rays[i], &reference[i]);
+  }
+  double referenceSeconds = timerNow() - start;
+  reportRate("per block", rayCount, referenceSeconds);
+
+  start = timerNow();
+  raycastBatch(world, rays, (size_t)rayCount, hits);
+  double seconds = timerNow() - start;
+  reportRate("skipping", rayCount, seconds);
+
+  // Rays through the edge of a block can go either way with rounding
+  size_t mismatches = 0;
+  for (int i = 0; i < rayCount; i++) {
+    bool same = hits[i].hit == reference[i].hit &&
+                (!hits[i].hit || (hits[i].x == reference[i].x &&
+                                  hits[i].y == reference[i].y &&
+                                  hits[i].z == reference[i].z));
+    mismatches += !same;
+  }
+  printf("  %.1fx faster, %.0f%% of rays hit, %zu differ from per block\n",
+         referenceSeconds / seconds, 100.0 * hitCount / rayCount, mismatches);
+
+  // Between random points in the air, blocked by the terrain or not
+  start = timerNow();
+  size_t visible = 0;
+  for (int i = 0; i + 1 < rayCount; i += 2) {
+    visible += lineOfSight(world, rays[i].origin, rays[i + 1].origin);
+  }
+  double sightSeconds = timerNow() - start;
+  reportRate("line of sight", rayCount / 2, sightSeconds);
+  printf("  %.0f%% of pairs see each other\n",
+         100.0 * visible / (rayCount / 2));
+
+  printf("  %-8s %10s %14s %10s\n", "threads", "ms", "rays/s", "speedup");
+  double baseline = 0;
+  for (int threads = 1; threads <= maxThreads;
+       threads = threads < maxThreads && threads * 2 > maxThreads
+                     ? maxThreads
+                     : threads * 2) {
+    seconds = raycastOnPool(world, rays, (size_t)rayCount, hits, threads);
+    baseline = threads == 1 ? seconds : baseline;
+    printf("  %-8d %10.2f %14.0f %9.2fx\n", threads, seconds * 1000.0,
+           rayCount / seconds, baseline / seconds);
+  }
+
+  free(rays);
+  free(hits);
+  free(reference);
+  destroyWorld(world);
+  return 0;
+}
+
+// === Physics === //
+
+// Bodies wander at walking speed, turning when they walk into something
+#define WANDER_SPEED 4.0f
+
+static float benchUnit(uint32_t *random) {
+  return (benchRandom(random) & 0xffff) / 65536.0f;
+}
+
+// Highest block that isn't air in any column a box that wide at x, z
+// would stand over, or 0
+static int groundHeight(const World *world, int height, float x, float z,
+                        float halfWidth) {
+  int highest = 0;
+  for (int corner = 0; corner < 4; corner++) {
+    int bx = (int)floorf(x + (corner & 1 ? halfWidth : -halfWidth));
+    int bz = (int)floorf(z + (corner & 2 ? halfWidth : -halfWidth));
+    int ground = height * CHUNK_SIZE - 1;
+    while (ground > highest &&
+           worldGetBlock(world, bx, ground, bz) == BLOCK_AIR) {
+      ground--;
+    }
+    highest = ground;
+  }
+  return highest;
+}
+
+static void allocBodies(BodyArrays *bodies, size_t count) {
+  for (int i = 0; i < 3; i++) {
+    bodies->position[i] = malloc(count * sizeof(float));
+    bodies->velocity[i] = calloc(count, sizeof(float));
+  }
+  bodies->halfWidth = malloc(count * sizeof(float));
+  bodies->height = malloc(count * sizeof(float));
+  bodies->stepHeight = malloc(count * sizeof(float));
+  bodies->onGround = calloc(count, sizeof(bool));
+  bodies->count = count;
+}
+
+static void freeBodies(BodyArrays *bodies) {
+  for (int i = 0; i < 3; i++) {
+    free(bodies->position[i]);
+    free(bodies->velocity[i]);
+  }
+  free(bodies->halfWidth);
+  free(bodies->height);
+  free(bodies->stepHeight);
+  free(bodies->onGround);
+}
+
+// Bodies whose box overlaps a block, which collision should never allow
+static size_t bodiesInside(const World *world, const float *x, const float *y,
+                           const float *z, const float *halfWidth,
+                           const float *height, size_t count) {
+  size_t inside = 0;
+  for (size_t i = 0; i < count; i++) {
+    float min[3] = {x[i] - halfWidth[i], y[i], z[i] - halfWidth[i]};
+    float max[3] = {x[i] + halfWidth[i], y[i] + height[i], z[i] + halfWidth[i]};
+    bool found = false;
+    for (int by = (int)floorf(min[1]); by < (int)ceilf(max[1]); by++) {
+      for (int bz = (int)floorf(min[2]); bz < (int)ceilf(max[2]); bz++) {
+        for (int bx = (int)floorf(min[0]); bx < (int)ceilf(max[0]); bx++) {
+          found |= worldGetBlock(world, bx, by, bz) != BLOCK_AIR;
+        }
+      }
+    }
+    inside += found;
+  }
+  return inside;
+}
+
+// Points velocity along each heading, turning the ones that stopped
+static void wander(float *vx, float *vz, float *headings, size_t count,
+                   bool turn) {
+  for (size_t i = 0; i < count; i++) {
+    if (turn && vx[i] == 0.0f && vz[i] == 0.0f) {
+      headings[i] += 2.0f;
+    }
+    vx[i] = cosf(headings[i]) * WANDER_SPEED;
+    vz[i] = sinf(headings[i]) * WANDER_SPEED;
+  }
+}
+
+static int benchPhysics(int argc, char **argv) {
+  int maxBodies = intArg(argc, argv, 0, 3200);
+  int ticks = intArg(argc, argv, 1, 600);
+  int size = 8, height = 6;
+  float tick = 1.0f / 60.0f;
+
+  World *world = createBenchWorld(size, height);
+  float *headings = malloc((size_t)maxBodies * sizeof(float));
+  Physics physics;
+  initPhysics(&physics);
+
+  printf("physics: %d ticks of bodies wandering %dx%dx%d chunks\n", ticks,
+         size, height, size);
+  printf("  %-8s %10s %14s %12s %12s %8s\n", "bodies", "us/tick",
+         "ns/body/tick", "pairs/tick", "blocks/body", "inside");
+  for (int count = 100; count <= maxBodies; count *= 2) {
+    BodyArrays bodies;
+    allocBodies(&bodies, (size_t)count);
+
+    // Dropped onto the ground from a little above it
+    uint32_t random = BENCH_SEED;
+    float extent = (float)(size * CHUNK_SIZE);
+    for (int i = 0; i < count; i++) {
+      float x = benchUnit(&random) * extent, z = benchUnit(&random) * extent;
+      bodies.position[0][i] = x;
+      bodies.position[1][i] = groundHeight(world, height, x, z, 0.3f) + 1.5f;
+      bodies.position[2][i] = z;
+      bodies.halfWidth[i] = 0.3f;
+      bodies.height[i] = 1.8f;
+      bodies.stepHeight[i] = 1.0f;
+      headings[i] = benchUnit(&random) * 2.0f * GLM_PIf;
+    }
+
+    PhysicsStats total = {0, 0, 0};
+    double seconds = 0.0;
+    for (int t = 0; t < ticks; t++) {
+      wander(bodies.velocity[0], bodies.velocity[2], headings, (size_t)count,
+             t > 0);
+
+      double start = timerNow();
+      physicsStep(&physics, world, &bodies, tick);
+      seconds += timerNow() - start;
+      total.pairsTested += physics.stats.pairsTested;
+      total.blocksTested += physics.stats.blocksTested;
+    }
+
+    printf("  %-8d %10.2f %14.1f %12.1f %12.1f %8zu\n", count,
+           seconds / ticks * 1e6, seconds / ticks / count * 1e9,
+           (double)total.pairsTested / ticks,
+           (double)total.blocksTested / ticks / count,
+           bodiesInside(world, bodies.position[0], bodies.position[1],
+                        bodies.position[2], bodies.halfWidth, bodies.height,
+                        (size_t)count));
+    freeBodies(&bodies);
+  }
+
+  freePhysics(&physics);
+  free(headings);
+  destroyWorld(world);
+  return 0;
+}
+
+// === Entities === //
+
+// What the entity benchmark spawns, out of every 10
+#define MOBS_PER_10 1
+#define ITEMS_PER_10 1
+
+// The same particle update as moveSystem, one struct per particle holding
+// every component
+typedef struct AosParticle {
+  float position[3];
+  float velocity[3];
+  float transform[16];
+} AosParticle;
+
+static void aosParticles(AosParticle *particles, size_t count, float seconds) {
+  for (size_t i = 0; i < count; i++) {
+    AosParticle *particle = &particles[i];
+    float velocity = particle->velocity[1] - PHYSICS_GRAVITY * seconds;
+    particle->velocity[1] = velocity < -PHYSICS_TERMINAL_VELOCITY
+                                ? -PHYSICS_TERMINAL_VELOCITY
+                                : velocity;
+    for (int axis = 0; axis < 3; axis++) {
+      particle->position[axis] += particle->velocity[axis] * seconds;
+    }
+  }
+}
+
+// Mobs, dropped items and particles spread over an area that grows with
+// their number, so every entity has as many neighbours at every count
+static void spawnEntities(EntityStore *store, const World *world, int height,
+                          int count, float extent) {
+  uint32_t random = BENCH_SEED;
+  for (int i = 0; i < count; i++) {
+    int kind = i % 10;
+    ComponentMask mask = COMPONENT_POSITION | COMPONENT_VELOCITY |
+                         COMPONENT_TRANSFORM |
+                         (kind < MOBS_PER_10 + ITEMS_PER_10 ? COMPONENT_BOX
+                                                            : 0);
+    EntityId entity = createEntity(store, mask);
+
+    float position[3] = {benchUnit(&random) * extent, 0.0f,
+                         benchUnit(&random) * extent};
+    position[1] = groundHeight(world, height, position[0], position[2], 0.3f) +
+                  1.0f + benchUnit(&random) * 4.0f;
+    float velocity[3] = {benchUnit(&random) * 4.0f - 2.0f,
+                         benchUnit(&random) * 8.0f,
+                         benchUnit(&random) * 4.0f - 2.0f};
+    entitySetPosition(store, entity, position);
+    entitySetVelocity(store, entity, velocity);
+    if (kind < MOBS_PER_10) {
+      entitySetBox(store, entity, 0.3f, 1.8f, 1.0f);
+    } else if (kind < MOBS_PER_10 + ITEMS_PER_10) {
+      entitySetBox(store, entity, 0.125f, 0.25f, 0.0f);
+    }
+  }
+}
+
+static int benchEntities(int argc, char **argv) {
+  int maxEntities = intArg(argc, argv, 0, 100000);
+  int ticks = intArg(argc, argv, 1, 120);
+  int size = 16, height = 6;
+  float tick = 1.0f / 60.0f;
+
+  World *world = createBenchWorld(size, height);
+  printf("entities: %d ticks, %d0%% mobs, %d0%% items, the rest particles, "
+         "on up to %dx%dx%d chunks\n",
+         ticks, MOBS_PER_10, ITEMS_PER_10, size, height, size);
+  printf("  %-8s %9s %9s %9s %9s %10s %9s %9s %7s\n", "entities", "move",
+         "physics", "transform", "ms/tick", "ns/entity", "particles",
+         "structs", "inside");
+
+  // Smallest count spread over a quarter of the world in each direction
+  int smallest = maxEntities / 8 > 0 ? maxEntities / 8 : 1;
+  for (int count = smallest; count <= maxEntities; count *= 2) {
+    float extent = size * CHUNK_SIZE * sqrtf((float)count / maxEntities);
+    EntityStore store;
+    initEntityStore(&store);
+    spawnEntities(&store, world, height, count, extent);
+
+    // The first archetype holds the mobs
+    Archetype *mobs = &store.archetypes[0];
+    float *headings = malloc(mobs->count * sizeof(float));
+    uint32_t random = BENCH_SEED;
+    for (size_t i = 0; i < mobs->count; i++) {
+      headings[i] = benchUnit(&random) * 2.0f * GLM_PIf;
+    }
+
+    double seconds[3] = {0.0, 0.0, 0.0};
+    for (int t = 0; t < ticks; t++) {
+      wander(mobs->velocity[0], mobs->velocity[2], headings, mobs->count,
+             t > 0);
+
+      double start = timerNow();
+      moveSystem(&store, tick);
+      double moved = timerNow();
+      physicsSystem(&store, world, tick);
+      double collided = timerNow();
+      transformSystem(&store);
+      double transformed = timerNow();
+      seconds[0] += moved - start;
+      seconds[1] += collided - moved;
+      seconds[2] += transformed - collided;
+    }
+
+    // Just moving the particles, through the system and as structs
+    size_t particleCount = 0;
+    for (int a = 0; a < store.archetypeCount; a++) {
+      if (!(store.archetypes[a].mask & COMPONENT_BOX)) {
+        particleCount += store.archetypes[a].count;
+      }
+    }
+    EntityStore particleStore;
+    initEntityStore(&particleStore);
+    for (size_t i = 0; i < particleCount; i++) {
+      createEntity(&particleStore, COMPONENT_POSITION | COMPONENT_VELOCITY |
+                                       COMPONENT_TRANSFORM);
+    }
+    double start = timerNow();
+    for (int t = 0; t < ticks; t++) {
+      moveSystem(&particleStore, tick);
+    }
+    double soaSeconds = timerNow() - start;
+    freeEntityStore(&particleStore);
+
+    AosParticle *particles = calloc(particleCount, sizeof(AosParticle));
+    start = timerNow();
+    for (int t = 0; t < ticks; t++) {
+      aosParticles(particles, particleCount, tick);
+    }
+    double aosSeconds = timerNow() - start;
+    free(particles);
+
+    size_t inside = 0;
+    for (int a = 0; a < store.archetypeCount; a++) {
+      Archetype *archetype = &store.archetypes[a];
+      if (archetype->mask & COMPONENT_BOX) {
+        inside += bodiesInside(world, archetype->position[0],
+                               archetype->position[1], archetype->position[2],
+                               archetype->halfWidth, archetype->height,
+                               archetype->count);
+      }
+    }
+
+    // Systems in ms per tick, then moving particles alone against the same
+    // work done on structs
+    double total = seconds[0] + seconds[1] + seconds[2];
+    printf("  %-8d %9.3f %9.3f %9.3f %9.3f %10.1f %9.3f %9.3f %7zu\n",
+           count, seconds[0] / ticks * 1000.0, seconds[1] / ticks * 1000.0,
+           seconds[2] / ticks * 1000.0, total / ticks * 1000.0,
+           total / ticks / count * 1e9, soaSeconds / ticks * 1000.0,
+           aosSeconds / ticks * 1000.0, inside);
+
+    free(headings);
+    freeEntityStore(&store);
+  }
+
+  destroyWorld(world);
+  return 0;
+}
+
+// === Region files === //
+
+// Removes the region files covering size x height x size chunks
+static void removeRegions(const char *directory, int size, int height) {
+  for (int ry = 0; ry <= (height - 1) >> REGION_SHIFT; ry++) {
+    for (int rz = 0; rz <= (size - 1) >> REGION_SHIFT; rz++) {
+      for (int rx = 0; rx <= (size - 1) >> REGION_SHIFT; rx++) {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/r.%d.%d.%d.bin", directory, rx, ry,
+                 rz);
+        remove(path);
+      }
+    }
+  }
+}
+
+static int benchRegion(int argc, char **argv) {
+  int size = intArg(argc, argv, 0, 16);
+  int height = intArg(argc, argv, 1, 6);
+  const char *directory = argc > 2 ? argv[2] : "bench-regions";
+
+  World *world = createBenchWorld(size, height);
+  double chunkCount = (double)world->chunkCount;
+  double rawBytes = chunkCount * CHUNK_VOLUME * sizeof(BlockId);
+
+  printf("region: %dx%dx%d chunks (%.1f MB of blocks) in %s\n", size, height,
+         size, rawBytes / (1024.0 * 1024.0), directory);
+  printf("  %-6s %10s %10s %10s %10s %8s\n", "codec", "save/s", "save MB/s",
+         "load/s", "load MB/s", "ratio");
+
+  for (int c = 0; c < REGION_COMPRESS_COUNT; c++) {
+    RegionCompression compression = (RegionCompression)c;
+    if (!regionCompressionSupported(compression)) {
+      printf("  %-6s not built in\n", regionCompressionName(compression));
+      continue;
+    }
+
+    RegionCache *cache = createRegionCache(directory, compression);
+    if (cache == NULL) {
+      destroyWorld(world);
+      return 1;
+    }
+    removeRegions(directory, size, height);
+
+    // Saving includes the syncs that make it durable
+    size_t iter = 0;
+    Chunk *chunk;
+    double start = timerNow();
+    while ((chunk = worldNextChunk(world, &iter)) != NULL) {
+      regionCacheSave(cache, chunk);
+    }
+    regionCacheFlush(cache);
+    double saveSeconds = timerNow() - start;
+
+    size_t fileBytes = 0;
+    for (int i = 0; i < cache->regionCount; i++) {
+      fileBytes += regionFileBytes(cache->regions[i]);
+    }
+    destroyRegionCache(cache);
+
+    // Loads come from the page cache, so this is decoding speed rather than
+    // disk speed
+    cache = createRegionCache(directory, compression);
+    int mismatches = 0;
+    iter = 0;
+    start = timerNow();
+    while ((chunk = worldNextChunk(world, &iter)) != NULL) {
+      Chunk *loaded = regionCacheLoad(cache, chunk->x, chunk->y, chunk->z);
+      if (loaded == NULL || !sameBlocks(loaded, chunk)) {
+        mismatches++;
+      }
+      if (loaded != NULL) {
+        destroyChunk(loaded);
+      }
+    }
+    double loadSeconds = timerNow() - start;
+    destroyRegionCache(cache);
+    removeRegions(directory, size, height);
+
+    printf("  %-6s %10.0f %10.1f %10.0f %10.1f %7.1fx\n",
+           regionCompressionName(compression), chunkCount / saveSeconds,
+           rawBytes / saveSeconds / (1024.0 * 1024.0),
+           chunkCount / loadSeconds,
+           rawBytes / loadSeconds / (1024.0 * 1024.0), rawBytes / fileBytes);
+    if (mismatches > 0) {
+      printf("  %d chunks did not load back the same\n", mismatches);
+      destroyWorld(world);
+      return 1;
+    }
+  }
+
+  destroyWorld(world);
+  return 0;
+}
+
+#ifndef _WIN32
+
+// Chunks written by the crash check, a 4x4x4 corner of one region
+#define CRASH_CHUNKS 4
+
+// Every version fills a chunk differently and records itself in the first
+// two blocks, so a chunk can be checked without knowing what was written
+static void crashPattern(Chunk *chunk, uint32_t version) {
+  uint32_t state = (version * 2654435761u) ^
+                   (uint32_t)(chunk->x + chunk->y * 7 + chunk->z * 49) ^ 1;
+  BlockId blocks[CHUNK_VOLUME];
+  for (int i = 2; i < CHUNK_VOLUME; i++) {
+    blocks[i] = (BlockId)(benchRandom(&state) % (1 + version % 40));
+  }
+  blocks[0] = (BlockId)version;
+  blocks[1] = (BlockId)(version >> 16);
+  chunkSetBlocks(chunk, blocks);
+}
+
+// Rewrites every chunk over and over, flushing after each pass and telling
+// the parent which version is now durable. Only ever stopped by SIGKILL
+static void crashWriter(const char *directory, RegionCompression compression,
+                        uint32_t version, int pipe) {
+  RegionCache *cache = createRegionCache(directory, compression);
+  if (cache == NULL) {
+    _exit(1);
+  }
+
+  Chunk *chunk = createChunk(0, 0, 0);
+  for (;; version++) {
+    for (int i = 0; i < CRASH_CHUNKS * CRASH_CHUNKS * CRASH_CHUNKS; i++) {
+      chunk->x = i % CRASH_CHUNKS;
+      chunk->y = i / (CRASH_CHUNKS * CRASH_CHUNKS);
+      chunk->z = i / CRASH_CHUNKS % CRASH_CHUNKS;
+      crashPattern(chunk, version);
+      if (!regionCacheSave(cache, chunk)) {
+        _exit(1);
+      }
+    }
+    if (!regionCacheFlush(cache) ||
+        write(pipe, &version, sizeof(version)) != sizeof(version)) {
+      _exit(1);
+    }
+  }
+}
+
+// Overwrites the header copy with the highest generation, as if the machine
+// lost power while writing it
+static bool tearNewestHeader(const char *path) {
+  FILE *file = fopen(path, "r+b");
+  if (file == NULL) {
+    return false;
+  }
+
+  RegionHeader headers[2];
+  long offsets[2] = {0, REGION_HEADER_SIZE};
+  for (int i = 0; i < 2; i++) {
+    fseek(file, offsets[i], SEEK_SET);
+    if (fread(&headers[i], sizeof(RegionHeader), 1, file) != 1) {
+      fclose(file);
+      return false;
+    }
+  }
+
+  // Only once both copies exist, otherwise there is nothing to fall back to
+  bool torn = headers[0].magic == headers[1].magic &&
+              headers[0].generation > 0 && headers[1].generation > 0;
+  if (torn) {
+    int newest = headers[1].generation > headers[0].generation;
+    char garbage[512];
+    memset(garbage, 0x5a, sizeof(garbage));
+    fseek(file, offsets[newest] + 1024, SEEK_SET);
+    fwrite(garbage, sizeof(garbage), 1, file);
+  }
+  fclose(file);
+  return torn;
+}
+
+// Kills a process while it saves, then checks every chunk on disk is whole
+// and no older than the last flush that finished
+static int benchRegionCrash(int argc, char **argv) {
+  int rounds = intArg(argc, argv, 0, 50);
+  const char *directory = argc > 1 ? argv[1] : "bench-regions";
+
+  // The strongest compression built in
+  int compression = REGION_COMPRESS_COUNT - 1;
+  while (!regionCompressionSupported(compression)) {
+    compression--;
+  }
+
+  RegionCache *cache = createRegionCache(directory, compression);
+  if (cache == NULL) {
+    return 1;
+  }
+  destroyRegionCache(cache);
+  removeRegions(directory, CRASH_CHUNKS, CRASH_CHUNKS);
+
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/r.0.0.0.bin", directory);
+  printf("region crash: %d rounds of SIGKILL during saves, %s compression\n",
+         rounds, regionCompressionName(compression));
+
+  uint32_t rng = 0x9e3779b9u;
+  uint32_t durable = 0, previous = 0, version = 1;
+  int failures = 0, tornHeaders = 0;
+  Chunk *chunk = createChunk(0, 0, 0);
+
+  for (int round = 0; round < rounds && failures == 0; round++) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+      return 1;
+    }
+
+    pid_t child = fork();
+    if (child == 0) {
+      close(fds[0]);
+      crashWriter(directory, compression, version, fds[1]);
+    }
+    close(fds[1]);
+
+    struct timespec delay = {0, (long)(1 + benchRandom(&rng) % 40) * 1000000};
+    nanosleep(&delay, NULL);
+    kill(child, SIGKILL);
+    waitpid(child, NULL, 0);
+
+    uint32_t flushed;
+    while (read(fds[0], &flushed, sizeof(flushed)) == sizeof(flushed)) {
+      previous = durable;
+      durable = flushed;
+    }
+    close(fds[0]);
+    version = durable + 2;
+
+    // A torn header loses the last flush but nothing before it
+    if (benchRandom(&rng) % 4 == 0 && tearNewestHeader(path)) {
+      durable = previous;
+      tornHeaders++;
+    }
+
+    Region *region = openRegion(path, 0, 0, 0);
+    if (region == NULL) {
+      printf("  round %d: region did not open\n", round);
+      failures++;
+      continue;
+    }
+
+    for (int i = 0; i < CRASH_CHUNKS * CRASH_CHUNKS * CRASH_CHUNKS; i++) {
+      int x = i % CRASH_CHUNKS;
+      int y = i / (CRASH_CHUNKS * CRASH_CHUNKS);
+      int z = i / CRASH_CHUNKS % CRASH_CHUNKS;
+      Chunk *loaded = regionLoadChunk(region, x, y, z);
+      if (loaded == NULL) {
+        // Nothing is on disk until the first flush finishes
+        failures += durable > 0 || regionHasChunk(region, x, y, z);
+        continue;
+      }
+
+      uint32_t found = chunkGetBlock(loaded, 0, 0, 0) |
+                       (uint32_t)chunkGetBlock(loaded, 1, 0, 0) << 16;
+      chunk->x = x;
+      chunk->y = y;
+      chunk->z = z;
+      crashPattern(chunk, found);
+      if (found < durable || !sameBlocks(loaded, chunk)) {
+        printf("  round %d: chunk %d %d %d has version %u, expected %u+\n",
+               round, x, y, z, found, durable);
+        failures++;
+      }
+      destroyChunk(loaded);
+    }
+
+    printf("  round %2d: %u passes durable, file %zu KB\n", round, durable,
+           regionFileBytes(region) / 1024);
+    closeRegion(region);
+  }
+
+  destroyChunk(chunk);
+  removeRegions(directory, CRASH_CHUNKS, CRASH_CHUNKS);
+  printf("  %d torn headers recovered, %d failures\n", tornHeaders, failures);
+  return failures > 0 ? 1 : 0;
+}
+
+#endif
+
+static const Benchmark benchmarks[] = {
+    {"chunk", "[size]", benchChunk},
+    {"mesh", "[size]", benchMesh},
+    {"light", "[size] [height] [edits]", benchLight},
+    {"meshpool", "[chunks] [max threads]", benchMeshPool},
+    {"raycast", "[rays] [distance] [max threads]", benchRaycast},
+    {"physics", "[max bodies] [ticks]", benchPhysics},
+    {"entities", "[max entities] [ticks]", benchEntities},
+    {"terrain", "[size] [height] [avx2|sse2|scalar] [dump file]",
+     benchTerrain},
+    {"frustum", "[size] [frames]", benchFrustum},
+    {"region", "[size] [height] [directory]", benchRegion},
+#ifndef _WIN32
+    {"regioncrash", "[rounds] [directory]", benchRegionCrash},
+#endif
+};
+
+#define BENCHMARK_COUNT (sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+int runBenchmark(int argc, char **argv) {
+  if (argc > 0) {
+    for (size_t i = 0; i < BENCHMARK_COUNT; i++) {
+      if (strcmp(argv[0], benchmarks[i].name) == 0) {
+        return benchmarks[i].run(argc - 1, argv + 1);
+      }
+    }
+  }
+
+  printf("Usage: minecraft --bench <name> [args]\n");
+  for (size_t i = 0; i < BENCHMARK_COUNT; i++) {
+    printf("  %s %s\n", benchmarks[i].name, benchmarks[i].usage);
+  }
+  return 1;
+}
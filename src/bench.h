@@ -0,0 +1,14 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+
+// Runs a headless benchmark by name, e.g. `minecraft --bench chunk`.
+// Returns the process exit code
+int runBenchmark(int argc, char **argv);
+
+// Nearest rank, so the result is always one of the values, and rank 100 is
+// the largest. The values are left as they are. 0 when there are none
+double benchPercentile(const double *values, size_t count, double rank);
+
+#endif
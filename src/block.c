@@ -0,0 +1,28 @@
+#include "block.h"
+
+const TileInfo tileInfo[TILE_COUNT] = {
+    [TILE_STONE] = {"stone", {125, 125, 125}},
+    [TILE_DIRT] = {"dirt", {134, 96, 67}},
+    [TILE_GRASS_TOP] = {"grass", {95, 159, 53}},
+    [TILE_GRASS_SIDE] = {"grass_side", {112, 128, 62}},
+    [TILE_SAND] = {"sand", {219, 207, 163}},
+    [TILE_SNOW] = {"snow", {240, 251, 251}},
+    [TILE_LAMP] = {"lamp", {255, 214, 140}},
+};
+
+#define ALL_FACES(tile) {tile, tile, tile, tile, tile, tile}
+
+// Face order: +x, -x, +y, -y, +z, -z
+const BlockInfo blockInfo[BLOCK_COUNT] = {
+    [BLOCK_AIR] = {"air", false, 0, ALL_FACES(0)},
+    [BLOCK_STONE] = {"stone", true, 0, ALL_FACES(TILE_STONE)},
+    [BLOCK_DIRT] = {"dirt", true, 0, ALL_FACES(TILE_DIRT)},
+    [BLOCK_GRASS] = {"grass",
+                     true,
+                     0,
+                     {TILE_GRASS_SIDE, TILE_GRASS_SIDE, TILE_GRASS_TOP,
+                      TILE_DIRT, TILE_GRASS_SIDE, TILE_GRASS_SIDE}},
+    [BLOCK_SAND] = {"sand", true, 0, ALL_FACES(TILE_SAND)},
+    [BLOCK_SNOW] = {"snow", true, 0, ALL_FACES(TILE_SNOW)},
+    [BLOCK_LAMP] = {"lamp", true, 14, ALL_FACES(TILE_LAMP)},
+};
@@ -0,0 +1,73 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef uint16_t BlockId;
+
+enum {
+  BLOCK_AIR = 0,
+  BLOCK_STONE,
+  BLOCK_DIRT,
+  BLOCK_GRASS,
+  BLOCK_SAND,
+  BLOCK_SNOW,
+  BLOCK_LAMP,
+  BLOCK_COUNT
+};
+
+// Faces are ordered by axis, positive direction first
+typedef enum BlockFace {
+  FACE_POS_X = 0,
+  FACE_NEG_X,
+  FACE_POS_Y,
+  FACE_NEG_Y,
+  FACE_POS_Z,
+  FACE_NEG_Z,
+  FACE_COUNT
+} BlockFace;
+
+// Texture tiles that block faces can use
+enum {
+  TILE_STONE = 0,
+  TILE_DIRT,
+  TILE_GRASS_TOP,
+  TILE_GRASS_SIDE,
+  TILE_SAND,
+  TILE_SNOW,
+  TILE_LAMP,
+  TILE_COUNT
+};
+
+// Tiles are loaded from assets/textures/<name>.png, or filled with their
+// color if there is no such file
+typedef struct TileInfo {
+  const char *name;
+  uint8_t color[3];
+} TileInfo;
+
+typedef struct BlockInfo {
+  const char *name;
+  bool opaque;
+  uint8_t light; // Block light given off, 0 for none
+  uint16_t tiles[FACE_COUNT];
+} BlockInfo;
+
+extern const TileInfo tileInfo[TILE_COUNT];
+
+extern const BlockInfo blockInfo[BLOCK_COUNT];
+
+static inline bool blockIsOpaque(BlockId block) {
+  return block < BLOCK_COUNT && blockInfo[block].opaque;
+}
+
+static inline uint8_t blockLight(BlockId block) {
+  return block < BLOCK_COUNT ? blockInfo[block].light : 0;
+}
+
+static inline uint16_t blockTile(BlockId block, BlockFace face) {
+  return blockInfo[block].tiles[face];
+}
+
+#endif
@@ -0,0 +1,77 @@
+#include <math.h>
+#include "camera.h"
+
+// Just short of straight up or down, where yaw stops meaning anything
+#define MAX_PITCH 1.55f
+
+// Radians in a whole turn
+#define TURN 6.28318531f
+
+static void forward(const Camera *camera, float out[3]) {
+  out[0] = cosf(camera->pitch) * cosf(camera->yaw);
+  out[1] = sinf(camera->pitch);
+  out[2] = cosf(camera->pitch) * sinf(camera->yaw);
+}
+
+void cameraLookAt(Camera *camera, const float eye[3], const float target[3]) {
+  float dx = target[0] - eye[0], dy = target[1] - eye[1];
+  float dz = target[2] - eye[2];
+  for (int i = 0; i < 3; i++) {
+    camera->position[i] = eye[i];
+  }
+  camera->yaw = atan2f(dz, dx);
+  camera->pitch = atan2f(dy, sqrtf(dx * dx + dz * dz));
+}
+
+void cameraTurn(Camera *camera, float dx, float dy) {
+  camera->yaw = fmodf(camera->yaw + dx * CAMERA_SENSITIVITY, TURN);
+
+  // Screen y goes down
+  camera->pitch -= dy * CAMERA_SENSITIVITY;
+  camera->pitch = camera->pitch > MAX_PITCH ? MAX_PITCH : camera->pitch;
+  camera->pitch = camera->pitch < -MAX_PITCH ? -MAX_PITCH : camera->pitch;
+}
+
+void cameraVelocity(const Camera *camera, const bool held[ACTION_COUNT],
+                    float velocity[3]) {
+  float ahead[3];
+  if (camera->flying) {
+    forward(camera, ahead);
+  } else {
+    ahead[0] = cosf(camera->yaw);
+    ahead[1] = 0.0f;
+    ahead[2] = sinf(camera->yaw);
+  }
+  float right[3] = {-sinf(camera->yaw), 0.0f, cosf(camera->yaw)};
+
+  float move[3] = {0.0f, 0.0f, 0.0f};
+  float forwards = (float)held[ACTION_FORWARD] - (float)held[ACTION_BACK];
+  float sideways = (float)held[ACTION_RIGHT] - (float)held[ACTION_LEFT];
+  float upwards = (float)held[ACTION_UP] - (float)held[ACTION_DOWN];
+  for (int i = 0; i < 3; i++) {
+    move[i] = ahead[i] * forwards + right[i] * sideways;
+  }
+  if (camera->flying) {
+    move[1] += upwards;
+  }
+
+  // Diagonals are no faster than straight lines
+  float length = sqrtf(move[0] * move[0] + move[1] * move[1] +
+                       move[2] * move[2]);
+  float speed = camera->flying ? CAMERA_FLY_SPEED : CAMERA_WALK_SPEED;
+  for (int i = 0; i < 3; i++) {
+    if (i == 1 && !camera->flying) {
+      continue;
+    }
+    velocity[i] = length > 0.0f ? move[i] / length * speed : 0.0f;
+  }
+}
+
+void cameraEyeTarget(const Camera *camera, float eye[3], float target[3]) {
+  float ahead[3];
+  forward(camera, ahead);
+  for (int i = 0; i < 3; i++) {
+    eye[i] = camera->position[i];
+    target[i] = camera->position[i] + ahead[i];
+  }
+}
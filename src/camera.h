@@ -0,0 +1,36 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <stdbool.h>
+#include "input.h"
+
+// Blocks per second
+#define CAMERA_FLY_SPEED 20.0f
+#define CAMERA_WALK_SPEED 5.0f
+
+// Radians turned per pixel the mouse moves
+#define CAMERA_SENSITIVITY 0.002f
+
+// First person camera. Yaw turns around y from +x towards +z, pitch looks
+// up from level
+typedef struct Camera {
+  float position[3];
+  float yaw, pitch;
+  bool flying; // Flying moves where it looks, walking stays level
+} Camera;
+
+// Puts the camera at eye looking towards target
+void cameraLookAt(Camera *camera, const float eye[3], const float target[3]);
+
+// Turns by a mouse movement, never looking past straight up or down
+void cameraTurn(Camera *camera, float dx, float dy);
+
+// How fast whichever actions are held move it, in blocks per second.
+// Walking leaves velocity[1] alone, falling and jumping are up to physics
+void cameraVelocity(const Camera *camera, const bool held[ACTION_COUNT],
+                    float velocity[3]);
+
+// Where it is and a point one block ahead of it
+void cameraEyeTarget(const Camera *camera, float eye[3], float target[3]);
+
+#endif
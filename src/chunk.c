@@ -0,0 +1,308 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chunk.h"
+
+// Past this many different blocks the data holds BlockIds directly
+#define MAX_PALETTE 256
+
+static int paletteBits(int paletteSize) {
+  if (paletteSize <= 1) {
+    return 0;
+  }
+  if (paletteSize <= 2) {
+    return 1;
+  }
+  if (paletteSize <= 4) {
+    return 2;
+  }
+  if (paletteSize <= 16) {
+    return 4;
+  }
+  return paletteSize <= MAX_PALETTE ? 8 : 16;
+}
+
+static int paletteCapacity(int bits) {
+  return bits == 16 ? 0 : 1 << bits;
+}
+
+static size_t dataWords(int bits) { return CHUNK_VOLUME / 64 * bits; }
+
+// Switches to a new width, leaving the palette and data unset
+static void resizeStorage(Chunk *chunk, int bits) {
+  chunk->bits = (uint8_t)bits;
+  chunk->bitsShift = 0;
+  while ((1 << chunk->bitsShift) < bits) {
+    chunk->bitsShift++;
+  }
+
+  int capacity = paletteCapacity(bits);
+  if (capacity == 0) {
+    free(chunk->palette);
+    chunk->palette = NULL;
+  } else {
+    chunk->palette = realloc(chunk->palette, capacity * sizeof(BlockId));
+  }
+
+  if (bits == 0) {
+    free(chunk->data);
+    chunk->data = NULL;
+  } else {
+    chunk->data = realloc(chunk->data, dataWords(bits) * sizeof(uint64_t));
+  }
+}
+
+static unsigned readIndex(const Chunk *chunk, int i) {
+  unsigned bit = (unsigned)i << chunk->bitsShift;
+  return (unsigned)(chunk->data[bit >> 6] >> (bit & 63)) &
+         ((1u << chunk->bits) - 1);
+}
+
+static void writeIndex(Chunk *chunk, int i, unsigned index) {
+  unsigned bit = (unsigned)i << chunk->bitsShift;
+  uint64_t mask = ((uint64_t)1 << chunk->bits) - 1;
+  uint64_t *word = &chunk->data[bit >> 6];
+  *word = (*word & ~(mask << (bit & 63))) | ((uint64_t)index << (bit & 63));
+}
+
+// Recomputes the cell bits from scratch
+static void updateOccupancy(Chunk *chunk) {
+  if (chunk->bits == 0) {
+    BlockId block = chunk->palette[0];
+    chunk->occupied = block != BLOCK_AIR ? UINT64_MAX : 0;
+    chunk->opaque = blockIsOpaque(block) ? UINT64_MAX : 0;
+    return;
+  }
+
+  // Bit 0 for air and bit 1 for blocks that aren't opaque, looked up per
+  // palette entry rather than per block
+  uint8_t flags[MAX_PALETTE];
+  for (int p = 0; p < chunk->paletteSize; p++) {
+    flags[p] = (chunk->palette[p] == BLOCK_AIR ? 1 : 0) |
+               (blockIsOpaque(chunk->palette[p]) ? 0 : 2);
+  }
+
+  uint64_t notAir = 0, notOpaque = 0;
+  for (int i = 0; i < CHUNK_VOLUME; i++) {
+    unsigned index = readIndex(chunk, i);
+    BlockId block = (BlockId)index;
+    unsigned blockFlags =
+        chunk->bits == 16
+            ? (block == BLOCK_AIR ? 1 : 0) | (blockIsOpaque(block) ? 0 : 2)
+            : flags[index];
+    uint64_t cell = (uint64_t)1
+                    << CHUNK_CELL_INDEX(i & CHUNK_MASK,
+                                        i >> (2 * CHUNK_SHIFT),
+                                        (i >> CHUNK_SHIFT) & CHUNK_MASK);
+    notAir |= (blockFlags & 1) ? 0 : cell;
+    notOpaque |= (blockFlags & 2) ? cell : 0;
+  }
+  chunk->occupied = notAir;
+  chunk->opaque = ~notOpaque;
+}
+
+Chunk *createChunk(int x, int y, int z) {
+  Chunk *chunk = calloc(1, sizeof(Chunk));
+  if (chunk == NULL) {
+    return NULL;
+  }
+
+  chunk->x = x;
+  chunk->y = y;
+  chunk->z = z;
+
+  resizeStorage(chunk, 0);
+  chunk->palette[0] = BLOCK_AIR;
+  chunk->paletteSize = 1;
+  updateOccupancy(chunk);
+
+  return chunk;
+}
+
+void destroyChunk(Chunk *chunk) {
+  if (chunk != NULL) {
+    free(chunk->palette);
+    free(chunk->data);
+    free(chunk->light);
+  }
+  free(chunk);
+}
+
+void chunkSetBlock(Chunk *chunk, int x, int y, int z, BlockId block) {
+  int i = CHUNK_INDEX(x, y, z);
+  chunk->modified = true;
+
+  uint64_t cell = (uint64_t)1 << CHUNK_CELL_INDEX(x, y, z);
+  chunk->occupied |= block != BLOCK_AIR ? cell : 0;
+  chunk->opaque &= blockIsOpaque(block) ? UINT64_MAX : ~cell;
+
+  if (chunk->bits == 16) {
+    writeIndex(chunk, i, block);
+    return;
+  }
+
+  // Scans the whole palette whichever entry matches, so random blocks don't
+  // make the loop exit unpredictable
+  int index = chunk->paletteSize;
+  for (int p = chunk->paletteSize - 1; p >= 0; p--) {
+    index = chunk->palette[p] == block ? p : index;
+  }
+
+  if (index == chunk->paletteSize) {
+    if (index == paletteCapacity(chunk->bits)) {
+      // Repacking drops blocks that were overwritten since, and only widens
+      // the indices if the palette is still full after that
+      BlockId blocks[CHUNK_VOLUME];
+      chunkGetBlocks(chunk, blocks);
+      blocks[i] = block;
+      chunkSetBlocks(chunk, blocks);
+      return;
+    }
+    chunk->palette[chunk->paletteSize++] = block;
+  }
+
+  // A uniform chunk only gets here when the block is already there
+  if (chunk->bits != 0) {
+    writeIndex(chunk, i, (unsigned)index);
+  }
+}
+
+void chunkFill(Chunk *chunk, BlockId block) {
+  resizeStorage(chunk, 0);
+  chunk->palette[0] = block;
+  chunk->paletteSize = 1;
+  chunk->modified = true;
+  updateOccupancy(chunk);
+}
+
+void chunkGetBlocks(const Chunk *chunk, BlockId *blocks) {
+  if (chunk->bits == 0) {
+    for (int i = 0; i < CHUNK_VOLUME; i++) {
+      blocks[i] = chunk->palette[0];
+    }
+    return;
+  }
+
+  int bits = chunk->bits;
+  int perWord = 64 / bits;
+  uint64_t mask = ((uint64_t)1 << bits) - 1;
+  for (size_t w = 0; w < dataWords(bits); w++) {
+    uint64_t word = chunk->data[w];
+    BlockId *out = &blocks[w * perWord];
+    if (bits == 16) {
+      for (int i = 0; i < perWord; i++) {
+        out[i] = (BlockId)(word >> (i * 16));
+      }
+    } else {
+      for (int i = 0; i < perWord; i++) {
+        out[i] = chunk->palette[(word >> (i * bits)) & mask];
+      }
+    }
+  }
+}
+
+void chunkSetBlocks(Chunk *chunk, const BlockId *blocks) {
+  BlockId palette[MAX_PALETTE];
+  uint8_t indices[CHUNK_VOLUME];
+  int paletteSize = 0;
+
+  // Terrain is mostly runs of the same block, so check the last one first
+  int last = -1;
+  for (int i = 0; i < CHUNK_VOLUME && paletteSize <= MAX_PALETTE; i++) {
+    BlockId block = blocks[i];
+    if (last >= 0 && palette[last] == block) {
+      indices[i] = (uint8_t)last;
+      continue;
+    }
+
+    int index = 0;
+    while (index < paletteSize && palette[index] != block) {
+      index++;
+    }
+    if (index == paletteSize) {
+      if (paletteSize == MAX_PALETTE) {
+        paletteSize++;
+        break;
+      }
+      palette[paletteSize++] = block;
+    }
+    indices[i] = (uint8_t)index;
+    last = index;
+  }
+
+  int bits = paletteBits(paletteSize);
+  resizeStorage(chunk, bits);
+  chunk->paletteSize = (uint16_t)(bits == 16 ? 0 : paletteSize);
+  chunk->modified = true;
+
+  if (bits == 16) {
+    for (int i = 0; i < CHUNK_VOLUME; i++) {
+      writeIndex(chunk, i, blocks[i]);
+    }
+    updateOccupancy(chunk);
+    return;
+  }
+
+  memcpy(chunk->palette, palette, paletteSize * sizeof(BlockId));
+  if (bits == 0) {
+    updateOccupancy(chunk);
+    return;
+  }
+
+  int perWord = 64 / bits;
+  for (size_t w = 0; w < dataWords(bits); w++) {
+    uint64_t word = 0;
+    const uint8_t *source = &indices[w * perWord];
+    for (int i = 0; i < perWord; i++) {
+      word |= (uint64_t)source[i] << (i * bits);
+    }
+    chunk->data[w] = word;
+  }
+  updateOccupancy(chunk);
+}
+
+void chunkSetPacked(Chunk *chunk, const BlockId *palette, int paletteSize,
+                    const uint64_t *words) {
+  int bits = paletteBits(paletteSize);
+  resizeStorage(chunk, bits);
+  chunk->paletteSize = (uint16_t)paletteSize;
+  chunk->modified = true;
+
+  memcpy(chunk->palette, palette, paletteSize * sizeof(BlockId));
+  if (bits != 0) {
+    memcpy(chunk->data, words, dataWords(bits) * sizeof(uint64_t));
+  }
+  updateOccupancy(chunk);
+}
+
+bool chunkIsUniform(const Chunk *chunk) { return chunk->bits == 0; }
+
+bool chunkFaceOpaque(const Chunk *chunk, BlockFace face) {
+  // Cells touching each face, in BlockFace order
+  static const uint64_t faceCells[FACE_COUNT] = {
+      0x8888888888888888ull, 0x1111111111111111ull, 0xffff000000000000ull,
+      0x000000000000ffffull, 0xf000f000f000f000ull, 0x000f000f000f000full};
+  return (chunk->opaque & faceCells[face]) == faceCells[face];
+}
+
+void chunkSetLight(Chunk *chunk, int x, int y, int z, uint8_t light) {
+  if (chunk->light == NULL) {
+    if (light == chunk->uniformLight) {
+      return;
+    }
+    chunk->light = malloc(CHUNK_VOLUME);
+    memset(chunk->light, chunk->uniformLight, CHUNK_VOLUME);
+  }
+  chunk->light[CHUNK_INDEX(x, y, z)] = light;
+}
+
+void chunkFillLight(Chunk *chunk, uint8_t light) {
+  free(chunk->light);
+  chunk->light = NULL;
+  chunk->uniformLight = light;
+}
+
+size_t chunkMemoryUsage(const Chunk *chunk) {
+  return sizeof(*chunk) + paletteCapacity(chunk->bits) * sizeof(BlockId) +
+         dataWords(chunk->bits) * sizeof(uint64_t) +
+         (chunk->light != NULL ? CHUNK_VOLUME : 0);
+}
@@ -0,0 +1,126 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "block.h"
+
+// Chunks are 16x16x16 cubes, so the world can grow in every direction
+#define CHUNK_SHIFT 4
+#define CHUNK_SIZE (1 << CHUNK_SHIFT)
+#define CHUNK_MASK (CHUNK_SIZE - 1)
+#define CHUNK_VOLUME (CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE)
+
+// Blocks are laid out x first, then z, then y, so a horizontal layer is
+// contiguous in memory
+#define CHUNK_INDEX(x, y, z)                                                   \
+  ((x) + ((z) << CHUNK_SHIFT) + ((y) << (2 * CHUNK_SHIFT)))
+
+// Chunks are split into 4x4x4 cells of 4x4x4 blocks, so empty and solid
+// space can be skipped a cell at a time. Cells are laid out like blocks, and
+// indexed by the local coordinates of any block in them
+#define CHUNK_CELL_SHIFT 2
+#define CHUNK_CELLS (CHUNK_SIZE >> CHUNK_CELL_SHIFT)
+#define CHUNK_CELL_INDEX(x, y, z)                                              \
+  (((x) >> CHUNK_CELL_SHIFT) + (((z) >> CHUNK_CELL_SHIFT) << 2) +              \
+   (((y) >> CHUNK_CELL_SHIFT) << 4))
+
+typedef struct Chunk {
+  // Chunk coordinates (world position divided by CHUNK_SIZE)
+  int x, y, z;
+
+  // Set by any block change, cleared once the chunk is saved
+  bool modified;
+
+  // Blocks are stored as indices into a palette of the blocks in the chunk,
+  // packed bits to an index so none straddle two words. With one block in
+  // the palette there is no data at all, and past 256 blocks the data holds
+  // BlockIds directly with no palette
+  uint8_t bits; // 0, 1, 2, 4, 8 or 16
+  uint8_t bitsShift; // log2 of bits
+  uint16_t paletteSize;
+  BlockId *palette;
+  uint64_t *data;
+
+  // One bit per cell. Setting single blocks keeps these conservative, so
+  // occupied may include cells that were emptied since and opaque may miss
+  // cells that were filled in, until the chunk is next set as a whole
+  uint64_t occupied; // Cells that may hold something other than air
+  uint64_t opaque;   // Cells where every block is opaque
+
+  // Light of every block, sky light in the high 4 bits and block light in
+  // the low 4. NULL while the whole chunk has uniformLight
+  uint8_t *light;
+  uint8_t uniformLight;
+  uint8_t lightChanged; // Bookkeeping for the light engine
+} Chunk;
+
+// For tables keyed on chunk coordinates
+static inline size_t chunkHash(int x, int y, int z) {
+  uint32_t h = (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u ^
+               (uint32_t)z * 83492791u;
+
+  // Finalizer so neighbouring chunks don't land in neighbouring slots
+  h ^= h >> 16;
+  h *= 0x7feb352du;
+  h ^= h >> 15;
+  h *= 0x846ca68bu;
+  h ^= h >> 16;
+
+  return h;
+}
+
+Chunk *createChunk(int x, int y, int z);
+
+void destroyChunk(Chunk *chunk);
+
+// Local coordinates must be within [0, CHUNK_SIZE). Inline since meshing and
+// lighting call it for nearly every block
+static inline BlockId chunkGetBlock(const Chunk *chunk, int x, int y, int z) {
+  if (chunk->bits == 0) {
+    return chunk->palette[0];
+  }
+
+  unsigned bit = (unsigned)CHUNK_INDEX(x, y, z) << chunk->bitsShift;
+  unsigned index = (unsigned)(chunk->data[bit >> 6] >> (bit & 63)) &
+                   ((1u << chunk->bits) - 1);
+  return chunk->bits == 16 ? (BlockId)index : chunk->palette[index];
+}
+
+void chunkSetBlock(Chunk *chunk, int x, int y, int z, BlockId block);
+
+void chunkFill(Chunk *chunk, BlockId block);
+
+// Unpacks every block, laid out by CHUNK_INDEX
+void chunkGetBlocks(const Chunk *chunk, BlockId *blocks);
+
+// Replaces every block, packed as tightly as the blocks allow
+void chunkSetBlocks(Chunk *chunk, const BlockId *blocks);
+
+// Replaces every block with ones already packed the way chunks keep them,
+// indices of the fewest bits that fit the palette filled from the low bits
+// of each word up. Every index has to be within the palette
+void chunkSetPacked(Chunk *chunk, const BlockId *palette, int paletteSize,
+                    const uint64_t *words);
+
+// True when the whole chunk is the one block
+bool chunkIsUniform(const Chunk *chunk);
+
+// True when the layer of blocks on that face is known to be all opaque
+bool chunkFaceOpaque(const Chunk *chunk, BlockFace face);
+
+static inline uint8_t chunkGetLight(const Chunk *chunk, int x, int y, int z) {
+  return chunk->light != NULL ? chunk->light[CHUNK_INDEX(x, y, z)]
+                              : chunk->uniformLight;
+}
+
+void chunkSetLight(Chunk *chunk, int x, int y, int z, uint8_t light);
+
+// Gives every block the same light, which needs no memory per block
+void chunkFillLight(Chunk *chunk, uint8_t light);
+
+// Bytes of heap memory owned by the chunk
+size_t chunkMemoryUsage(const Chunk *chunk);
+
+#endif
@@ -0,0 +1,358 @@
+#include <stdlib.h>
+#include <string.h>
+#include "entity.h"
+#include "profiler.h"
+
+#define ENTITY_INDEX_MASK ((1u << ENTITY_INDEX_BITS) - 1)
+#define NO_RECORD UINT32_MAX
+
+static const float identity[16] = {1, 0, 0, 0, 0, 1, 0, 0,
+                                   0, 0, 1, 0, 0, 0, 0, 1};
+
+void initEntityStore(EntityStore *store) {
+  memset(store, 0, sizeof(*store));
+  store->freeRecord = NO_RECORD;
+  initPhysics(&store->physics);
+}
+
+static void freeArchetype(Archetype *archetype) {
+  free(archetype->ids);
+  for (int i = 0; i < 3; i++) {
+    free(archetype->position[i]);
+    free(archetype->velocity[i]);
+  }
+  free(archetype->halfWidth);
+  free(archetype->height);
+  free(archetype->stepHeight);
+  free(archetype->onGround);
+  free(archetype->transform);
+}
+
+void freeEntityStore(EntityStore *store) {
+  for (int i = 0; i < store->archetypeCount; i++) {
+    freeArchetype(&store->archetypes[i]);
+  }
+  free(store->records);
+  freePhysics(&store->physics);
+  memset(store, 0, sizeof(*store));
+}
+
+// Arrays for components the archetype doesn't have stay NULL
+static void *growArray(void *array, bool has, size_t capacity, size_t size) {
+  return has ? realloc(array, capacity * size) : NULL;
+}
+
+static void growArchetype(Archetype *archetype) {
+  size_t capacity = archetype->capacity > 0 ? archetype->capacity * 2 : 64;
+  ComponentMask mask = archetype->mask;
+  bool position = mask & COMPONENT_POSITION;
+  bool velocity = mask & COMPONENT_VELOCITY;
+  bool box = mask & COMPONENT_BOX;
+  bool transform = mask & COMPONENT_TRANSFORM;
+
+  archetype->ids = realloc(archetype->ids, capacity * sizeof(EntityId));
+  for (int i = 0; i < 3; i++) {
+    archetype->position[i] = growArray(archetype->position[i], position,
+                                       capacity, sizeof(float));
+    archetype->velocity[i] = growArray(archetype->velocity[i], velocity,
+                                       capacity, sizeof(float));
+  }
+  archetype->halfWidth =
+      growArray(archetype->halfWidth, box, capacity, sizeof(float));
+  archetype->height =
+      growArray(archetype->height, box, capacity, sizeof(float));
+  archetype->stepHeight =
+      growArray(archetype->stepHeight, box, capacity, sizeof(float));
+  archetype->onGround =
+      growArray(archetype->onGround, box, capacity, sizeof(bool));
+  archetype->transform = growArray(archetype->transform, transform, capacity,
+                                   sizeof(*archetype->transform));
+  archetype->capacity = capacity;
+}
+
+static int findArchetype(EntityStore *store, ComponentMask mask) {
+  for (int i = 0; i < store->archetypeCount; i++) {
+    if (store->archetypes[i].mask == mask) {
+      return i;
+    }
+  }
+  if (store->archetypeCount == MAX_ARCHETYPES) {
+    return -1;
+  }
+  Archetype *archetype = &store->archetypes[store->archetypeCount];
+  memset(archetype, 0, sizeof(*archetype));
+  archetype->mask = mask;
+  return store->archetypeCount++;
+}
+
+static uint32_t takeRecord(EntityStore *store) {
+  if (store->freeRecord != NO_RECORD) {
+    uint32_t index = store->freeRecord;
+    store->freeRecord = store->records[index].row;
+    return index;
+  }
+  if (store->recordCount > ENTITY_INDEX_MASK) {
+    return NO_RECORD;
+  }
+  if (store->recordCount == store->recordCapacity) {
+    store->recordCapacity =
+        store->recordCapacity > 0 ? store->recordCapacity * 2 : 256;
+    store->records = realloc(store->records,
+                             store->recordCapacity * sizeof(EntityRecord));
+  }
+  store->records[store->recordCount].generation = 0;
+  return (uint32_t)store->recordCount++;
+}
+
+EntityId createEntity(EntityStore *store, ComponentMask mask) {
+  int index = findArchetype(store, mask);
+  uint32_t record = index >= 0 ? takeRecord(store) : NO_RECORD;
+  if (record == NO_RECORD) {
+    return ENTITY_NONE;
+  }
+
+  Archetype *archetype = &store->archetypes[index];
+  if (archetype->count == archetype->capacity) {
+    growArchetype(archetype);
+  }
+  size_t row = archetype->count++;
+  EntityId entity = record | (uint32_t)store->records[record].generation
+                                 << ENTITY_INDEX_BITS;
+  archetype->ids[row] = entity;
+  store->records[record].archetype = (uint8_t)index;
+  store->records[record].row = (uint32_t)row;
+  store->entityCount++;
+
+  for (int i = 0; i < 3; i++) {
+    if (archetype->position[i] != NULL) {
+      archetype->position[i][row] = 0.0f;
+    }
+    if (archetype->velocity[i] != NULL) {
+      archetype->velocity[i][row] = 0.0f;
+    }
+  }
+  if (mask & COMPONENT_BOX) {
+    archetype->halfWidth[row] = 0.0f;
+    archetype->height[row] = 0.0f;
+    archetype->stepHeight[row] = 0.0f;
+    archetype->onGround[row] = false;
+  }
+  if (mask & COMPONENT_TRANSFORM) {
+    memcpy(archetype->transform[row], identity, sizeof(identity));
+  }
+  return entity;
+}
+
+bool entityAlive(const EntityStore *store, EntityId entity) {
+  uint32_t index = entity & ENTITY_INDEX_MASK;
+  if (entity == ENTITY_NONE || index >= store->recordCount) {
+    return false;
+  }
+
+  // Free records keep the free list in row
+  const EntityRecord *record = &store->records[index];
+  const Archetype *archetype = &store->archetypes[record->archetype];
+  return record->generation == entity >> ENTITY_INDEX_BITS &&
+         record->row < archetype->count &&
+         archetype->ids[record->row] == entity;
+}
+
+Archetype *entityArchetype(const EntityStore *store, EntityId entity,
+                           size_t *row) {
+  if (!entityAlive(store, entity)) {
+    return NULL;
+  }
+  const EntityRecord *record = &store->records[entity & ENTITY_INDEX_MASK];
+  *row = record->row;
+  return (Archetype *)&store->archetypes[record->archetype];
+}
+
+// Copies every component of one row over another
+static void moveRow(Archetype *archetype, size_t to, size_t from) {
+  archetype->ids[to] = archetype->ids[from];
+  for (int i = 0; i < 3; i++) {
+    if (archetype->position[i] != NULL) {
+      archetype->position[i][to] = archetype->position[i][from];
+    }
+    if (archetype->velocity[i] != NULL) {
+      archetype->velocity[i][to] = archetype->velocity[i][from];
+    }
+  }
+  if (archetype->mask & COMPONENT_BOX) {
+    archetype->halfWidth[to] = archetype->halfWidth[from];
+    archetype->height[to] = archetype->height[from];
+    archetype->stepHeight[to] = archetype->stepHeight[from];
+    archetype->onGround[to] = archetype->onGround[from];
+  }
+  if (archetype->mask & COMPONENT_TRANSFORM) {
+    memcpy(archetype->transform[to], archetype->transform[from],
+           sizeof(archetype->transform[to]));
+  }
+}
+
+void destroyEntity(EntityStore *store, EntityId entity) {
+  size_t row;
+  Archetype *archetype = entityArchetype(store, entity, &row);
+  if (archetype == NULL) {
+    return;
+  }
+
+  size_t last = --archetype->count;
+  if (row != last) {
+    moveRow(archetype, row, last);
+    store->records[archetype->ids[row] & ENTITY_INDEX_MASK].row =
+        (uint32_t)row;
+  }
+
+  uint32_t index = entity & ENTITY_INDEX_MASK;
+  store->records[index].generation++;
+  store->records[index].row = store->freeRecord;
+  store->freeRecord = index;
+  store->entityCount--;
+}
+
+void entitySetPosition(EntityStore *store, EntityId entity,
+                       const float position[3]) {
+  size_t row;
+  Archetype *archetype = entityArchetype(store, entity, &row);
+  if (archetype != NULL && archetype->position[0] != NULL) {
+    for (int i = 0; i < 3; i++) {
+      archetype->position[i][row] = position[i];
+    }
+  }
+}
+
+void entitySetVelocity(EntityStore *store, EntityId entity,
+                       const float velocity[3]) {
+  size_t row;
+  Archetype *archetype = entityArchetype(store, entity, &row);
+  if (archetype != NULL && archetype->velocity[0] != NULL) {
+    for (int i = 0; i < 3; i++) {
+      archetype->velocity[i][row] = velocity[i];
+    }
+  }
+}
+
+void entitySetBox(EntityStore *store, EntityId entity, float halfWidth,
+                  float height, float stepHeight) {
+  size_t row;
+  Archetype *archetype = entityArchetype(store, entity, &row);
+  if (archetype != NULL && (archetype->mask & COMPONENT_BOX)) {
+    archetype->halfWidth[row] = halfWidth;
+    archetype->height[row] = height;
+    archetype->stepHeight[row] = stepHeight;
+  }
+}
+
+void entitySetScale(EntityStore *store, EntityId entity, float scale) {
+  size_t row;
+  Archetype *archetype = entityArchetype(store, entity, &row);
+  if (archetype != NULL && (archetype->mask & COMPONENT_TRANSFORM) &&
+      !(archetype->mask & COMPONENT_BOX)) {
+    archetype->transform[row][0] = scale;
+    archetype->transform[row][5] = scale;
+    archetype->transform[row][10] = scale;
+  }
+}
+
+static bool hasAll(const Archetype *archetype, ComponentMask mask) {
+  return (archetype->mask & mask) == mask;
+}
+
+// The loops below are written over restrict pointers with nothing but
+// arithmetic in them, so compilers turn them into vector code
+
+void moveSystem(EntityStore *store, float seconds) {
+  double start = profileBegin();
+  for (int a = 0; a < store->archetypeCount; a++) {
+    Archetype *archetype = &store->archetypes[a];
+    if (!hasAll(archetype, COMPONENT_POSITION | COMPONENT_VELOCITY) ||
+        (archetype->mask & COMPONENT_BOX)) {
+      continue;
+    }
+
+    size_t count = archetype->count;
+    float *restrict fall = archetype->velocity[1];
+    for (size_t i = 0; i < count; i++) {
+      float velocity = fall[i] - PHYSICS_GRAVITY * seconds;
+      fall[i] = velocity < -PHYSICS_TERMINAL_VELOCITY
+                    ? -PHYSICS_TERMINAL_VELOCITY
+                    : velocity;
+    }
+    for (int axis = 0; axis < 3; axis++) {
+      float *restrict position = archetype->position[axis];
+      const float *restrict velocity = archetype->velocity[axis];
+      for (size_t i = 0; i < count; i++) {
+        position[i] += velocity[i] * seconds;
+      }
+    }
+  }
+  profileEnd("move system", start);
+}
+
+void physicsSystem(EntityStore *store, const World *world, float seconds) {
+  double start = profileBegin();
+  PhysicsStats stats = {0, 0, 0};
+  ComponentMask needs =
+      COMPONENT_POSITION | COMPONENT_VELOCITY | COMPONENT_BOX;
+  for (int a = 0; a < store->archetypeCount; a++) {
+    Archetype *archetype = &store->archetypes[a];
+    if (!hasAll(archetype, needs) || archetype->count == 0) {
+      continue;
+    }
+
+    BodyArrays bodies = {
+        {archetype->position[0], archetype->position[1],
+         archetype->position[2]},
+        {archetype->velocity[0], archetype->velocity[1],
+         archetype->velocity[2]},
+        archetype->halfWidth,
+        archetype->height,
+        archetype->stepHeight,
+        archetype->onGround,
+        archetype->count,
+    };
+    physicsStep(&store->physics, world, &bodies, seconds);
+    stats.pairsTested += store->physics.stats.pairsTested;
+    stats.contacts += store->physics.stats.contacts;
+    stats.blocksTested += store->physics.stats.blocksTested;
+  }
+  store->physics.stats = stats;
+  profileEnd("physics system", start);
+}
+
+void transformSystem(EntityStore *store) {
+  double start = profileBegin();
+  for (int a = 0; a < store->archetypeCount; a++) {
+    Archetype *archetype = &store->archetypes[a];
+    if (!hasAll(archetype, COMPONENT_POSITION | COMPONENT_TRANSFORM)) {
+      continue;
+    }
+
+    // Only the scale and translation change, the rest stays as created
+    size_t count = archetype->count;
+    const float *restrict x = archetype->position[0];
+    const float *restrict y = archetype->position[1];
+    const float *restrict z = archetype->position[2];
+    float (*restrict transform)[16] = archetype->transform;
+    if (archetype->mask & COMPONENT_BOX) {
+      const float *restrict halfWidth = archetype->halfWidth;
+      const float *restrict height = archetype->height;
+      for (size_t i = 0; i < count; i++) {
+        transform[i][0] = halfWidth[i] * 2.0f;
+        transform[i][5] = height[i];
+        transform[i][10] = halfWidth[i] * 2.0f;
+        transform[i][12] = x[i];
+        transform[i][13] = y[i];
+        transform[i][14] = z[i];
+      }
+    } else {
+      for (size_t i = 0; i < count; i++) {
+        transform[i][12] = x[i];
+        transform[i][13] = y[i];
+        transform[i][14] = z[i];
+      }
+    }
+  }
+  profileEnd("transform system", start);
+}
@@ -0,0 +1,103 @@
+#ifndef ENTITY_H
+#define ENTITY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "physics.h"
+#include "world.h"
+
+// What an entity is made of. Entities with the same components share an
+// archetype
+typedef enum Component {
+  COMPONENT_POSITION = 1 << 0,
+  COMPONENT_VELOCITY = 1 << 1,
+  COMPONENT_BOX = 1 << 2,       // Collides with blocks and other boxes
+  COMPONENT_TRANSFORM = 1 << 3, // Drawn, through a model matrix
+} Component;
+
+typedef uint32_t ComponentMask;
+
+// Index into the store's records in the low 24 bits and the record's
+// generation in the high 8, so ids of destroyed entities go stale
+typedef uint32_t EntityId;
+
+#define ENTITY_NONE UINT32_MAX
+#define ENTITY_INDEX_BITS 24
+
+#define MAX_ARCHETYPES 16
+
+// Every entity with one set of components, one array per field, so systems
+// run straight down contiguous arrays. Rows line up across the arrays, and
+// arrays for components the archetype doesn't have are NULL
+typedef struct Archetype {
+  ComponentMask mask;
+  size_t count, capacity;
+  EntityId *ids;
+
+  float *position[3]; // Middle of the bottom face for boxes
+  float *velocity[3];
+  float *halfWidth, *height, *stepHeight;
+  bool *onGround;
+  // Column major 4x4 matrices, ready to upload for instanced drawing
+  float (*transform)[16];
+} Archetype;
+
+typedef struct EntityRecord {
+  uint8_t generation;
+  uint8_t archetype;
+  uint32_t row; // Unused records chain free ones together through this
+} EntityRecord;
+
+typedef struct EntityStore {
+  Archetype archetypes[MAX_ARCHETYPES];
+  int archetypeCount;
+
+  EntityRecord *records;
+  size_t recordCount, recordCapacity;
+  uint32_t freeRecord; // Head of the free list, UINT32_MAX when empty
+  size_t entityCount;
+
+  Physics physics;
+} EntityStore;
+
+void initEntityStore(EntityStore *store);
+
+void freeEntityStore(EntityStore *store);
+
+// Every component starts zeroed, and transforms as the identity. Returns
+// ENTITY_NONE when there is no room for another archetype or entity
+EntityId createEntity(EntityStore *store, ComponentMask mask);
+
+// Moves the last entity of its archetype into its row
+void destroyEntity(EntityStore *store, EntityId entity);
+
+bool entityAlive(const EntityStore *store, EntityId entity);
+
+// Where the entity's components are. NULL for stale ids
+Archetype *entityArchetype(const EntityStore *store, EntityId entity,
+                           size_t *row);
+
+// Setters for single entities. Components the entity doesn't have are left
+// alone
+void entitySetPosition(EntityStore *store, EntityId entity,
+                       const float position[3]);
+void entitySetVelocity(EntityStore *store, EntityId entity,
+                       const float velocity[3]);
+void entitySetBox(EntityStore *store, EntityId entity, float halfWidth,
+                  float height, float stepHeight);
+// Boxes are drawn at their own size, so this only does anything without one
+void entitySetScale(EntityStore *store, EntityId entity, float scale);
+
+// Entities moving without a box fall through everything, like particles
+void moveSystem(EntityStore *store, float seconds);
+
+// Entities with a box are stepped through the world by physicsStep, each
+// archetype on its own. The world mustn't change until it returns
+void physicsSystem(EntityStore *store, const World *world, float seconds);
+
+// Writes every transform from the position, scaled to the box if there is
+// one
+void transformSystem(EntityStore *store);
+
+#endif
@@ -0,0 +1,133 @@
+#include <math.h>
+#include <stdlib.h>
+#include "frustum.h"
+
+// Boxes are tested in blocks this big so the per plane loops vectorize
+#define CULL_BLOCK 64
+
+void extractFrustum(const float *m, Frustum *frustum) {
+  // Gribb & Hartmann: each plane is the last row plus or minus another row
+  for (int i = 0; i < 3; i++) {
+    for (int sign = 0; sign < 2; sign++) {
+      float *plane = frustum->planes[i * 2 + sign];
+      float s = sign == 0 ? 1.0f : -1.0f;
+      for (int c = 0; c < 4; c++) {
+        plane[c] = m[c * 4 + 3] + s * m[c * 4 + i];
+      }
+
+      float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] +
+                           plane[2] * plane[2]);
+      for (int c = 0; c < 4; c++) {
+        plane[c] /= length;
+      }
+    }
+  }
+}
+
+void initChunkBounds(ChunkBounds *bounds) {
+  bounds->minX = bounds->minY = bounds->minZ = NULL;
+  bounds->maxX = bounds->maxY = bounds->maxZ = NULL;
+  bounds->count = 0;
+  bounds->capacity = 0;
+}
+
+void freeChunkBounds(ChunkBounds *bounds) {
+  free(bounds->minX);
+  free(bounds->minY);
+  free(bounds->minZ);
+  free(bounds->maxX);
+  free(bounds->maxY);
+  free(bounds->maxZ);
+  initChunkBounds(bounds);
+}
+
+size_t addChunkBounds(ChunkBounds *bounds, const float min[3],
+                      const float max[3]) {
+  if (bounds->count == bounds->capacity) {
+    size_t oldCapacity = bounds->capacity;
+    bounds->capacity = oldCapacity ? oldCapacity * 2 : CULL_BLOCK * 4;
+
+    size_t size = bounds->capacity * sizeof(float);
+    float **arrays[6] = {&bounds->minX, &bounds->minY, &bounds->minZ,
+                         &bounds->maxX, &bounds->maxY, &bounds->maxZ};
+    for (int a = 0; a < 6; a++) {
+      *arrays[a] = realloc(*arrays[a], size);
+
+      // Unused slots are NaN, which is never inside a plane, so culling can
+      // always test whole blocks
+      for (size_t i = oldCapacity; i < bounds->capacity; i++) {
+        (*arrays[a])[i] = NAN;
+      }
+    }
+  }
+
+  size_t i = bounds->count++;
+  bounds->minX[i] = min[0];
+  bounds->minY[i] = min[1];
+  bounds->minZ[i] = min[2];
+  bounds->maxX[i] = max[0];
+  bounds->maxY[i] = max[1];
+  bounds->maxZ[i] = max[2];
+  return i;
+}
+
+void removeChunkBounds(ChunkBounds *bounds, size_t index) {
+  size_t last = --bounds->count;
+  float *arrays[6] = {bounds->minX, bounds->minY, bounds->minZ,
+                      bounds->maxX, bounds->maxY, bounds->maxZ};
+  for (int a = 0; a < 6; a++) {
+    arrays[a][index] = arrays[a][last];
+    arrays[a][last] = NAN;
+  }
+}
+
+size_t cullChunkBounds(const Frustum *frustum, const ChunkBounds *bounds,
+                       uint32_t *visible, CullStats *stats) {
+  // Only the box corner furthest along each plane's normal needs testing,
+  // and which one that is only depends on the plane, so pick its arrays
+  // once instead of per box
+  const float *cornerX[6], *cornerY[6], *cornerZ[6];
+  for (int p = 0; p < 6; p++) {
+    const float *plane = frustum->planes[p];
+    cornerX[p] = plane[0] >= 0.0f ? bounds->maxX : bounds->minX;
+    cornerY[p] = plane[1] >= 0.0f ? bounds->maxY : bounds->minY;
+    cornerZ[p] = plane[2] >= 0.0f ? bounds->maxZ : bounds->minZ;
+  }
+
+  size_t visibleCount = 0;
+  int32_t inside[CULL_BLOCK];
+
+  for (size_t start = 0; start < bounds->count; start += CULL_BLOCK) {
+    size_t n = bounds->count - start;
+    n = n < CULL_BLOCK ? n : CULL_BLOCK;
+
+    for (size_t i = 0; i < CULL_BLOCK; i++) {
+      inside[i] = 1;
+    }
+
+    for (int p = 0; p < 6; p++) {
+      const float a = frustum->planes[p][0], b = frustum->planes[p][1];
+      const float c = frustum->planes[p][2], d = frustum->planes[p][3];
+      const float *x = cornerX[p] + start;
+      const float *y = cornerY[p] + start;
+      const float *z = cornerZ[p] + start;
+
+      for (size_t i = 0; i < CULL_BLOCK; i++) {
+        inside[i] &= a * x[i] + b * y[i] + c * z[i] + d >= 0.0f;
+      }
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      visible[visibleCount] = (uint32_t)(start + i);
+      visibleCount += inside[i];
+    }
+  }
+
+  if (stats != NULL) {
+    stats->tested = bounds->count;
+    stats->visible = visibleCount;
+    stats->culled = bounds->count - visibleCount;
+  }
+
+  return visibleCount;
+}
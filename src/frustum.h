@@ -0,0 +1,46 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Planes as (a, b, c, d) with a point inside when ax + by + cz + d >= 0
+typedef struct Frustum {
+  float planes[6][4];
+} Frustum;
+
+// Axis aligned boxes stored as separate arrays per component, so culling
+// works through them several boxes at a time
+typedef struct ChunkBounds {
+  float *minX, *minY, *minZ;
+  float *maxX, *maxY, *maxZ;
+  size_t count, capacity;
+} ChunkBounds;
+
+typedef struct CullStats {
+  size_t tested;
+  size_t visible;
+  size_t culled;
+} CullStats;
+
+// Planes of a column major view projection matrix, e.g. projection[0]
+// after glm_mat4_mul(projection, view, projection)
+void extractFrustum(const float *viewProjection, Frustum *frustum);
+
+void initChunkBounds(ChunkBounds *bounds);
+
+void freeChunkBounds(ChunkBounds *bounds);
+
+// Returns the index of the new box
+size_t addChunkBounds(ChunkBounds *bounds, const float min[3],
+                      const float max[3]);
+
+// Moves the last box into index, like removing from any dense array
+void removeChunkBounds(ChunkBounds *bounds, size_t index);
+
+// Writes the indices of the boxes at least partly inside the frustum to
+// visible, which must have room for bounds->count entries
+size_t cullChunkBounds(const Frustum *frustum, const ChunkBounds *bounds,
+                       uint32_t *visible, CullStats *stats);
+
+#endif
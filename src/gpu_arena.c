@@ -0,0 +1,281 @@
+#include <stdlib.h>
+#include <string.h>
+#include <glad/glad.h>
+#include "gpu_arena.h"
+#include "profiler.h"
+
+#define ALIGN_UP(size)                                                         \
+  (((size) + GPU_ARENA_ALIGNMENT - 1) & ~(size_t)(GPU_ARENA_ALIGNMENT - 1))
+
+void initGpuArena(GpuArena *arena, size_t bufferSize) {
+  memset(arena, 0, sizeof(*arena));
+  arena->bufferSize = bufferSize & ~(size_t)(GPU_ARENA_ALIGNMENT - 1);
+}
+
+void freeGpuArena(GpuArena *arena) {
+  for (int i = 0; i < arena->bufferCount; i++) {
+    glDeleteBuffers(1, &arena->buffers[i].buffer);
+    free(arena->buffers[i].freeRanges);
+  }
+  free(arena->allocations);
+  free(arena->freeHandles);
+  memset(arena, 0, sizeof(*arena));
+}
+
+static void insertFreeRange(GpuArenaBuffer *buffer, size_t index,
+                            GpuRange range) {
+  if (buffer->freeCount == buffer->freeCapacity) {
+    buffer->freeCapacity = buffer->freeCapacity ? buffer->freeCapacity * 2 : 64;
+    buffer->freeRanges =
+        realloc(buffer->freeRanges, buffer->freeCapacity * sizeof(GpuRange));
+  }
+
+  memmove(&buffer->freeRanges[index + 1], &buffer->freeRanges[index],
+          (buffer->freeCount - index) * sizeof(GpuRange));
+  buffer->freeRanges[index] = range;
+  buffer->freeCount++;
+}
+
+static void removeFreeRange(GpuArenaBuffer *buffer, size_t index) {
+  buffer->freeCount--;
+  memmove(&buffer->freeRanges[index], &buffer->freeRanges[index + 1],
+          (buffer->freeCount - index) * sizeof(GpuRange));
+}
+
+// Gives a range back to the free list, merging it with its neighbours
+static void releaseRange(GpuArenaBuffer *buffer, uint32_t offset,
+                         uint32_t size) {
+  // First free range after this one
+  size_t low = 0, high = buffer->freeCount;
+  while (low < high) {
+    size_t middle = (low + high) / 2;
+    if (buffer->freeRanges[middle].offset < offset) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  GpuRange *before = low > 0 ? &buffer->freeRanges[low - 1] : NULL;
+  GpuRange *after = low < buffer->freeCount ? &buffer->freeRanges[low] : NULL;
+  bool joinBefore = before != NULL && before->offset + before->size == offset;
+  bool joinAfter = after != NULL && offset + size == after->offset;
+
+  if (joinBefore && joinAfter) {
+    before->size += size + after->size;
+    removeFreeRange(buffer, low);
+  } else if (joinBefore) {
+    before->size += size;
+  } else if (joinAfter) {
+    after->offset = offset;
+    after->size += size;
+  } else {
+    insertFreeRange(buffer, low, (GpuRange){offset, size});
+  }
+
+  buffer->used -= size;
+}
+
+static bool createArenaBuffer(GpuArena *arena) {
+  if (arena->bufferCount == GPU_ARENA_MAX_BUFFERS) {
+    return false;
+  }
+
+  GpuArenaBuffer *buffer = &arena->buffers[arena->bufferCount++];
+  memset(buffer, 0, sizeof(*buffer));
+
+  glGenBuffers(1, &buffer->buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, buffer->buffer);
+  glBufferData(GL_COPY_WRITE_BUFFER, arena->bufferSize, NULL, GL_STATIC_DRAW);
+
+  insertFreeRange(buffer, 0, (GpuRange){0, (uint32_t)arena->bufferSize});
+  return true;
+}
+
+static GpuHandle newHandle(GpuArena *arena) {
+  if (arena->freeHandleCount > 0) {
+    return arena->freeHandles[--arena->freeHandleCount];
+  }
+
+  if (arena->allocationCount == arena->allocationCapacity) {
+    arena->allocationCapacity =
+        arena->allocationCapacity ? arena->allocationCapacity * 2 : 256;
+    arena->allocations = realloc(
+        arena->allocations, arena->allocationCapacity * sizeof(GpuAllocation));
+    arena->freeHandles = realloc(arena->freeHandles,
+                                 arena->allocationCapacity * sizeof(GpuHandle));
+  }
+
+  return (GpuHandle)arena->allocationCount++;
+}
+
+GpuHandle gpuArenaAlloc(GpuArena *arena, size_t size) {
+  size = ALIGN_UP(size > 0 ? size : 1);
+  if (size > arena->bufferSize) {
+    return GPU_HANDLE_NONE;
+  }
+
+  // Best fit over every buffer keeps the large ranges around for large
+  // meshes, and a new buffer is only made once nothing fits
+  int bestBuffer = -1;
+  size_t bestRange = 0;
+  for (;;) {
+    for (int b = 0; b < arena->bufferCount; b++) {
+      const GpuArenaBuffer *buffer = &arena->buffers[b];
+      for (size_t r = 0; r < buffer->freeCount; r++) {
+        uint32_t rangeSize = buffer->freeRanges[r].size;
+        if (rangeSize >= size &&
+            (bestBuffer < 0 ||
+             rangeSize <
+                 arena->buffers[bestBuffer].freeRanges[bestRange].size)) {
+          bestBuffer = b;
+          bestRange = r;
+        }
+      }
+    }
+
+    if (bestBuffer >= 0 || !createArenaBuffer(arena)) {
+      break;
+    }
+  }
+
+  if (bestBuffer < 0) {
+    return GPU_HANDLE_NONE;
+  }
+
+  GpuArenaBuffer *buffer = &arena->buffers[bestBuffer];
+  GpuRange *range = &buffer->freeRanges[bestRange];
+  uint32_t offset = range->offset;
+  if (range->size == size) {
+    removeFreeRange(buffer, bestRange);
+  } else {
+    range->offset += (uint32_t)size;
+    range->size -= (uint32_t)size;
+  }
+  buffer->used += size;
+  arena->used += size;
+  if (arena->used > arena->peakUsed) {
+    arena->peakUsed = arena->used;
+  }
+
+  GpuHandle handle = newHandle(arena);
+  GpuAllocation *allocation = &arena->allocations[handle];
+  allocation->buffer = (uint32_t)bestBuffer;
+  allocation->offset = offset;
+  allocation->size = (uint32_t)size;
+  allocation->live = true;
+  return handle;
+}
+
+void gpuArenaFree(GpuArena *arena, GpuHandle handle) {
+  GpuAllocation *allocation = &arena->allocations[handle];
+  releaseRange(&arena->buffers[allocation->buffer], allocation->offset,
+               allocation->size);
+  arena->used -= allocation->size;
+  allocation->live = false;
+  arena->freeHandles[arena->freeHandleCount++] = handle;
+}
+
+void gpuArenaUpload(GpuArena *arena, GpuHandle handle, size_t offset,
+                    size_t size, const void *data) {
+  const GpuAllocation *allocation = &arena->allocations[handle];
+
+  // The copy targets leave the vertex array and element bindings alone
+  glBindBuffer(GL_COPY_WRITE_BUFFER,
+               arena->buffers[allocation->buffer].buffer);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, allocation->offset + offset, size,
+                  data);
+  profileCount(COUNTER_UPLOAD_BYTES, size);
+}
+
+static const GpuArena *sortArena;
+
+static int compareOffsets(const void *a, const void *b) {
+  uint32_t offsetA = sortArena->allocations[*(const GpuHandle *)a].offset;
+  uint32_t offsetB = sortArena->allocations[*(const GpuHandle *)b].offset;
+  return (offsetA > offsetB) - (offsetA < offsetB);
+}
+
+bool gpuArenaCompact(GpuArena *arena) {
+  GpuHandle *handles = malloc(arena->allocationCount * sizeof(GpuHandle));
+  bool moved = false;
+
+  for (int b = 0; b < arena->bufferCount; b++) {
+    GpuArenaBuffer *buffer = &arena->buffers[b];
+
+    // Already packed when the only free space is at the end
+    if (buffer->freeCount == 0 ||
+        (buffer->freeCount == 1 &&
+         buffer->freeRanges[0].offset == buffer->used)) {
+      continue;
+    }
+
+    size_t handleCount = 0;
+    for (size_t i = 0; i < arena->allocationCount; i++) {
+      const GpuAllocation *allocation = &arena->allocations[i];
+      if (allocation->live && allocation->buffer == (uint32_t)b) {
+        handles[handleCount++] = (GpuHandle)i;
+      }
+    }
+    sortArena = arena;
+    qsort(handles, handleCount, sizeof(GpuHandle), compareOffsets);
+
+    // Copies within one buffer must not overlap, so pack into a new one
+    unsigned int packed;
+    glGenBuffers(1, &packed);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, packed);
+    glBufferData(GL_COPY_WRITE_BUFFER, arena->bufferSize, NULL,
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer->buffer);
+
+    uint32_t offset = 0;
+    for (size_t i = 0; i < handleCount; i++) {
+      GpuAllocation *allocation = &arena->allocations[handles[i]];
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                          allocation->offset, offset, allocation->size);
+      allocation->offset = offset;
+      offset += allocation->size;
+    }
+
+    glDeleteBuffers(1, &buffer->buffer);
+    buffer->buffer = packed;
+    buffer->freeCount = 0;
+    if (offset < arena->bufferSize) {
+      insertFreeRange(
+          buffer, 0,
+          (GpuRange){offset, (uint32_t)(arena->bufferSize - offset)});
+    }
+    moved = true;
+  }
+
+  free(handles);
+  if (moved) {
+    arena->compactions++;
+  }
+  return moved;
+}
+
+void gpuArenaStats(const GpuArena *arena, GpuArenaStats *stats) {
+  memset(stats, 0, sizeof(*stats));
+  stats->bufferCount = (size_t)arena->bufferCount;
+  stats->capacity = arena->bufferSize * (size_t)arena->bufferCount;
+  stats->allocations = arena->allocationCount - arena->freeHandleCount;
+  stats->compactions = arena->compactions;
+  stats->peakUsed = arena->peakUsed;
+
+  for (int b = 0; b < arena->bufferCount; b++) {
+    const GpuArenaBuffer *buffer = &arena->buffers[b];
+    stats->used += buffer->used;
+    stats->freeRanges += buffer->freeCount;
+    for (size_t r = 0; r < buffer->freeCount; r++) {
+      if (buffer->freeRanges[r].size > stats->largestFree) {
+        stats->largestFree = buffer->freeRanges[r].size;
+      }
+    }
+  }
+
+  size_t freeBytes = stats->capacity - stats->used;
+  stats->fragmentation =
+      freeBytes > 0 ? 1.0f - (float)stats->largestFree / (float)freeBytes
+                    : 0.0f;
+}
@@ -0,0 +1,91 @@
+#ifndef GPU_ARENA_H
+#define GPU_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define GPU_ARENA_MAX_BUFFERS 8
+
+// Every allocation starts on a multiple of this many bytes
+#define GPU_ARENA_ALIGNMENT 16
+
+// Allocations are referred to by handle, since compaction moves them
+typedef uint32_t GpuHandle;
+#define GPU_HANDLE_NONE UINT32_MAX
+
+typedef struct GpuRange {
+  uint32_t offset, size;
+} GpuRange;
+
+typedef struct GpuArenaBuffer {
+  unsigned int buffer;
+  // Sorted by offset, and never touching each other
+  GpuRange *freeRanges;
+  size_t freeCount, freeCapacity;
+  size_t used;
+} GpuArenaBuffer;
+
+typedef struct GpuAllocation {
+  uint32_t buffer; // Index into GpuArena.buffers
+  uint32_t offset;
+  uint32_t size;
+  bool live;
+} GpuAllocation;
+
+typedef struct GpuArenaStats {
+  size_t bufferCount;
+  size_t capacity; // Bytes across every buffer
+  size_t used;
+  size_t peakUsed;
+  size_t largestFree;
+  size_t freeRanges;
+  size_t allocations;
+  size_t compactions;
+  // 0 when all free space is one block, approaching 1 as it gets split up
+  float fragmentation;
+} GpuArenaStats;
+
+// A few large GL buffers handed out in pieces from a free list, so meshes
+// can come and go without creating and deleting buffers in the driver
+typedef struct GpuArena {
+  size_t bufferSize;
+  GpuArenaBuffer buffers[GPU_ARENA_MAX_BUFFERS];
+  int bufferCount;
+
+  GpuAllocation *allocations;
+  size_t allocationCount, allocationCapacity;
+  GpuHandle *freeHandles;
+  size_t freeHandleCount;
+
+  size_t used, peakUsed;
+  size_t compactions;
+} GpuArena;
+
+// Buffers of bufferSize bytes are created as they are needed
+void initGpuArena(GpuArena *arena, size_t bufferSize);
+
+void freeGpuArena(GpuArena *arena);
+
+// Returns GPU_HANDLE_NONE when no buffer has room left
+GpuHandle gpuArenaAlloc(GpuArena *arena, size_t size);
+
+void gpuArenaFree(GpuArena *arena, GpuHandle handle);
+
+static inline const GpuAllocation *gpuArenaGet(const GpuArena *arena,
+                                               GpuHandle handle) {
+  return &arena->allocations[handle];
+}
+
+// Writes into an allocation, offset is relative to its start
+void gpuArenaUpload(GpuArena *arena, GpuHandle handle, size_t offset,
+                    size_t size, const void *data);
+
+// Slides every allocation to the start of its buffer. Compacted buffers are
+// replaced, so anything bound to the old names has to be bound again.
+// Returns true if anything moved
+bool gpuArenaCompact(GpuArena *arena);
+
+void gpuArenaStats(const GpuArena *arena, GpuArenaStats *stats);
+
+#endif
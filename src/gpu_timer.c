@@ -0,0 +1,74 @@
+#include <string.h>
+#include <glad/glad.h>
+#include "gpu_timer.h"
+#include "timer.h"
+
+void initGpuTimers(GpuTimers *timers) {
+  memset(timers, 0, sizeof(*timers));
+  glGenQueries(GPU_TIMER_FRAMES * GPU_TIMER_PASSES, timers->queries[0]);
+  timers->track = profileTrack("GPU");
+  timers->frameStart[0] = timerNow();
+}
+
+void freeGpuTimers(GpuTimers *timers) {
+  glDeleteQueries(GPU_TIMER_FRAMES * GPU_TIMER_PASSES, timers->queries[0]);
+}
+
+void gpuTimersFrame(GpuTimers *timers) {
+  if (timers->inPass) {
+    gpuTimerEnd(timers);
+  }
+
+  timers->frame = (timers->frame + 1) % GPU_TIMER_FRAMES;
+  int frame = timers->frame;
+
+  // The GPU has no shared clock with the CPU here, so the passes are laid
+  // out back to back from when their frame started on the CPU
+  double start = timers->frameStart[frame];
+  double total = 0.0;
+  for (int i = 0; i < timers->passCount[frame]; i++) {
+    unsigned int query = timers->queries[frame][i];
+
+    // Still not done after several frames means the GPU is far behind,
+    // drop the result rather than wait for it
+    GLint available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      continue;
+    }
+
+    GLuint64 elapsed;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+    double duration = (double)elapsed * 1e-9;
+    profileTrackZone(timers->track, timers->names[frame][i], start + total,
+                     duration);
+    total += duration;
+  }
+
+  if (timers->passCount[frame] > 0) {
+    timers->lastFrameTime = total;
+  }
+  timers->passCount[frame] = 0;
+  timers->frameStart[frame] = timerNow();
+}
+
+void gpuTimerBegin(GpuTimers *timers, const char *name) {
+  int frame = timers->frame;
+  if (timers->inPass || timers->passCount[frame] == GPU_TIMER_PASSES) {
+    return;
+  }
+
+  int pass = timers->passCount[frame]++;
+  timers->names[frame][pass] = name;
+  glBeginQuery(GL_TIME_ELAPSED, timers->queries[frame][pass]);
+  timers->inPass = true;
+}
+
+void gpuTimerEnd(GpuTimers *timers) {
+  if (!timers->inPass) {
+    return;
+  }
+
+  glEndQuery(GL_TIME_ELAPSED);
+  timers->inPass = false;
+}
@@ -0,0 +1,39 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <stdbool.h>
+#include "profiler.h"
+
+// Frames of queries in flight, results are read this many frames late so
+// reading them never stalls
+#define GPU_TIMER_FRAMES 4
+#define GPU_TIMER_PASSES 8
+
+// GL_TIME_ELAPSED queries around each render pass, recorded to a "GPU"
+// track in the profiler. Passes can't nest
+typedef struct GpuTimers {
+  unsigned int queries[GPU_TIMER_FRAMES][GPU_TIMER_PASSES];
+  const char *names[GPU_TIMER_FRAMES][GPU_TIMER_PASSES];
+  int passCount[GPU_TIMER_FRAMES];
+  double frameStart[GPU_TIMER_FRAMES];
+  int frame;
+  bool inPass;
+
+  // Total of the last frame read back, in seconds
+  double lastFrameTime;
+
+  ProfileTrack *track;
+} GpuTimers;
+
+void initGpuTimers(GpuTimers *timers);
+
+void freeGpuTimers(GpuTimers *timers);
+
+// Reads back the oldest frame's results and starts a new frame
+void gpuTimersFrame(GpuTimers *timers);
+
+void gpuTimerBegin(GpuTimers *timers, const char *name);
+
+void gpuTimerEnd(GpuTimers *timers);
+
+#endif
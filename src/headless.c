@@ -0,0 +1,250 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glad/glad.h>
+#include "headless.h"
+#include "profiler.h"
+#include "scene.h"
+#include "timer.h"
+
+#define DEFAULT_FRAMES 600
+#define DEFAULT_OUTPUT "headless.json"
+#define DEFAULT_WIDTH 1280
+#define DEFAULT_HEIGHT 720
+
+static int intArg(int argc, char **argv, int index, int fallback) {
+  return argc > index ? atoi(argv[index]) : fallback;
+}
+
+#ifdef HAVE_EGL
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+static EGLDisplay openDisplay(void) {
+  // Surfaceless needs no GPU or display server, Mesa's llvmpipe does the
+  // rendering when there is no GPU either
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+          "eglGetPlatformDisplayEXT");
+  if (getPlatformDisplay != NULL) {
+    EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                            EGL_DEFAULT_DISPLAY, NULL);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+      return display;
+    }
+  }
+
+  EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+    return display;
+  }
+  return EGL_NO_DISPLAY;
+}
+
+bool initHeadless(Headless *headless, int width, int height) {
+  memset(headless, 0, sizeof(*headless));
+  headless->display = openDisplay();
+  if (headless->display == EGL_NO_DISPLAY) {
+    printf("Failed to open an EGL display\n");
+    return false;
+  }
+
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    printf("EGL has no desktop OpenGL\n");
+    return false;
+  }
+
+  // Without a surface type the default asks for window support
+  const EGLint configAttribs[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                                  EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                  EGL_NONE};
+  EGLConfig config;
+  EGLint configCount = 0;
+  if (!eglChooseConfig(headless->display, configAttribs, &config, 1,
+                       &configCount) ||
+      configCount == 0) {
+    printf("Failed to choose an EGL config\n");
+    return false;
+  }
+
+  // Same versions as the window tries
+  const int versions[][2] = {{4, 3}, {3, 3}};
+  headless->context = EGL_NO_CONTEXT;
+  for (int i = 0; i < 2 && headless->context == EGL_NO_CONTEXT; i++) {
+    const EGLint contextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                     versions[i][0],
+                                     EGL_CONTEXT_MINOR_VERSION,
+                                     versions[i][1],
+                                     EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                     EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                     EGL_NONE};
+    headless->context = eglCreateContext(headless->display, config,
+                                         EGL_NO_CONTEXT, contextAttribs);
+  }
+  if (headless->context == EGL_NO_CONTEXT) {
+    printf("Failed to create an OpenGL context\n");
+    return false;
+  }
+
+  if (!eglMakeCurrent(headless->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                      headless->context)) {
+    printf("Failed to make the context current without a surface\n");
+    return false;
+  }
+
+  if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+    printf("Failed to initialize GLAD\n");
+    return false;
+  }
+
+  // With no surface everything is drawn into this instead
+  glGenFramebuffers(1, &headless->framebuffer);
+  glGenRenderbuffers(1, &headless->colorBuffer);
+  glGenRenderbuffers(1, &headless->depthBuffer);
+
+  glBindRenderbuffer(GL_RENDERBUFFER, headless->colorBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, headless->depthBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, headless->framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, headless->colorBuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, headless->depthBuffer);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    printf("Offscreen framebuffer is incomplete\n");
+    return false;
+  }
+
+  return true;
+}
+
+void freeHeadless(Headless *headless) {
+  if (headless->framebuffer != 0) {
+    glDeleteFramebuffers(1, &headless->framebuffer);
+    glDeleteRenderbuffers(1, &headless->colorBuffer);
+    glDeleteRenderbuffers(1, &headless->depthBuffer);
+  }
+
+  if (headless->display != EGL_NO_DISPLAY) {
+    eglMakeCurrent(headless->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   EGL_NO_CONTEXT);
+    if (headless->context != EGL_NO_CONTEXT) {
+      eglDestroyContext(headless->display, headless->context);
+    }
+    eglTerminate(headless->display);
+  }
+}
+
+#else
+
+bool initHeadless(Headless *headless, int width, int height) {
+  memset(headless, 0, sizeof(*headless));
+  printf("Headless mode needs EGL, which this build was made without\n");
+  return false;
+}
+
+void freeHeadless(Headless *headless) {}
+
+#endif
+
+static bool writeResults(const char *path, int width, int height,
+                         double loadTime, const double *frameTimes,
+                         int frames) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    printf("Failed to open %s\n", path);
+    return false;
+  }
+
+  double total = 0.0, min = frameTimes[0], max = frameTimes[0];
+  for (int i = 0; i < frames; i++) {
+    total += frameTimes[i];
+    min = frameTimes[i] < min ? frameTimes[i] : min;
+    max = frameTimes[i] > max ? frameTimes[i] : max;
+  }
+
+  fprintf(file, "{\n");
+  fprintf(file, "  \"renderer\": \"%s\",\n",
+          (const char *)glGetString(GL_RENDERER));
+  fprintf(file, "  \"width\": %d,\n  \"height\": %d,\n", width, height);
+  fprintf(file, "  \"load_ms\": %.3f,\n", loadTime * 1000.0);
+  fprintf(file, "  \"frames\": %d,\n", frames);
+  fprintf(file, "  \"frame_ms_min\": %.3f,\n", min * 1000.0);
+  fprintf(file, "  \"frame_ms_mean\": %.3f,\n", total / frames * 1000.0);
+  fprintf(file, "  \"frame_ms_max\": %.3f,\n", max * 1000.0);
+  fprintf(file, "  \"frame_ms\": [");
+  for (int i = 0; i < frames; i++) {
+    fprintf(file, "%s%.3f", i > 0 ? ", " : "", frameTimes[i] * 1000.0);
+  }
+  fprintf(file, "]\n}\n");
+
+  printf("%d frames at %dx%d on %s\n", frames, width, height,
+         (const char *)glGetString(GL_RENDERER));
+  printf("Load %.1f ms, frame min %.3f ms, mean %.3f ms, max %.3f ms\n",
+         loadTime * 1000.0, min * 1000.0, total / frames * 1000.0,
+         max * 1000.0);
+  return fclose(file) == 0;
+}
+
+int runHeadless(int argc, char **argv) {
+  int frames = intArg(argc, argv, 0, DEFAULT_FRAMES);
+  const char *output = argc > 1 ? argv[1] : DEFAULT_OUTPUT;
+  int width = intArg(argc, argv, 2, DEFAULT_WIDTH);
+  int height = intArg(argc, argv, 3, DEFAULT_HEIGHT);
+  if (frames <= 0 || width <= 0 || height <= 0) {
+    printf("Usage: --headless [frames] [output file] [width] [height]\n");
+    return 1;
+  }
+
+  Headless headless;
+  if (!initHeadless(&headless, width, height)) {
+    freeHeadless(&headless);
+    return 1;
+  }
+
+  profileThreadName("main");
+  // Everything is in view distance from anywhere on the orbit, so the same
+  // world is drawn every run
+  SceneConfig config = {WORLD_SEED, 2 * WORLD_SIZE, WORLD_SIZE, WORLD_HEIGHT,
+                        NULL};
+  Scene *scene = createScene(&config, width, height);
+
+  // Time every frame with the whole world loaded, not the streaming in
+  float eye[3], target[3];
+  orbitCamera(scene, 0.0, eye, target);
+  double loadStart = timerNow();
+  while (!sceneLoaded(scene)) {
+    sceneUpdate(scene, eye, target);
+  }
+  glFinish();
+  double loadTime = timerNow() - loadStart;
+
+  double *frameTimes = malloc((size_t)frames * sizeof(double));
+  for (int i = 0; i < frames; i++) {
+    double start = timerNow();
+
+    orbitCamera(scene, i * HEADLESS_FRAME_STEP, eye, target);
+    sceneUpdate(scene, eye, target);
+    sceneRender(scene, eye, target);
+
+    // Without a swap nothing else waits for the GPU to finish the frame
+    glFinish();
+    frameTimes[i] = timerNow() - start;
+
+    gpuTimersFrame(&scene->gpuTimers);
+    profileFrame();
+  }
+
+  bool ok =
+      writeResults(output, width, height, loadTime, frameTimes, frames);
+
+  free(frameTimes);
+  destroyScene(scene);
+  freeHeadless(&headless);
+  profileShutdown();
+  return ok ? 0 : 1;
+}
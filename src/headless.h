@@ -0,0 +1,32 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <stdbool.h>
+
+// Camera time advances by this much every frame however long it takes, so
+// every run sees the same frames
+#define HEADLESS_FRAME_STEP (1.0 / 60.0)
+
+// An OpenGL context with no window, drawing into an offscreen framebuffer.
+// The EGL display and context are kept as void * so this header doesn't
+// need EGL
+typedef struct Headless {
+  void *display;
+  void *context;
+  unsigned int framebuffer;
+  unsigned int colorBuffer, depthBuffer;
+} Headless;
+
+// Makes a width x height context current and loads GL. Fails without EGL
+bool initHeadless(Headless *headless, int width, int height);
+
+// Also cleans up after a failed initHeadless
+void freeHeadless(Headless *headless);
+
+// Renders a fixed number of frames along the orbit camera into an offscreen
+// framebuffer through EGL, so it runs without a display. Arguments are
+// [frames] [output file] [width] [height], the timings are written to the
+// output file as JSON
+int runHeadless(int argc, char **argv);
+
+#endif
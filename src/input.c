@@ -0,0 +1,30 @@
+#include <string.h>
+#include "input.h"
+#include "timer.h"
+
+void initInputQueue(InputQueue *queue) { memset(queue, 0, sizeof(*queue)); }
+
+bool inputPush(InputQueue *queue, InputEvent event) {
+  size_t tail = queue->tail;
+  size_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+  if (tail - head == INPUT_QUEUE_SIZE) {
+    queue->dropped++;
+    return false;
+  }
+
+  event.time = timerNow();
+  queue->events[tail % INPUT_QUEUE_SIZE] = event;
+  __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool inputPop(InputQueue *queue, InputEvent *event) {
+  size_t head = queue->head;
+  if (head == __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+
+  *event = queue->events[head % INPUT_QUEUE_SIZE];
+  __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
@@ -0,0 +1,58 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Events that don't fit are dropped. Every tick reads all of them, so this
+// only fills up if the simulation stops
+#define INPUT_QUEUE_SIZE 1024
+
+// What keys do in the game, so nothing past the window knows about key codes
+typedef enum InputAction {
+  ACTION_FORWARD = 0,
+  ACTION_BACK,
+  ACTION_LEFT,
+  ACTION_RIGHT,
+  ACTION_UP,
+  ACTION_DOWN,
+  ACTION_TOGGLE_FLY,
+  ACTION_SPAWN, // Drops a burst of entities where the camera looks
+  ACTION_COUNT
+} InputAction;
+
+typedef enum InputEventType {
+  INPUT_PRESS,
+  INPUT_RELEASE,
+  INPUT_LOOK, // The mouse moved by dx, dy pixels
+} InputEventType;
+
+typedef struct InputEvent {
+  InputEventType type;
+  InputAction action;
+  float dx, dy;
+  double time; // timerNow seconds when it happened
+} InputEvent;
+
+// Lock-free ring of events from one producer, the window's callbacks, to
+// one consumer, the simulation tick. Neither side ever waits
+typedef struct InputQueue {
+  InputEvent events[INPUT_QUEUE_SIZE];
+  char padding0[64];
+  size_t head; // Next event to read, only the consumer moves it
+  char padding1[64];
+  size_t tail; // Next free slot, only the producer moves it
+  char padding2[64];
+  size_t dropped;
+} InputQueue;
+
+void initInputQueue(InputQueue *queue);
+
+// Stamps the event with the time now. Returns false and drops it if the
+// queue is full
+bool inputPush(InputQueue *queue, InputEvent event);
+
+// Returns false if the queue is empty
+bool inputPop(InputQueue *queue, InputEvent *event);
+
+#endif
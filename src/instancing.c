@@ -0,0 +1,154 @@
+#include <stdint.h>
+#include <string.h>
+#include <glad/glad.h>
+#include "instancing.h"
+#include "profiler.h"
+#include "shader.h"
+#include "timer.h"
+
+// Vertex attribute locations, see entity.vs. The model matrix takes one
+// location per column
+#define ATTRIB_POSITION 0
+#define ATTRIB_NORMAL 1
+#define ATTRIB_MODEL 2
+
+#define CUBE_VERTICES 24
+#define CUBE_INDICES 36
+
+// Four corners per face so each face has its own normal. x and z go from
+// -0.5 to 0.5 and y from 0 to 1, matching the boxes of bodies
+static void buildCube(float vertices[CUBE_VERTICES][6],
+                      uint16_t indices[CUBE_INDICES]) {
+  for (int face = 0; face < 6; face++) {
+    int axis = face / 2, u = (axis + 1) % 3, v = (axis + 2) % 3;
+    bool positive = face % 2 == 0;
+
+    for (int corner = 0; corner < 4; corner++) {
+      float *vertex = vertices[face * 4 + corner];
+      vertex[axis] = positive ? 1.0f : 0.0f;
+      vertex[u] = corner == 1 || corner == 2 ? 1.0f : 0.0f;
+      vertex[v] = corner >= 2 ? 1.0f : 0.0f;
+      vertex[0] -= 0.5f;
+      vertex[2] -= 0.5f;
+
+      vertex[3] = vertex[4] = vertex[5] = 0.0f;
+      vertex[3 + axis] = positive ? 1.0f : -1.0f;
+    }
+
+    const int quad[6] = {0, 1, 2, 0, 2, 3};
+    for (int i = 0; i < 6; i++) {
+      indices[face * 6 + i] = (uint16_t)(face * 4 + quad[i]);
+    }
+  }
+}
+
+void initInstanceRenderer(InstanceRenderer *renderer) {
+  memset(renderer, 0, sizeof(*renderer));
+  renderer->instanced = true;
+
+  char *vertexShaderSource = getShaderContent("./assets/shaders/entity.vs");
+  char *fragmentShaderSource = getShaderContent("./assets/shaders/entity.fs");
+  renderer->shaderProgram =
+      createProgram(createShader(vertexShaderSource, GL_VERTEX_SHADER),
+                    createShader(fragmentShaderSource, GL_FRAGMENT_SHADER));
+  renderer->viewProjectionLoc =
+      glGetUniformLocation(renderer->shaderProgram, "viewProjection");
+  renderer->colorLoc = glGetUniformLocation(renderer->shaderProgram, "color");
+
+  float vertices[CUBE_VERTICES][6];
+  uint16_t indices[CUBE_INDICES];
+  buildCube(vertices, indices);
+
+  glGenVertexArrays(1, &renderer->VAO);
+  glGenBuffers(1, &renderer->meshBuffer);
+  glGenBuffers(1, &renderer->indexBuffer);
+  glGenBuffers(1, &renderer->instanceBuffer);
+  glBindVertexArray(renderer->VAO);
+
+  glBindBuffer(GL_ARRAY_BUFFER, renderer->meshBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+  glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE,
+                        6 * sizeof(float), (void *)0);
+  glEnableVertexAttribArray(ATTRIB_POSITION);
+  glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE,
+                        6 * sizeof(float), (void *)(3 * sizeof(float)));
+  glEnableVertexAttribArray(ATTRIB_NORMAL);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, renderer->indexBuffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
+               GL_STATIC_DRAW);
+
+  // A column of the model matrix per location, moving on once per instance
+  glBindBuffer(GL_ARRAY_BUFFER, renderer->instanceBuffer);
+  for (int column = 0; column < 4; column++) {
+    glVertexAttribPointer(ATTRIB_MODEL + column, 4, GL_FLOAT, GL_FALSE,
+                          16 * sizeof(float),
+                          (void *)(column * 4 * sizeof(float)));
+    glVertexAttribDivisor(ATTRIB_MODEL + column, 1);
+  }
+  glBindVertexArray(0);
+}
+
+void freeInstanceRenderer(InstanceRenderer *renderer) {
+  glDeleteVertexArrays(1, &renderer->VAO);
+  glDeleteBuffers(1, &renderer->meshBuffer);
+  glDeleteBuffers(1, &renderer->indexBuffer);
+  glDeleteBuffers(1, &renderer->instanceBuffer);
+  glDeleteProgram(renderer->shaderProgram);
+}
+
+void instanceRendererFrame(InstanceRenderer *renderer) {
+  memset(&renderer->stats, 0, sizeof(renderer->stats));
+}
+
+void instanceRendererDraw(InstanceRenderer *renderer,
+                          const float *viewProjection,
+                          const float (*transforms)[16], size_t count,
+                          const float color[3]) {
+  if (count == 0) {
+    return;
+  }
+
+  double start = profileBegin();
+  glUseProgram(renderer->shaderProgram);
+  glUniformMatrix4fv(renderer->viewProjectionLoc, 1, GL_FALSE,
+                     viewProjection);
+  glUniform3fv(renderer->colorLoc, 1, color);
+  glBindVertexArray(renderer->VAO);
+
+  size_t drawCalls;
+  if (renderer->instanced) {
+    // Orphan last frame's matrices rather than wait for the GPU to finish
+    // with them
+    glBindBuffer(GL_ARRAY_BUFFER, renderer->instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(transforms[0]), transforms,
+                 GL_STREAM_DRAW);
+    for (int column = 0; column < 4; column++) {
+      glEnableVertexAttribArray(ATTRIB_MODEL + column);
+    }
+    glDrawElementsInstanced(GL_TRIANGLES, CUBE_INDICES, GL_UNSIGNED_SHORT,
+                            (void *)0, (GLsizei)count);
+    drawCalls = 1;
+  } else {
+    // With the arrays off, the model matrix is whatever was set last
+    for (int column = 0; column < 4; column++) {
+      glDisableVertexAttribArray(ATTRIB_MODEL + column);
+    }
+    for (size_t i = 0; i < count; i++) {
+      for (int column = 0; column < 4; column++) {
+        glVertexAttrib4fv(ATTRIB_MODEL + column, &transforms[i][column * 4]);
+      }
+      glDrawElements(GL_TRIANGLES, CUBE_INDICES, GL_UNSIGNED_SHORT,
+                     (void *)0);
+    }
+    drawCalls = count;
+  }
+  glBindVertexArray(0);
+
+  renderer->stats.drawCalls += drawCalls;
+  renderer->stats.instances += count;
+  renderer->stats.submitSeconds += timerNow() - start;
+  profileCount(COUNTER_DRAW_CALLS, drawCalls);
+  profileCount(COUNTER_TRIANGLES, count * CUBE_INDICES / 3);
+  profileEnd("draw instances", start);
+}
@@ -0,0 +1,41 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct InstanceStats {
+  size_t drawCalls;
+  size_t instances;
+  double submitSeconds; // CPU time spent issuing the draws
+} InstanceStats;
+
+// Draws many copies of a unit cube standing on the origin, each through its
+// own column major model matrix. Matrices are streamed into a buffer that
+// is orphaned every draw, and every copy goes out in one
+// glDrawElementsInstanced. Needs a current GL context
+typedef struct InstanceRenderer {
+  unsigned int VAO;
+  unsigned int meshBuffer, indexBuffer, instanceBuffer;
+  unsigned int shaderProgram;
+  int viewProjectionLoc, colorLoc;
+
+  // Cleared to draw one glDrawElements per copy instead, to compare against
+  bool instanced;
+
+  InstanceStats stats; // Since instanceRendererFrame
+} InstanceRenderer;
+
+void initInstanceRenderer(InstanceRenderer *renderer);
+
+void freeInstanceRenderer(InstanceRenderer *renderer);
+
+// Starts the stats over
+void instanceRendererFrame(InstanceRenderer *renderer);
+
+void instanceRendererDraw(InstanceRenderer *renderer,
+                          const float *viewProjection,
+                          const float (*transforms)[16], size_t count,
+                          const float color[3]);
+
+#endif
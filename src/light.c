@@ -0,0 +1,473 @@
+#include <stdlib.h>
+#include <string.h>
+#include "light.h"
+#include "profiler.h"
+
+// Where each kind of light sits in a block's light byte
+#define SKY_SHIFT 4
+#define BLOCK_SHIFT 0
+
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+// Set in Chunk.lightChanged along with a bit per BlockFace border touched
+#define CHANGED_BIT 0x40
+
+// Direction of each BlockFace
+static const int faceOffsets[FACE_COUNT][3] = {
+    {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+
+static void queuePush(LightQueue *queue, Chunk *chunk, int x, int y, int z,
+                      int level) {
+  if (queue->end == queue->capacity) {
+    size_t count = queue->end - queue->start;
+    if (queue->start > queue->capacity / 2) {
+      memmove(queue->nodes, &queue->nodes[queue->start],
+              count * sizeof(LightNode));
+    } else {
+      queue->capacity = queue->capacity ? queue->capacity * 2 : 4096;
+      queue->nodes =
+          realloc(queue->nodes, queue->capacity * sizeof(LightNode));
+      memmove(queue->nodes, &queue->nodes[queue->start],
+              count * sizeof(LightNode));
+    }
+    queue->start = 0;
+    queue->end = count;
+  }
+
+  LightNode *node = &queue->nodes[queue->end++];
+  node->chunk = chunk;
+  node->x = (uint8_t)x;
+  node->y = (uint8_t)y;
+  node->z = (uint8_t)z;
+  node->level = (uint8_t)level;
+}
+
+static bool queuePop(LightQueue *queue, LightNode *node) {
+  if (queue->start == queue->end) {
+    queue->start = queue->end = 0;
+    return false;
+  }
+  *node = queue->nodes[queue->start++];
+  return true;
+}
+
+static int getLevel(const Chunk *chunk, int x, int y, int z, int shift) {
+  return (chunkGetLight(chunk, x, y, z) >> shift) & 15;
+}
+
+static void markChanged(LightEngine *engine, Chunk *chunk, uint8_t borders) {
+  if ((chunk->lightChanged & CHANGED_BIT) == 0) {
+    if (engine->changedCount == engine->changedCapacity) {
+      engine->changedCapacity =
+          engine->changedCapacity ? engine->changedCapacity * 2 : 64;
+      engine->changed = realloc(engine->changed,
+                                engine->changedCapacity * sizeof(Chunk *));
+    }
+    engine->changed[engine->changedCount++] = chunk;
+  }
+  chunk->lightChanged |= CHANGED_BIT | borders;
+}
+
+static void setLevel(LightEngine *engine, Chunk *chunk, int x, int y, int z,
+                     int shift, int level) {
+  uint8_t light = chunkGetLight(chunk, x, y, z);
+  light = (uint8_t)((light & ~(15 << shift)) | level << shift);
+  chunkSetLight(chunk, x, y, z, light);
+
+  uint8_t borders = 0;
+  borders |= x == CHUNK_MASK ? 1 << FACE_POS_X : (x == 0 ? 1 << FACE_NEG_X : 0);
+  borders |= y == CHUNK_MASK ? 1 << FACE_POS_Y : (y == 0 ? 1 << FACE_NEG_Y : 0);
+  borders |= z == CHUNK_MASK ? 1 << FACE_POS_Z : (z == 0 ? 1 << FACE_NEG_Z : 0);
+  markChanged(engine, chunk, borders);
+}
+
+// The block next to a node on the given face. False when it is in a chunk
+// that isn't in the world
+static bool neighbour(const World *world, const LightNode *node, int face,
+                      LightNode *out) {
+  int x = node->x + faceOffsets[face][0];
+  int y = node->y + faceOffsets[face][1];
+  int z = node->z + faceOffsets[face][2];
+
+  Chunk *chunk = node->chunk;
+  if (((x | y | z) & ~CHUNK_MASK) != 0) {
+    chunk = worldGetChunk(world, chunk->x + (x >> CHUNK_SHIFT),
+                          chunk->y + (y >> CHUNK_SHIFT),
+                          chunk->z + (z >> CHUNK_SHIFT));
+    if (chunk == NULL) {
+      return false;
+    }
+  }
+
+  out->chunk = chunk;
+  out->x = (uint8_t)(x & CHUNK_MASK);
+  out->y = (uint8_t)(y & CHUNK_MASK);
+  out->z = (uint8_t)(z & CHUNK_MASK);
+  return true;
+}
+
+// Spreads the light of everything on the add queue until nothing changes
+static void spreadLight(LightEngine *engine, int shift) {
+  LightNode node;
+  while (queuePop(&engine->add, &node)) {
+    engine->stats.visited++;
+
+    // The queued level may be out of date, what is there now spreads
+    int level = getLevel(node.chunk, node.x, node.y, node.z, shift);
+    for (int face = 0; face < FACE_COUNT; face++) {
+      bool straightDown = shift == SKY_SHIFT && face == FACE_NEG_Y &&
+                          level == LIGHT_MAX;
+      int next = straightDown ? LIGHT_MAX : level - 1;
+      LightNode to;
+      if (next <= 0 || !neighbour(engine->world, &node, face, &to)) {
+        continue;
+      }
+
+      if (getLevel(to.chunk, to.x, to.y, to.z, shift) >= next ||
+          blockIsOpaque(chunkGetBlock(to.chunk, to.x, to.y, to.z))) {
+        continue;
+      }
+      setLevel(engine, to.chunk, to.x, to.y, to.z, shift, next);
+      queuePush(&engine->add, to.chunk, to.x, to.y, to.z, next);
+    }
+  }
+}
+
+// Darkens everything lit only through the blocks on the remove queue, which
+// were already set to 0. Blocks lit some other way are queued to spread
+// their light back into the dark
+static void takeLight(LightEngine *engine, int shift) {
+  LightNode node;
+  while (queuePop(&engine->remove, &node)) {
+    engine->stats.visited++;
+
+    for (int face = 0; face < FACE_COUNT; face++) {
+      LightNode to;
+      if (!neighbour(engine->world, &node, face, &to)) {
+        continue;
+      }
+
+      int level = getLevel(to.chunk, to.x, to.y, to.z, shift);
+      if (level == 0) {
+        continue;
+      }
+
+      bool straightDown = shift == SKY_SHIFT && face == FACE_NEG_Y &&
+                          node.level == LIGHT_MAX;
+      if (level >= node.level && !straightDown) {
+        queuePush(&engine->add, to.chunk, to.x, to.y, to.z, level);
+        continue;
+      }
+
+      setLevel(engine, to.chunk, to.x, to.y, to.z, shift, 0);
+      queuePush(&engine->remove, to.chunk, to.x, to.y, to.z, level);
+
+      int emitted = shift == BLOCK_SHIFT
+                        ? blockLight(chunkGetBlock(to.chunk, to.x, to.y, to.z))
+                        : 0;
+      if (emitted > 0) {
+        setLevel(engine, to.chunk, to.x, to.y, to.z, shift, emitted);
+        queuePush(&engine->add, to.chunk, to.x, to.y, to.z, emitted);
+      }
+    }
+  }
+}
+
+// Hands every chunk that changed to the callback, along with neighbours
+// across any border that changed
+static void flushChanged(LightEngine *engine) {
+  size_t count = engine->changedCount;
+  for (size_t i = 0; i < count; i++) {
+    Chunk *chunk = engine->changed[i];
+    for (int face = 0; face < FACE_COUNT; face++) {
+      if ((chunk->lightChanged & (1 << face)) == 0) {
+        continue;
+      }
+
+      const int *offset = faceOffsets[face];
+      Chunk *next = worldGetChunk(engine->world, chunk->x + offset[0],
+                                  chunk->y + offset[1], chunk->z + offset[2]);
+      if (next != NULL) {
+        markChanged(engine, next, 0);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < engine->changedCount; i++) {
+    Chunk *chunk = engine->changed[i];
+    chunk->lightChanged = 0;
+    if (engine->onChanged != NULL) {
+      engine->onChanged(engine->user, chunk);
+    }
+  }
+  engine->changedCount = 0;
+}
+
+static bool hasLightSource(const Chunk *chunk) {
+  if (chunk->bits == 16) {
+    return true;
+  }
+  for (int i = 0; i < chunk->paletteSize; i++) {
+    if (blockLight(chunk->palette[i]) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Whether full sky light comes down through every block of the bottom layer
+static bool skyLitBottom(const Chunk *chunk) {
+  if (chunk->light == NULL) {
+    return LIGHT_SKY(chunk->uniformLight) == LIGHT_MAX;
+  }
+  for (int z = 0; z < CHUNK_SIZE; z++) {
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+      if (LIGHT_SKY(chunk->light[CHUNK_INDEX(x, 0, z)]) != LIGHT_MAX) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Queues the layer of blocks on one side of a chunk, skipping ones too dark
+// to light anything
+static void queueBorder(LightEngine *engine, Chunk *chunk, int face,
+                        int shift) {
+  if (chunk->light == NULL && ((chunk->uniformLight >> shift) & 15) <= 1) {
+    return;
+  }
+
+  int d = face / 2, u = (d + 1) % 3, v = (d + 2) % 3;
+  int pos[3];
+  pos[d] = face % 2 == 0 ? CHUNK_MASK : 0;
+  for (pos[v] = 0; pos[v] < CHUNK_SIZE; pos[v]++) {
+    for (pos[u] = 0; pos[u] < CHUNK_SIZE; pos[u]++) {
+      int level = getLevel(chunk, pos[0], pos[1], pos[2], shift);
+      if (level > 1) {
+        queuePush(&engine->add, chunk, pos[0], pos[1], pos[2], level);
+      }
+    }
+  }
+}
+
+// Shines full sky light straight down every column it reaches the top of.
+// Then only the blocks beside a column that goes less deep, or at the edge
+// of the chunk, are queued to spread it sideways
+static void lightColumns(LightEngine *engine, Chunk *chunk, const Chunk *above,
+                         bool openSky) {
+  int lowest[CHUNK_SIZE * CHUNK_SIZE];
+  for (int z = 0; z < CHUNK_SIZE; z++) {
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+      int y = CHUNK_SIZE;
+      if (openSky ||
+          (above != NULL &&
+           LIGHT_SKY(chunkGetLight(above, x, 0, z)) == LIGHT_MAX)) {
+        while (y > 0 && !blockIsOpaque(chunkGetBlock(chunk, x, y - 1, z))) {
+          y--;
+          setLevel(engine, chunk, x, y, z, SKY_SHIFT, LIGHT_MAX);
+        }
+      }
+      lowest[x + z * CHUNK_SIZE] = y;
+    }
+  }
+
+  for (int z = 0; z < CHUNK_SIZE; z++) {
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+      int deepest = lowest[x + z * CHUNK_SIZE];
+      int shallowest = CHUNK_SIZE;
+      if (x > 0 && x < CHUNK_MASK && z > 0 && z < CHUNK_MASK) {
+        shallowest = lowest[x - 1 + z * CHUNK_SIZE];
+        shallowest = MAX(shallowest, lowest[x + 1 + z * CHUNK_SIZE]);
+        shallowest = MAX(shallowest, lowest[x + (z - 1) * CHUNK_SIZE]);
+        shallowest = MAX(shallowest, lowest[x + (z + 1) * CHUNK_SIZE]);
+      }
+
+      // The bottom of a column open to the chunk below lights that too
+      if (deepest == 0 && shallowest == 0) {
+        shallowest = 1;
+      }
+      for (int y = deepest; y < shallowest; y++) {
+        queuePush(&engine->add, chunk, x, y, z, LIGHT_MAX);
+      }
+    }
+  }
+}
+
+void initLightEngine(LightEngine *engine, World *world, int worldHeight) {
+  memset(engine, 0, sizeof(*engine));
+  engine->world = world;
+  engine->worldHeight = worldHeight;
+  engine->uniformShortcuts = true;
+}
+
+void freeLightEngine(LightEngine *engine) {
+  free(engine->add.nodes);
+  free(engine->remove.nodes);
+  free(engine->changed);
+  memset(engine, 0, sizeof(*engine));
+}
+
+void lightChunkLoaded(LightEngine *engine, Chunk *chunk) {
+  double start = profileBegin();
+  engine->stats.chunksLit++;
+
+  bool openSky = chunk->y >= engine->worldHeight - 1;
+  Chunk *above =
+      openSky ? NULL
+              : worldGetChunk(engine->world, chunk->x, chunk->y + 1, chunk->z);
+  bool skyLit = openSky || (above != NULL && skyLitBottom(above));
+  bool sources = hasLightSource(chunk);
+
+  // Air under open sky is fully lit, and solid rock with nothing glowing in
+  // it is dark. Neither needs flooding, or any memory for its light
+  bool skyOnly = engine->uniformShortcuts && chunk->occupied == 0 && skyLit;
+  if (engine->uniformShortcuts && !sources && chunk->opaque == UINT64_MAX) {
+    chunkFillLight(chunk, 0);
+    markChanged(engine, chunk, 0);
+    engine->stats.uniformChunks++;
+    flushChanged(engine);
+    profileEnd("light chunk", start);
+    return;
+  }
+
+  chunkFillLight(chunk, skyOnly ? LIGHT_PACK(LIGHT_MAX, 0) : 0);
+  markChanged(engine, chunk, 0);
+  engine->stats.uniformChunks += skyOnly;
+
+  for (int shift = SKY_SHIFT; shift >= BLOCK_SHIFT; shift -= SKY_SHIFT) {
+    if (shift == SKY_SHIFT && !skyOnly) {
+      lightColumns(engine, chunk, openSky ? NULL : above, openSky);
+    }
+
+    if (shift == BLOCK_SHIFT && sources) {
+      for (int i = 0; i < CHUNK_VOLUME; i++) {
+        int x = i & CHUNK_MASK;
+        int z = (i >> CHUNK_SHIFT) & CHUNK_MASK;
+        int y = i >> (2 * CHUNK_SHIFT);
+        int emitted = blockLight(chunkGetBlock(chunk, x, y, z));
+        if (emitted > 0) {
+          setLevel(engine, chunk, x, y, z, shift, emitted);
+          queuePush(&engine->add, chunk, x, y, z, emitted);
+        }
+      }
+    }
+
+    // Light comes in from every neighbour, and a chunk lit without
+    // flooding spreads its own light back out
+    for (int face = 0; face < FACE_COUNT; face++) {
+      Chunk *next = worldGetChunk(engine->world,
+                                  chunk->x + faceOffsets[face][0],
+                                  chunk->y + faceOffsets[face][1],
+                                  chunk->z + faceOffsets[face][2]);
+      if (next == NULL) {
+        continue;
+      }
+      queueBorder(engine, next, face ^ 1, shift);
+      // The chunk above is already as bright, that's where the light came from
+      if (skyOnly && shift == SKY_SHIFT && face != FACE_POS_Y) {
+        queueBorder(engine, chunk, face, shift);
+      }
+    }
+
+    spreadLight(engine, shift);
+  }
+
+  flushChanged(engine);
+  profileEnd("light chunk", start);
+}
+
+BlockId lightReplaceBlock(LightEngine *engine, int x, int y, int z,
+                          BlockId block) {
+  Chunk *chunk = worldGetChunk(engine->world, WORLD_TO_CHUNK(x),
+                               WORLD_TO_CHUNK(y), WORLD_TO_CHUNK(z));
+  if (chunk == NULL) {
+    worldSetBlock(engine->world, x, y, z, block);
+    return block;
+  }
+
+  int lx = WORLD_TO_LOCAL(x), ly = WORLD_TO_LOCAL(y), lz = WORLD_TO_LOCAL(z);
+  BlockId previous = chunkGetBlock(chunk, lx, ly, lz);
+  if (previous != block) {
+    chunkSetBlock(chunk, lx, ly, lz, block);
+  }
+  return previous;
+}
+
+void lightRelightBlock(LightEngine *engine, int x, int y, int z,
+                       BlockId previous) {
+  Chunk *chunk = worldGetChunk(engine->world, WORLD_TO_CHUNK(x),
+                               WORLD_TO_CHUNK(y), WORLD_TO_CHUNK(z));
+  if (chunk == NULL) {
+    return;
+  }
+
+  int lx = WORLD_TO_LOCAL(x), ly = WORLD_TO_LOCAL(y), lz = WORLD_TO_LOCAL(z);
+  BlockId block = chunkGetBlock(chunk, lx, ly, lz);
+  if (previous == block) {
+    return;
+  }
+
+  double start = profileBegin();
+  engine->stats.updates++;
+
+  LightNode here = {chunk, (uint8_t)lx, (uint8_t)ly, (uint8_t)lz, 0};
+  bool openSky =
+      chunk->y >= engine->worldHeight - 1 && ly == CHUNK_MASK;
+
+  for (int shift = SKY_SHIFT; shift >= BLOCK_SHIFT; shift -= SKY_SHIFT) {
+    // Whatever light the block had came from it or through it, so it all
+    // goes before anything else spreads back in
+    int level = getLevel(chunk, lx, ly, lz, shift);
+    bool wasSource = shift == BLOCK_SHIFT && blockLight(previous) > 0;
+    if (level > 0 && (blockIsOpaque(block) || wasSource)) {
+      setLevel(engine, chunk, lx, ly, lz, shift, 0);
+      queuePush(&engine->remove, chunk, lx, ly, lz, level);
+      takeLight(engine, shift);
+    }
+
+    int emitted = shift == BLOCK_SHIFT ? blockLight(block) : 0;
+    if (emitted > getLevel(chunk, lx, ly, lz, shift)) {
+      setLevel(engine, chunk, lx, ly, lz, shift, emitted);
+      queuePush(&engine->add, chunk, lx, ly, lz, emitted);
+    }
+
+    if (!blockIsOpaque(block)) {
+      for (int face = 0; face < FACE_COUNT; face++) {
+        LightNode from;
+        if (neighbour(engine->world, &here, face, &from)) {
+          int fromLevel = getLevel(from.chunk, from.x, from.y, from.z, shift);
+          if (fromLevel > 1) {
+            queuePush(&engine->add, from.chunk, from.x, from.y, from.z,
+                      fromLevel);
+          }
+        }
+      }
+
+      if (shift == SKY_SHIFT && openSky) {
+        setLevel(engine, chunk, lx, ly, lz, shift, LIGHT_MAX);
+        queuePush(&engine->add, chunk, lx, ly, lz, LIGHT_MAX);
+      }
+    }
+
+    spreadLight(engine, shift);
+  }
+
+  flushChanged(engine);
+  profileEnd("light update", start);
+}
+
+void lightSetBlock(LightEngine *engine, int x, int y, int z, BlockId block) {
+  lightRelightBlock(engine, x, y, z,
+                    lightReplaceBlock(engine, x, y, z, block));
+}
+
+uint8_t lightGet(const World *world, int x, int y, int z) {
+  Chunk *chunk = worldGetChunk(world, WORLD_TO_CHUNK(x), WORLD_TO_CHUNK(y),
+                               WORLD_TO_CHUNK(z));
+  if (chunk == NULL) {
+    return LIGHT_PACK(LIGHT_MAX, 0);
+  }
+  return chunkGetLight(chunk, WORLD_TO_LOCAL(x), WORLD_TO_LOCAL(y),
+                       WORLD_TO_LOCAL(z));
+}
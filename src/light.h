@@ -0,0 +1,87 @@
+#ifndef LIGHT_H
+#define LIGHT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "chunk.h"
+#include "world.h"
+
+// Light levels go from 0 to 15 and drop by one for every block they spread.
+// Sky light at full strength is the exception, it shines straight down
+// through any number of transparent blocks
+#define LIGHT_MAX 15
+
+// Blocks keep both kinds of light in one byte
+#define LIGHT_SKY(light) ((light) >> 4)
+#define LIGHT_BLOCK(light) ((light) & 15)
+#define LIGHT_PACK(sky, block) ((uint8_t)((sky) << 4 | (block)))
+
+// A block waiting to spread or take back its light
+typedef struct LightNode {
+  Chunk *chunk;
+  uint8_t x, y, z; // Local coordinates
+  uint8_t level;
+} LightNode;
+
+// Grows as needed
+typedef struct LightQueue {
+  LightNode *nodes;
+  size_t start, end, capacity;
+} LightQueue;
+
+typedef struct LightStats {
+  size_t chunksLit;     // Chunks lit as they entered the world
+  size_t uniformChunks; // Of those, the ones lit without a flood fill
+  size_t updates;       // Blocks set
+  size_t visited;       // Blocks taken off either queue
+} LightStats;
+
+// Flood fills sky and block light through the world. Chunks are lit as they
+// arrive, and setting a block takes back the light it blocks or gave off
+// and spreads in whatever light reaches it, touching nothing else
+typedef struct LightEngine {
+  World *world;
+  int worldHeight; // Chunks from y = 0 up, there is open sky above the top
+
+  LightQueue add, remove;
+
+  // Chunks whose light changed in the current call
+  Chunk **changed;
+  size_t changedCount, changedCapacity;
+
+  // Called before returning for every chunk with light that changed, and
+  // for neighbours whose faces show light along the border
+  void (*onChanged)(void *user, Chunk *chunk);
+  void *user;
+
+  // Only cleared to measure what the shortcuts for uniform chunks save
+  bool uniformShortcuts;
+
+  LightStats stats;
+} LightEngine;
+
+void initLightEngine(LightEngine *engine, World *world, int worldHeight);
+
+void freeLightEngine(LightEngine *engine);
+
+// Lights a chunk that was just added to the world, taking in light from
+// its neighbours and spreading its own light out to them
+void lightChunkLoaded(LightEngine *engine, Chunk *chunk);
+
+// Sets the block and relights around it. Blocks in chunks that aren't in
+// the world are set without any lighting
+void lightSetBlock(LightEngine *engine, int x, int y, int z, BlockId block);
+
+// lightSetBlock in two steps, so the block can change under the world lock
+// and the light spread after it's let go. Replacing returns the block that
+// was there, or the new one when there is nothing to relight
+BlockId lightReplaceBlock(LightEngine *engine, int x, int y, int z,
+                          BlockId block);
+void lightRelightBlock(LightEngine *engine, int x, int y, int z,
+                       BlockId previous);
+
+// Light of a block in the world. Chunks that aren't there are open sky
+uint8_t lightGet(const World *world, int x, int y, int z);
+
+#endif
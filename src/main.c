@@ -1,246 +1,283 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
-#include <cglm/cglm.h>
-#include <cglm/types.h>
-#include <cglm/mat4.h>
-#include <cglm/affine-pre.h>
-#include <cglm/affine.h>
-#include <cglm/util.h>
-#include <cglm/cam.h>
-#include <cglm/vec3.h>
-
-#include <math.h>
-#include <stb_image.h>
-
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
-#include "shader.h"
+#include "bench.h"
+#include "headless.h"
+#include "profiler.h"
+#include "raycast.h"
+#include "scene.h"
+#include "sim.h"
+#include "timer.h"
 
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
 
+// Written when F3 is pressed
+#define TRACE_PATH "trace.json"
+
+// Directory the world is saved to
+#define SAVE_PATH "world"
+
+// Blocks further than this from the camera can't be picked
+#define REACH 64.0f
+
+// What the window's callbacks need, through its user pointer
+typedef struct App {
+  Scene *scene;
+  Simulation *sim;
+  double cursorX, cursorY;
+  bool cursorSeen; // The first cursor position has nothing to move from
+} App;
+
 // Callback to resive viewport on window resize
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
-  glViewport(0, 0, width, height);
+  App *app = glfwGetWindowUserPointer(window);
+  // Minimized windows report a size of 0
+  if (width > 0 && height > 0) {
+    sceneResize(app->scene, width, height);
+  }
 }
 
-void processInput(GLFWwindow *window) {
-  if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-    glfwSetWindowShouldClose(window, true);
-  if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
-    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-  if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+// Keys that move the camera become events for the simulation, the rest are
+// handled here
+void key_callback(GLFWwindow *window, int key, int scancode, int action,
+                  int mods) {
+  App *app = glfwGetWindowUserPointer(window);
+  if (action == GLFW_REPEAT)
+    return;
+
+  if (action == GLFW_PRESS) {
+    if (key == GLFW_KEY_ESCAPE)
+      glfwSetWindowShouldClose(window, true);
+    if (key == GLFW_KEY_1)
+      glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    if (key == GLFW_KEY_2)
+      glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    if (key == GLFW_KEY_F3)
+      profileDump(TRACE_PATH);
+  }
+
+  InputEvent event = {0};
+  event.type = action == GLFW_PRESS ? INPUT_PRESS : INPUT_RELEASE;
+  switch (key) {
+  case GLFW_KEY_W:
+    event.action = ACTION_FORWARD;
+    break;
+  case GLFW_KEY_S:
+    event.action = ACTION_BACK;
+    break;
+  case GLFW_KEY_A:
+    event.action = ACTION_LEFT;
+    break;
+  case GLFW_KEY_D:
+    event.action = ACTION_RIGHT;
+    break;
+  case GLFW_KEY_SPACE:
+    event.action = ACTION_UP;
+    break;
+  case GLFW_KEY_LEFT_SHIFT:
+    event.action = ACTION_DOWN;
+    break;
+  case GLFW_KEY_F:
+    event.action = ACTION_TOGGLE_FLY;
+    break;
+  case GLFW_KEY_G:
+    event.action = ACTION_SPAWN;
+    break;
+  default:
+    return;
+  }
+  inputPush(&app->sim->input, event);
 }
 
-int main() {
+void cursor_position_callback(GLFWwindow *window, double x, double y) {
+  App *app = glfwGetWindowUserPointer(window);
+  if (app->cursorSeen) {
+    InputEvent event = {0};
+    event.type = INPUT_LOOK;
+    event.dx = (float)(x - app->cursorX);
+    event.dy = (float)(y - app->cursorY);
+    inputPush(&app->sim->input, event);
+  }
+  app->cursorX = x;
+  app->cursorY = y;
+  app->cursorSeen = true;
+}
+
+// Left click breaks the block in the middle of the view, right click places
+// stone against the face of it that was hit
+void editBlocks(GLFWwindow *window, Scene *scene, const float eye[3],
+                const float target[3]) {
+  // Only once per press
+  static bool breakDown = false, placeDown = false;
+  bool breakButton =
+      glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+  bool placeButton =
+      glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+  bool breaking = breakButton && !breakDown;
+  bool placing = placeButton && !placeDown;
+  breakDown = breakButton;
+  placeDown = placeButton;
+  if (!breaking && !placing)
+    return;
+
+  float direction[3] = {target[0] - eye[0], target[1] - eye[1],
+                        target[2] - eye[2]};
+  RayHit hit;
+  if (!raycast(scene->world, eye, direction, REACH, &hit))
+    return;
+
+  if (breaking) {
+    sceneSetBlock(scene, hit.x, hit.y, hit.z, BLOCK_AIR);
+  } else if (hit.face != FACE_COUNT) {
+    int pos[3] = {hit.x, hit.y, hit.z};
+    pos[hit.face / 2] += hit.face % 2 == 0 ? 1 : -1;
+    sceneSetBlock(scene, pos[0], pos[1], pos[2], BLOCK_STONE);
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+    return runBenchmark(argc - 2, argv + 2);
+  }
+  if (argc > 1 && strcmp(argv[1], "--headless") == 0) {
+    return runHeadless(argc - 2, argv + 2);
+  }
+
   glfwInit();
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-  GLFWwindow *window =
-      glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Minecraft", NULL, NULL);
+  // 4.3 draws every chunk with one indirect call, 3.3 still works without it
+  GLFWwindow *window = NULL;
+  const int versions[][2] = {{4, 3}, {3, 3}};
+  for (int i = 0; i < 2 && window == NULL; i++) {
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, versions[i][0]);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, versions[i][1]);
+    window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Minecraft", NULL,
+                              NULL);
+  }
   if (window == NULL) {
     printf("Failed to create GFLW window\n");
     glfwTerminate();
     return -1;
   }
   glfwMakeContextCurrent(window);
-  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
     printf("Failed to initialize GLAD\n");
     return -1;
   }
 
-  glEnable(GL_DEPTH_TEST);
-
-  // === Init Code for an Object ===
-
-  // Shaders
-  const char *vertexShaderSource =
-      getShaderContent("./assets/shaders/vertex.vs");
-  unsigned int vertexShader =
-      createShader(vertexShaderSource, GL_VERTEX_SHADER);
-
-  const char *fragmentShaderSource =
-      getShaderContent("./assets/shaders/fragment.fs");
-  unsigned int fragmentShader =
-      createShader(fragmentShaderSource, GL_FRAGMENT_SHADER);
-
-  unsigned int shaderProgram = createProgram(vertexShader, fragmentShader);
-
-  // Cube Vertices (Horrifying)
-  float vertices[] = {
-      -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, 0.5f,  -0.5f, -0.5f, 1.0f, 0.0f,
-      0.5f,  0.5f,  -0.5f, 1.0f, 1.0f, 0.5f,  0.5f,  -0.5f, 1.0f, 1.0f,
-      -0.5f, 0.5f,  -0.5f, 0.0f, 1.0f, -0.5f, -0.5f, -0.5f, 0.0f, 0.0f,
-
-      -0.5f, -0.5f, 0.5f,  0.0f, 0.0f, 0.5f,  -0.5f, 0.5f,  1.0f, 0.0f,
-      0.5f,  0.5f,  0.5f,  1.0f, 1.0f, 0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-      -0.5f, 0.5f,  0.5f,  0.0f, 1.0f, -0.5f, -0.5f, 0.5f,  0.0f, 0.0f,
-
-      -0.5f, 0.5f,  0.5f,  1.0f, 0.0f, -0.5f, 0.5f,  -0.5f, 1.0f, 1.0f,
-      -0.5f, -0.5f, -0.5f, 0.0f, 1.0f, -0.5f, -0.5f, -0.5f, 0.0f, 1.0f,
-      -0.5f, -0.5f, 0.5f,  0.0f, 0.0f, -0.5f, 0.5f,  0.5f,  1.0f, 0.0f,
-
-      0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 0.5f,  0.5f,  -0.5f, 1.0f, 1.0f,
-      0.5f,  -0.5f, -0.5f, 0.0f, 1.0f, 0.5f,  -0.5f, -0.5f, 0.0f, 1.0f,
-      0.5f,  -0.5f, 0.5f,  0.0f, 0.0f, 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-      -0.5f, -0.5f, -0.5f, 0.0f, 1.0f, 0.5f,  -0.5f, -0.5f, 1.0f, 1.0f,
-      0.5f,  -0.5f, 0.5f,  1.0f, 0.0f, 0.5f,  -0.5f, 0.5f,  1.0f, 0.0f,
-      -0.5f, -0.5f, 0.5f,  0.0f, 0.0f, -0.5f, -0.5f, -0.5f, 0.0f, 1.0f,
-
-      -0.5f, 0.5f,  -0.5f, 0.0f, 1.0f, 0.5f,  0.5f,  -0.5f, 1.0f, 1.0f,
-      0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-      -0.5f, 0.5f,  0.5f,  0.0f, 0.0f, -0.5f, 0.5f,  -0.5f, 0.0f, 1.0f,
-  };
-
-  unsigned int VBO, VAO;
-  glGenVertexArrays(1, &VAO);
-  glGenBuffers(1, &VBO);
-
-  glBindVertexArray(VAO);
-
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
-  glEnableVertexAttribArray(0);
-
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
-                        (void *)(3 * sizeof(float)));
-  glEnableVertexAttribArray(1);
-
-  // === Textures ===
-
-  unsigned int texture1;
-
-  glGenTextures(1, &texture1);
-  glBindTexture(GL_TEXTURE_2D, texture1);
-
-  // Set the texture wrapping parameters
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-  // Set texture filtering parameters
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-  // Load image, create texture and generate mipmaps
-  int width, height, nrChannels;
-
-  stbi_set_flip_vertically_on_load(true);
-
-  unsigned char *data =
-      stbi_load("./assets/textures/grass.png", &width, &height, &nrChannels, 0);
-  if (data) {
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
-                 GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-  } else {
-    printf("Failed to load texture");
-  }
-
-  stbi_image_free(data);
-
-  // Tell each OpenGL texture sampler which texture it belongs to
-  glUseProgram(shaderProgram);
-  glUniform1i(glGetUniformLocation(shaderProgram, "grass"), 0);
-
-  // GLM
-  mat4 model;
-  glm_mat4_identity(model);
-  mat4 view;
-  glm_mat4_identity(view);
-  mat4 projection;
-  glm_mat4_identity(projection);
-
-  vec3 cameraPos;
-  glm_vec3_make((vec3){0.0f, 0.0f, 0.0f}, cameraPos);
-
-  vec3 cameraTarget;
-  glm_vec3_make((vec3){0.0f, 0.0f, 0.0f}, cameraTarget);
-
-  vec3 cameraDirection;
-  glm_vec3_sub(cameraPos, cameraTarget, cameraDirection);
-  glm_normalize(cameraDirection);
+  profileThreadName("main");
+  SceneConfig config = {WORLD_SEED, VIEW_DISTANCE, 0, WORLD_HEIGHT, SAVE_PATH};
+  Scene *scene = createScene(&config, WINDOW_WIDTH, WINDOW_HEIGHT);
 
-  vec3 up;
-  glm_vec3_make((vec3){0.0f, 1.0f, 0.0f}, up);
+  double lastTitleUpdate = 0.0;
+  double frameTime = 0.0;
 
-  vec3 cameraRight;
-  glm_cross(up, cameraDirection, cameraRight);
-  glm_normalize(cameraRight);
+  // The camera moves in fixed ticks on its own thread, however long
+  // frames take, and every frame draws wherever it is by now
+  Simulation sim;
+  startSimulation(&sim, scene);
 
-  vec3 cameraUp;
-  glm_cross(cameraDirection, cameraRight, cameraUp);
-
-  const float radius = 10.0f;
-
-  unsigned int modelLoc = glGetUniformLocation(shaderProgram, "model");
-  unsigned int viewLoc = glGetUniformLocation(shaderProgram, "view");
-  unsigned int projectionLoc =
-      glGetUniformLocation(shaderProgram, "projection");
-
-  // glm_translate(view, (vec3){0.0f, 0.0f, -3.0f});
-  glm_perspective(glm_rad(45.0f), (float)WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f,
-                  100.0f, projection);
-
-  // Projection Matrix doesn't change often
-  glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, projection[0]);
-
-  // === Camera ===
+  App app = {scene, &sim, 0.0, 0.0, false};
+  glfwSetWindowUserPointer(window, &app);
+  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+  glfwSetKeyCallback(window, key_callback);
+  glfwSetCursorPosCallback(window, cursor_position_callback);
+  glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+  // Input latency, from an event happening to the first frame showing a
+  // tick that used it being presented
+  ProfileTrack *inputTrack = profileTrack("input");
+  double lastInputTime = 0.0;
+  double latencySum = 0.0, latencyMax = 0.0;
+  int latencyCount = 0;
+  double latencyMean = 0.0, latencyShownMax = 0.0;
 
   // Main loop
   while (!glfwWindowShouldClose(window)) {
-    processInput(window);
-
-    // === Rendering === //
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    // Shader
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture1);
-
-    glUseProgram(shaderProgram);
-
-    // === Coordinates ===
-    // glm_rotate(model, glm_rad(2.5f), (vec3){0.0f, 1.0f, 0.0f});
-
-    float camX = sin(glfwGetTime()) * radius;
-    float camZ = cos(glfwGetTime()) * radius;
-
-    glm_lookat((vec3){camX, 0.0f, camZ}, (vec3){0.0f, 0.0f, 0.0f},
-               (vec3){0.0f, 1.0f, 0.0f}, view);
-
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, model[0]);
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, view[0]);
-
-    // Draw
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+    SimState state;
+    const SimSnapshot *snapshot = simRenderState(&sim, timerNow(), &state);
+    // Ticks walk the player through the world at the same time. Edits and
+    // chunks coming and going wait for a frame where a tick isn't reading it
+    editBlocks(window, scene, state.eye, state.target);
+    sceneUpdate(scene, state.eye, state.target);
+    sceneRender(scene, state.eye, state.target);
+
+    // Boxes first, then particles, each all in one draw
+    const float boxColor[3] = {0.8f, 0.45f, 0.3f};
+    const float particleColor[3] = {1.0f, 0.9f, 0.5f};
+    instanceRendererFrame(&scene->instances);
+    sceneRenderInstances(scene, state.eye, state.target,
+                         (const float(*)[16])snapshot->transforms,
+                         snapshot->boxCount, boxColor);
+    sceneRenderInstances(scene, state.eye, state.target,
+                         (const float(*)[16])snapshot->transforms +
+                             snapshot->boxCount,
+                         snapshot->transformCount - snapshot->boxCount,
+                         particleColor);
+
+    if (glfwGetTime() - lastTitleUpdate > 1.0) {
+      const RenderStats *stats = &scene->chunkRenderer.stats;
+      GpuArenaStats memory;
+      gpuArenaStats(&scene->chunkRenderer.arena, &memory);
+
+      if (latencyCount > 0) {
+        latencyMean = latencySum / latencyCount;
+        latencyShownMax = latencyMax;
+      }
+      latencySum = latencyMax = 0.0;
+      latencyCount = 0;
+
+      const InstanceStats *instances = &scene->instances.stats;
+
+      char title[384];
+      snprintf(title, sizeof(title),
+               "Minecraft - %.2f ms (GPU %.2f ms, tick %.3f ms, input %.1f/"
+               "%.1f ms), %zu/%zu chunks visible, %zu draw calls, %.1f MB "
+               "meshes (%.0f%% fragmented), %zu entities in %zu draw calls "
+               "(%.3f ms submit)",
+               frameTime * 1000.0, scene->gpuTimers.lastFrameTime * 1000.0,
+               snapshot->tickSeconds * 1000.0, latencyMean * 1000.0,
+               latencyShownMax * 1000.0,
+               stats->cull.visible, stats->cull.tested, stats->drawCalls,
+               memory.used / (1024.0 * 1024.0), memory.fragmentation * 100.0f,
+               instances->instances, instances->drawCalls,
+               instances->submitSeconds * 1000.0);
+      glfwSetWindowTitle(window, title);
+      lastTitleUpdate = glfwGetTime();
+    }
 
     // === Update === //
     glfwPollEvents();
     glfwSwapBuffers(window);
+
+    if (state.inputTime > lastInputTime) {
+      double latency = timerNow() - state.inputTime;
+      profileTrackZone(inputTrack, "input latency", state.inputTime, latency);
+      latencySum += latency;
+      latencyMax = latency > latencyMax ? latency : latencyMax;
+      latencyCount++;
+      lastInputTime = state.inputTime;
+    }
+
+    gpuTimersFrame(&scene->gpuTimers);
+    frameTime = profileFrame();
   }
 
   // Cleanup
-  glDeleteVertexArrays(1, &VAO);
-  glDeleteBuffers(1, &VBO);
-  glDeleteProgram(shaderProgram);
-
+  stopSimulation(&sim);
+  destroyScene(scene);
+  profileShutdown();
   glfwTerminate();
   return 0;
 }
@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include "chunk.h"
+#include "mesh_state.h"
+
+#define STATES_INITIAL_CAPACITY 256
+
+static size_t findSlot(const MeshStates *states, int x, int y, int z) {
+  size_t mask = states->capacity - 1;
+  size_t i = chunkHash(x, y, z) & mask;
+
+  while (states->slots[i].used) {
+    const MeshState *state = &states->slots[i];
+    if (state->x == x && state->y == y && state->z == z) {
+      break;
+    }
+    i = (i + 1) & mask;
+  }
+
+  return i;
+}
+
+static void growStates(MeshStates *states) {
+  MeshState *oldSlots = states->slots;
+  size_t oldCapacity = states->capacity;
+
+  states->capacity = oldCapacity * 2;
+  states->slots = calloc(states->capacity, sizeof(MeshState));
+
+  for (size_t i = 0; i < oldCapacity; i++) {
+    MeshState *state = &oldSlots[i];
+    if (state->used) {
+      states->slots[findSlot(states, state->x, state->y, state->z)] = *state;
+    }
+  }
+
+  free(oldSlots);
+}
+
+void initMeshStates(MeshStates *states) {
+  states->capacity = STATES_INITIAL_CAPACITY;
+  states->slots = calloc(states->capacity, sizeof(MeshState));
+  states->count = 0;
+}
+
+void freeMeshStates(MeshStates *states) {
+  free(states->slots);
+  states->slots = NULL;
+}
+
+MeshState *meshStatesGet(const MeshStates *states, int cx, int cy, int cz) {
+  MeshState *state = &states->slots[findSlot(states, cx, cy, cz)];
+  return state->used ? state : NULL;
+}
+
+MeshState *meshStatesAdd(MeshStates *states, int cx, int cy, int cz) {
+  // Keep the load factor under one half so probe sequences stay short
+  if ((states->count + 1) * 2 > states->capacity) {
+    growStates(states);
+  }
+
+  MeshState *state = &states->slots[findSlot(states, cx, cy, cz)];
+  if (!state->used) {
+    *state = (MeshState){cx, cy, cz, true, UINT32_MAX, 0, false, false};
+    states->count++;
+  }
+  return state;
+}
+
+void meshStatesRemove(MeshStates *states, int cx, int cy, int cz) {
+  size_t mask = states->capacity - 1;
+  size_t i = findSlot(states, cx, cy, cz);
+  if (!states->slots[i].used) {
+    return;
+  }
+
+  // Backward shift deletion, the same as the world's
+  size_t j = i;
+  for (;;) {
+    j = (j + 1) & mask;
+    MeshState *state = &states->slots[j];
+    if (!state->used) {
+      break;
+    }
+
+    size_t home = chunkHash(state->x, state->y, state->z) & mask;
+    if ((j > i && (home <= i || home > j)) ||
+        (j < i && (home <= i && home > j))) {
+      states->slots[i] = *state;
+      i = j;
+    }
+  }
+
+  states->slots[i].used = false;
+  states->count--;
+}
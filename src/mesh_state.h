@@ -0,0 +1,39 @@
+#ifndef MESH_STATE_H
+#define MESH_STATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// What the scene knows about drawing a chunk, kept out of the chunk itself
+typedef struct MeshState {
+  int x, y, z; // Chunk coordinates
+  bool used;
+
+  uint32_t drawId; // ChunkDrawId in the renderer, or UINT32_MAX for no mesh
+  uint32_t meshVersion; // Tag of the latest mesh job, older results are stale
+  bool meshQueued;
+  bool meshDirty; // Edited since, to be meshed again before the next frame
+} MeshState;
+
+// Open addressing hash map of MeshStates keyed on chunk coordinates. Adding
+// or removing moves entries, so pointers into it only last until then
+typedef struct MeshStates {
+  MeshState *slots;
+  size_t capacity; // Always a power of two
+  size_t count;
+} MeshStates;
+
+void initMeshStates(MeshStates *states);
+
+void freeMeshStates(MeshStates *states);
+
+// NULL if the chunk has no entry
+MeshState *meshStatesGet(const MeshStates *states, int cx, int cy, int cz);
+
+// Returns the chunk's entry, adding one with no mesh if there is none
+MeshState *meshStatesAdd(MeshStates *states, int cx, int cy, int cz);
+
+void meshStatesRemove(MeshStates *states, int cx, int cy, int cz);
+
+#endif
@@ -0,0 +1,406 @@
+#include <stdlib.h>
+#include <string.h>
+#include "light.h"
+#include "mesher.h"
+#include "profiler.h"
+#include "timer.h"
+
+void initMesh(Mesh *mesh) { memset(mesh, 0, sizeof(*mesh)); }
+
+void freeMesh(Mesh *mesh) {
+  free(mesh->vertices);
+  free(mesh->indices);
+  initMesh(mesh);
+}
+
+static void reserveQuad(Mesh *mesh) {
+  if (mesh->vertexCount + 4 > mesh->vertexCapacity) {
+    mesh->vertexCapacity =
+        mesh->vertexCapacity ? mesh->vertexCapacity * 2 : 1024;
+    mesh->vertices = realloc(mesh->vertices,
+                             mesh->vertexCapacity * sizeof(*mesh->vertices));
+  }
+
+  if (mesh->indexCount + 6 > mesh->indexCapacity) {
+    mesh->indexCapacity = mesh->indexCapacity ? mesh->indexCapacity * 2 : 1536;
+    mesh->indices =
+        realloc(mesh->indices, mesh->indexCapacity * sizeof(*mesh->indices));
+  }
+}
+
+// Faces are keyed on their tile + 1, then the ambient occlusion of each
+// corner and the light in front of the face, so only faces that look the
+// same all over merge
+#define KEY_TILE_MASK 0xffffu
+#define KEY_AO_SHIFT 16
+#define KEY_LIGHT_SHIFT 24
+
+// Every corner unoccluded
+#define AO_NONE 0xffu
+
+// Emits a w by h quad on the face of the blocks in the given slice along
+// axis d. The quad spans the two other axes, starting at (u0, v0)
+static void emitQuad(Mesh *mesh, int d, bool positive, int slice, int u0,
+                     int v0, int w, int h, uint32_t key) {
+  int u = (d + 1) % 3, v = (d + 2) % 3;
+
+  reserveQuad(mesh);
+  uint32_t first = (uint32_t)mesh->vertexCount;
+
+  VertexFields fields;
+  fields.normal = d * 2 + (positive ? 0 : 1);
+  fields.tile = (int)(key & KEY_TILE_MASK) - 1;
+  fields.skyLight = LIGHT_SKY(key >> KEY_LIGHT_SHIFT);
+  fields.blockLight = LIGHT_BLOCK(key >> KEY_LIGHT_SHIFT);
+
+  for (int i = 0; i < 4; i++) {
+    int corner[3];
+    corner[d] = slice + (positive ? 1 : 0);
+    corner[u] = u0 + (i == 1 || i == 2 ? w : 0);
+    corner[v] = v0 + (i >= 2 ? h : 0);
+
+    fields.x = corner[0];
+    fields.y = corner[1];
+    fields.z = corner[2];
+    fields.ao = (int)(key >> (KEY_AO_SHIFT + i * 2)) & 3;
+    mesh->vertices[mesh->vertexCount++] = packVertex(&fields);
+  }
+
+  // Corners go counter clockwise around +d, so flip them for -d faces. The
+  // quad is split along the diagonal with the lighter corners, otherwise
+  // occlusion in one corner bleeds along the diagonal into the opposite one
+  static const uint32_t front[2][6] = {{0, 1, 2, 2, 3, 0},
+                                       {1, 2, 3, 3, 0, 1}};
+  static const uint32_t back[2][6] = {{0, 3, 2, 2, 1, 0},
+                                      {1, 0, 3, 3, 2, 1}};
+  unsigned ao = key >> KEY_AO_SHIFT;
+  bool flip = (ao & 3) + (ao >> 4 & 3) < (ao >> 2 & 3) + (ao >> 6 & 3);
+  const uint32_t *order = positive ? front[flip] : back[flip];
+
+  for (int i = 0; i < 6; i++) {
+    mesh->indices[mesh->indexCount++] = first + order[i];
+  }
+}
+
+// Distance between neighbouring blocks of the input along x, y and z
+static const int inputStride[3] = {1, MESH_INPUT_SIZE * MESH_INPUT_SIZE,
+                                   MESH_INPUT_SIZE};
+
+// Two bits per corner of a face, in the order emitQuad goes around them,
+// from 0 for the darkest to 3 for no occlusion. Each corner is darkened by
+// the two blocks beside it and the one diagonal to it, all in the layer in
+// front of the face
+static unsigned faceOcclusion(const MeshInput *input, int front, int d) {
+  int su = inputStride[(d + 1) % 3], sv = inputStride[(d + 2) % 3];
+  const BlockId *blocks = input->blocks;
+
+  // The 8 blocks around the one in front, counter clockwise from -u -v
+  bool ring[8] = {blockIsOpaque(blocks[front - su - sv]),
+                  blockIsOpaque(blocks[front - sv]),
+                  blockIsOpaque(blocks[front + su - sv]),
+                  blockIsOpaque(blocks[front + su]),
+                  blockIsOpaque(blocks[front + su + sv]),
+                  blockIsOpaque(blocks[front + sv]),
+                  blockIsOpaque(blocks[front - su + sv]),
+                  blockIsOpaque(blocks[front - su])};
+
+  unsigned ao = 0;
+  for (int i = 0; i < 4; i++) {
+    int side1 = ring[(i * 2 + 7) & 7], corner = ring[i * 2];
+    int side2 = ring[i * 2 + 1];
+    int level = side1 && side2 ? 0 : 3 - (side1 + side2 + corner);
+    ao |= (unsigned)level << (i * 2);
+  }
+  return ao;
+}
+
+// Key of the face of the block at index pointing along d, or 0 if there is
+// no visible face
+static uint32_t faceKey(const MeshInput *input, int index, int d,
+                        bool positive, bool cull) {
+  BlockId block = input->blocks[index];
+  if (block == BLOCK_AIR) {
+    return 0;
+  }
+
+  int front = index + (positive ? inputStride[d] : -inputStride[d]);
+  if (cull && blockIsOpaque(input->blocks[front])) {
+    return 0;
+  }
+
+  uint32_t tile = blockTile(block, (BlockFace)(d * 2 + (positive ? 0 : 1)));
+  unsigned ao = input->ambientOcclusion ? faceOcclusion(input, front, d)
+                                        : AO_NONE;
+  return (tile + 1u) | ao << KEY_AO_SHIFT |
+         (uint32_t)input->light[front] << KEY_LIGHT_SHIFT;
+}
+
+static void meshSimple(const MeshInput *input, bool cull, Mesh *mesh) {
+  int pos[3];
+  for (pos[1] = 0; pos[1] < CHUNK_SIZE; pos[1]++) {
+    for (pos[2] = 0; pos[2] < CHUNK_SIZE; pos[2]++) {
+      for (pos[0] = 0; pos[0] < CHUNK_SIZE; pos[0]++) {
+        int index = MESH_INPUT_INDEX(pos[0], pos[1], pos[2]);
+        for (int face = 0; face < FACE_COUNT; face++) {
+          int d = face / 2;
+          bool positive = face % 2 == 0;
+          uint32_t key = faceKey(input, index, d, positive, cull);
+          if (key != 0) {
+            int u = (d + 1) % 3, v = (d + 2) % 3;
+            emitQuad(mesh, d, positive, pos[d], pos[u], pos[v], 1, 1, key);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Distance between neighbouring cells along x, y and z
+static const int cellStride[3] = {1, CHUNK_CELLS * CHUNK_CELLS, CHUNK_CELLS};
+
+// Cells in the given layer along axis d
+static uint64_t cellLayer(int d, int layer) {
+  static const uint64_t first[3] = {
+      0x1111111111111111ull, 0x000000000000ffffull, 0x000f000f000f000full};
+  return first[d] << (layer * cellStride[d]);
+}
+
+// A bit per layer of cells along d whose faces on that side are all hidden,
+// with every occupied cell opaque and facing another opaque cell
+static unsigned hiddenLayers(const MeshInput *input, int d, bool positive) {
+  unsigned hidden = 0;
+  for (int layer = 0; layer < CHUNK_CELLS; layer++) {
+    int next = positive ? layer + 1 : layer - 1;
+    uint64_t facing;
+    if (next < 0 || next >= CHUNK_CELLS) {
+      int face = d * 2 + (positive ? 0 : 1);
+      facing = (input->opaqueBorders >> face) & 1 ? UINT64_MAX : 0;
+    } else {
+      uint64_t opaque = input->opaque & cellLayer(d, next);
+      facing = positive ? opaque >> cellStride[d] : opaque << cellStride[d];
+    }
+
+    uint64_t cells = input->occupied & cellLayer(d, layer);
+    if ((cells & ~(input->opaque & facing)) == 0) {
+      hidden |= 1u << layer;
+    }
+  }
+  return hidden;
+}
+
+static void meshGreedy(const MeshInput *input, Mesh *mesh) {
+  uint32_t mask[CHUNK_SIZE * CHUNK_SIZE];
+
+  for (int face = 0; face < FACE_COUNT; face++) {
+    int d = face / 2;
+    bool positive = face % 2 == 0;
+    int u = (d + 1) % 3, v = (d + 2) % 3;
+    unsigned hidden = hiddenLayers(input, d, positive);
+
+    for (int slice = 0; slice < CHUNK_SIZE; slice++) {
+      if ((hidden >> (slice >> CHUNK_CELL_SHIFT)) & 1) {
+        continue;
+      }
+
+      // Build a mask of the visible faces in this slice
+      int sliceIndex = MESH_INPUT_INDEX(0, 0, 0) + slice * inputStride[d];
+      for (int j = 0; j < CHUNK_SIZE; j++) {
+        int index = sliceIndex + j * inputStride[v];
+        for (int i = 0; i < CHUNK_SIZE; i++, index += inputStride[u]) {
+          mask[i + j * CHUNK_SIZE] = faceKey(input, index, d, positive, true);
+        }
+      }
+
+      // Grow each face as wide as possible, then as tall as possible
+      for (int j = 0; j < CHUNK_SIZE; j++) {
+        for (int i = 0; i < CHUNK_SIZE;) {
+          uint32_t key = mask[i + j * CHUNK_SIZE];
+          if (key == 0) {
+            i++;
+            continue;
+          }
+
+          // Faces only stretch the way their occlusion stays the same,
+          // otherwise the corners of the first face would be stretched over
+          // faces that look different
+          unsigned ao = key >> KEY_AO_SHIFT & AO_NONE;
+          unsigned c0 = ao & 3, c1 = ao >> 2 & 3, c2 = ao >> 4 & 3;
+          unsigned c3 = ao >> 6;
+          bool alongU = c0 == c1 && c3 == c2;
+          bool alongV = c0 == c3 && c1 == c2;
+
+          int w = 1;
+          while (alongU && i + w < CHUNK_SIZE &&
+                 mask[i + w + j * CHUNK_SIZE] == key) {
+            w++;
+          }
+
+          int h = 1;
+          for (; alongV && j + h < CHUNK_SIZE; h++) {
+            int k = 0;
+            while (k < w && mask[i + k + (j + h) * CHUNK_SIZE] == key) {
+              k++;
+            }
+            if (k < w) {
+              break;
+            }
+          }
+
+          emitQuad(mesh, d, positive, slice, i, j, w, h, key);
+
+          for (int y = 0; y < h; y++) {
+            memset(&mask[i + (j + y) * CHUNK_SIZE], 0, w * sizeof(*mask));
+          }
+          i += w;
+        }
+      }
+    }
+  }
+}
+
+// Direction of each BlockFace
+static const int faceOffsets[FACE_COUNT][3] = {
+    {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+
+void gatherMeshInput(const World *world, const Chunk *chunk, MeshInput *input) {
+  // The chunk and its 26 neighbours, indexed by offset + 1 on each axis
+  const Chunk *around[27];
+  for (int dy = -1; dy <= 1; dy++) {
+    for (int dz = -1; dz <= 1; dz++) {
+      for (int dx = -1; dx <= 1; dx++) {
+        around[(dx + 1) + (dz + 1) * 3 + (dy + 1) * 9] =
+            (dx | dy | dz) == 0
+                ? chunk
+                : worldGetChunk(world, chunk->x + dx, chunk->y + dy,
+                                chunk->z + dz);
+      }
+    }
+  }
+
+  input->ambientOcclusion = true;
+  input->occupied = chunk->occupied;
+  input->opaque = chunk->opaque;
+  input->opaqueBorders = 0;
+  for (int face = 0; face < FACE_COUNT; face++) {
+    const int *offset = faceOffsets[face];
+    const Chunk *neighbour =
+        around[(offset[0] + 1) + (offset[2] + 1) * 3 + (offset[1] + 1) * 9];
+    if (neighbour != NULL && chunkFaceOpaque(neighbour, face ^ 1)) {
+      input->opaqueBorders |= 1 << face;
+    }
+  }
+
+  // The chunk itself is unpacked in one go, only the border is read from
+  // the neighbours a block at a time
+  BlockId blocks[CHUNK_VOLUME];
+  chunkGetBlocks(chunk, blocks);
+  for (int y = 0; y < CHUNK_SIZE; y++) {
+    for (int z = 0; z < CHUNK_SIZE; z++) {
+      int row = MESH_INPUT_INDEX(0, y, z);
+      memcpy(&input->blocks[row], &blocks[CHUNK_INDEX(0, y, z)],
+             CHUNK_SIZE * sizeof(BlockId));
+      if (chunk->light != NULL) {
+        memcpy(&input->light[row], &chunk->light[CHUNK_INDEX(0, y, z)],
+               CHUNK_SIZE);
+      } else {
+        memset(&input->light[row], chunk->uniformLight, CHUNK_SIZE);
+      }
+    }
+  }
+
+  for (int y = -1; y <= CHUNK_SIZE; y++) {
+    int cy = y < 0 ? 0 : (y < CHUNK_SIZE ? 1 : 2);
+    for (int z = -1; z <= CHUNK_SIZE; z++) {
+      int cz = z < 0 ? 0 : (z < CHUNK_SIZE ? 1 : 2);
+      for (int x = -1; x <= CHUNK_SIZE; x++) {
+        int cx = x < 0 ? 0 : (x < CHUNK_SIZE ? 1 : 2);
+        if (cx == 1 && cy == 1 && cz == 1) {
+          // Jump over the row copied above
+          x = CHUNK_SIZE - 1;
+          continue;
+        }
+
+        const Chunk *source = around[cx + cz * 3 + cy * 9];
+        int index = MESH_INPUT_INDEX(x, y, z);
+        if (source == NULL) {
+          input->blocks[index] = BLOCK_AIR;
+          input->light[index] = LIGHT_PACK(LIGHT_MAX, 0);
+          continue;
+        }
+        input->blocks[index] = chunkGetBlock(source, x & CHUNK_MASK,
+                                             y & CHUNK_MASK, z & CHUNK_MASK);
+        input->light[index] = chunkGetLight(source, x & CHUNK_MASK,
+                                            y & CHUNK_MASK, z & CHUNK_MASK);
+      }
+    }
+  }
+}
+
+bool meshIsEmpty(const World *world, const Chunk *chunk) {
+  if (chunk->occupied == 0) {
+    return true;
+  }
+  if (chunk->opaque != UINT64_MAX) {
+    return false;
+  }
+
+  for (int face = 0; face < FACE_COUNT; face++) {
+    const int *offset = faceOffsets[face];
+    const Chunk *neighbour =
+        worldGetChunk(world, chunk->x + offset[0], chunk->y + offset[1],
+                      chunk->z + offset[2]);
+    if (neighbour == NULL || !chunkFaceOpaque(neighbour, face ^ 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void meshChunk(const MeshInput *input, MeshMode mode, Mesh *mesh) {
+  mesh->vertexCount = 0;
+  mesh->indexCount = 0;
+  if (input->occupied == 0) {
+    return;
+  }
+
+  switch (mode) {
+  case MESH_NAIVE:
+    meshSimple(input, false, mesh);
+    break;
+  case MESH_CULLED:
+    meshSimple(input, true, mesh);
+    break;
+  default:
+    meshGreedy(input, mesh);
+    break;
+  }
+}
+
+static void runMeshJob(Job *job) {
+  MeshJob *meshJob = (MeshJob *)job;
+  double start = profileBegin();
+  meshChunk(&meshJob->input, meshJob->mode, &meshJob->mesh);
+  profileEnd("mesh chunk", start);
+  meshJob->meshTime = timerNow() - start;
+}
+
+MeshJob *createMeshJob(void) {
+  MeshJob *job = calloc(1, sizeof(MeshJob));
+  job->job.run = runMeshJob;
+  initMesh(&job->mesh);
+  return job;
+}
+
+void destroyMeshJob(MeshJob *job) {
+  freeMesh(&job->mesh);
+  free(job);
+}
+
+void prepareMeshJob(MeshJob *job, const World *world, const Chunk *chunk,
+                    MeshMode mode) {
+  job->x = chunk->x;
+  job->y = chunk->y;
+  job->z = chunk->z;
+  job->mode = mode;
+  gatherMeshInput(world, chunk, &job->input);
+}
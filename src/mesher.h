@@ -0,0 +1,86 @@
+#ifndef MESHER_H
+#define MESHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "block.h"
+#include "chunk.h"
+#include "threadpool.h"
+#include "vertex.h"
+#include "world.h"
+
+typedef enum MeshMode {
+  MESH_NAIVE = 0, // Every face of every block
+  MESH_CULLED,    // Only faces next to a non-opaque block
+  MESH_GREEDY,    // Culled faces merged into the largest quads possible
+  MESH_MODE_COUNT
+} MeshMode;
+
+// A chunk plus a one block border taken from its neighbours, so meshing
+// never has to look anything up in the world
+#define MESH_INPUT_SIZE (CHUNK_SIZE + 2)
+#define MESH_INPUT_VOLUME (MESH_INPUT_SIZE * MESH_INPUT_SIZE * MESH_INPUT_SIZE)
+
+// Coordinates range from -1 to CHUNK_SIZE inclusive
+#define MESH_INPUT_INDEX(x, y, z)                                              \
+  (((x) + 1) + ((z) + 1) * MESH_INPUT_SIZE +                                  \
+   ((y) + 1) * MESH_INPUT_SIZE * MESH_INPUT_SIZE)
+
+typedef struct MeshInput {
+  BlockId blocks[MESH_INPUT_VOLUME];
+  uint8_t light[MESH_INPUT_VOLUME];
+
+  // Darkens corners of faces next to opaque blocks. Only turned off to
+  // measure what it costs
+  bool ambientOcclusion;
+
+  // The chunk's cell bits, and a bit per BlockFace for borders known to be
+  // all opaque. Slices with nothing visible are skipped using these
+  uint64_t occupied, opaque;
+  uint8_t opaqueBorders;
+} MeshInput;
+
+// Indexed triangle mesh in chunk local coordinates
+typedef struct Mesh {
+  PackedVertex *vertices;
+  uint32_t *indices;
+  size_t vertexCount, vertexCapacity;
+  size_t indexCount, indexCapacity;
+} Mesh;
+
+// Meshing work for a thread pool. The input is a copy, so the world can
+// change while the job runs
+typedef struct MeshJob {
+  Job job;
+  int x, y, z; // Chunk coordinates
+  MeshMode mode;
+  MeshInput input;
+  Mesh mesh;
+  double meshTime; // Seconds spent in meshChunk
+  uint32_t version; // Left for the caller to tag the job with
+} MeshJob;
+
+void initMesh(Mesh *mesh);
+
+void freeMesh(Mesh *mesh);
+
+// Copy a chunk and its border out of the world. Missing neighbours are air
+void gatherMeshInput(const World *world, const Chunk *chunk, MeshInput *input);
+
+// True when the chunk is known to have no visible faces, being all air or
+// opaque all the way through with an opaque neighbour on every side. Such
+// chunks don't need gathering or meshing at all
+bool meshIsEmpty(const World *world, const Chunk *chunk);
+
+// Replaces the contents of the mesh with the surface of the input
+void meshChunk(const MeshInput *input, MeshMode mode, Mesh *mesh);
+
+MeshJob *createMeshJob(void);
+
+void destroyMeshJob(MeshJob *job);
+
+// Gathers the input on the calling thread so the job can run on any other
+void prepareMeshJob(MeshJob *job, const World *world, const Chunk *chunk,
+                    MeshMode mode);
+
+#endif
@@ -0,0 +1,359 @@
+#include <string.h>
+#include "noise.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define NOISE_X86
+#include <immintrin.h>
+#endif
+
+// Every backend does the same float operations in the same order, so they
+// agree bit for bit. This file is built with floating point contraction off
+// so FMA can't change that
+
+#define HASH_X 0x8da6b343u
+#define HASH_Y 0xd8163841u
+#define HASH_Z 0xcb1ab31fu
+#define HASH_MIX 0x27d4eb2du
+
+static inline uint32_t hashXZ(uint32_t seed, int32_t x, int32_t z) {
+  return seed ^ (uint32_t)x * HASH_X ^ (uint32_t)z * HASH_Z;
+}
+
+static inline uint32_t hashCorner(uint32_t xz, uint32_t y) {
+  uint32_t h = (xz ^ y) * HASH_MIX;
+  return h ^ (h >> 15);
+}
+
+static inline float fade(float t) {
+  return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+static inline float lerp(float t, float a, float b) { return a + t * (b - a); }
+
+static inline float flipSign(float value, uint32_t sign) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  bits ^= sign;
+  memcpy(&value, &bits, sizeof(bits));
+  return value;
+}
+
+// Ken Perlin's gradient selection, written so it vectorizes without branches
+static inline float grad(uint32_t hash, float x, float y, float z) {
+  uint32_t h = hash & 15;
+  float u = h < 8 ? x : y;
+  float v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+  return flipSign(u, (h & 1) << 31) + flipSign(v, (h & 2) << 30);
+}
+
+static inline int32_t floorToInt(float value) {
+  int32_t i = (int32_t)value;
+  return value < (float)i ? i - 1 : i;
+}
+
+float noise3(uint32_t seed, float x, float y, float z) {
+  int32_t ix = floorToInt(x), iy = floorToInt(y), iz = floorToInt(z);
+  float fx = x - (float)ix, fy = y - (float)iy, fz = z - (float)iz;
+  float u = fade(fx), v = fade(fy), w = fade(fz);
+
+  uint32_t xz00 = hashXZ(seed, ix, iz), xz10 = hashXZ(seed, ix + 1, iz);
+  uint32_t xz01 = hashXZ(seed, ix, iz + 1);
+  uint32_t xz11 = hashXZ(seed, ix + 1, iz + 1);
+  uint32_t y0 = (uint32_t)iy * HASH_Y, y1 = y0 + HASH_Y;
+
+  float n000 = grad(hashCorner(xz00, y0), fx, fy, fz);
+  float n100 = grad(hashCorner(xz10, y0), fx - 1.0f, fy, fz);
+  float n010 = grad(hashCorner(xz00, y1), fx, fy - 1.0f, fz);
+  float n110 = grad(hashCorner(xz10, y1), fx - 1.0f, fy - 1.0f, fz);
+  float n001 = grad(hashCorner(xz01, y0), fx, fy, fz - 1.0f);
+  float n101 = grad(hashCorner(xz11, y0), fx - 1.0f, fy, fz - 1.0f);
+  float n011 = grad(hashCorner(xz01, y1), fx, fy - 1.0f, fz - 1.0f);
+  float n111 = grad(hashCorner(xz11, y1), fx - 1.0f, fy - 1.0f, fz - 1.0f);
+
+  float nx00 = lerp(u, n000, n100), nx10 = lerp(u, n010, n110);
+  float nx01 = lerp(u, n001, n101), nx11 = lerp(u, n011, n111);
+  float nxy0 = lerp(v, nx00, nx10), nxy1 = lerp(v, nx01, nx11);
+  return lerp(w, nxy0, nxy1);
+}
+
+// Column backends fill out[first..count), so one can finish off another's
+// work with y computed the same way for every point
+static void noise3ColumnScalar(uint32_t seed, float x, float z, float y0,
+                               float yStep, int first, int count, float *out) {
+  for (int i = first; i < count; i++) {
+    out[i] = noise3(seed, x, y0 + (float)i * yStep, z);
+  }
+}
+
+#ifdef NOISE_X86
+
+// === SSE2, 4 points at a time === //
+
+#define SSE2 __attribute__((target("sse2")))
+
+SSE2 static inline __m128i mullo128(__m128i a, __m128i b) {
+  // SSE2 has no 32 bit multiply, so do the even and odd lanes separately
+  __m128i even = _mm_mul_epu32(a, b);
+  __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+SSE2 static inline __m128 select128(__m128 mask, __m128 a, __m128 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+SSE2 static inline __m128 grad128(__m128i hash, __m128 x, __m128 y,
+                                  __m128 z) {
+  __m128i h = _mm_and_si128(hash, _mm_set1_epi32(15));
+  __m128 lt8 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+  __m128 lt4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+  __m128 xSide = _mm_castsi128_ps(
+      _mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)),
+                   _mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+
+  __m128 u = select128(lt8, x, y);
+  __m128 v = select128(lt4, y, select128(xSide, x, z));
+
+  __m128 signU = _mm_castsi128_ps(
+      _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), 31));
+  __m128 signV = _mm_castsi128_ps(
+      _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), 30));
+  return _mm_add_ps(_mm_xor_ps(u, signU), _mm_xor_ps(v, signV));
+}
+
+SSE2 static inline __m128i hashCorner128(uint32_t xz, __m128i y) {
+  __m128i h = mullo128(_mm_xor_si128(_mm_set1_epi32((int)xz), y),
+                       _mm_set1_epi32((int)HASH_MIX));
+  return _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+}
+
+SSE2 static inline __m128 lerp128(__m128 t, __m128 a, __m128 b) {
+  return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+SSE2 static inline __m128 fade128(__m128 t) {
+  __m128 inner = _mm_add_ps(
+      _mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)),
+                               _mm_set1_ps(15.0f))),
+      _mm_set1_ps(10.0f));
+  return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+
+SSE2 static void noise3ColumnSSE2(uint32_t seed, float x, float z, float y0,
+                                  float yStep, int first, int count,
+                                  float *out) {
+  // x and z are the same for the whole column, so only y is vectorized
+  int32_t ix = floorToInt(x), iz = floorToInt(z);
+  float fxs = x - (float)ix, fzs = z - (float)iz;
+  __m128 fx = _mm_set1_ps(fxs), fz = _mm_set1_ps(fzs);
+  __m128 fx1 = _mm_set1_ps(fxs - 1.0f), fz1 = _mm_set1_ps(fzs - 1.0f);
+  __m128 u = _mm_set1_ps(fade(fxs)), w = _mm_set1_ps(fade(fzs));
+  __m128 one = _mm_set1_ps(1.0f);
+
+  uint32_t xz00 = hashXZ(seed, ix, iz), xz10 = hashXZ(seed, ix + 1, iz);
+  uint32_t xz01 = hashXZ(seed, ix, iz + 1);
+  uint32_t xz11 = hashXZ(seed, ix + 1, iz + 1);
+
+  int i = first;
+  for (; i + 4 <= count; i += 4) {
+    __m128 lane = _mm_set_ps((float)(i + 3), (float)(i + 2), (float)(i + 1),
+                             (float)i);
+    __m128 y =
+        _mm_add_ps(_mm_set1_ps(y0), _mm_mul_ps(lane, _mm_set1_ps(yStep)));
+
+    // Truncate, then step down for negative values that weren't whole
+    __m128i iy = _mm_cvttps_epi32(y);
+    __m128 below = _mm_cmplt_ps(y, _mm_cvtepi32_ps(iy));
+    iy = _mm_add_epi32(iy, _mm_castps_si128(below));
+
+    __m128 fy = _mm_sub_ps(y, _mm_cvtepi32_ps(iy));
+    __m128 fy1 = _mm_sub_ps(fy, one);
+    __m128 v = fade128(fy);
+
+    __m128i hy0 = mullo128(iy, _mm_set1_epi32((int)HASH_Y));
+    __m128i hy1 = _mm_add_epi32(hy0, _mm_set1_epi32((int)HASH_Y));
+
+    __m128 n000 = grad128(hashCorner128(xz00, hy0), fx, fy, fz);
+    __m128 n100 = grad128(hashCorner128(xz10, hy0), fx1, fy, fz);
+    __m128 n010 = grad128(hashCorner128(xz00, hy1), fx, fy1, fz);
+    __m128 n110 = grad128(hashCorner128(xz10, hy1), fx1, fy1, fz);
+    __m128 n001 = grad128(hashCorner128(xz01, hy0), fx, fy, fz1);
+    __m128 n101 = grad128(hashCorner128(xz11, hy0), fx1, fy, fz1);
+    __m128 n011 = grad128(hashCorner128(xz01, hy1), fx, fy1, fz1);
+    __m128 n111 = grad128(hashCorner128(xz11, hy1), fx1, fy1, fz1);
+
+    __m128 nx00 = lerp128(u, n000, n100), nx10 = lerp128(u, n010, n110);
+    __m128 nx01 = lerp128(u, n001, n101), nx11 = lerp128(u, n011, n111);
+    __m128 nxy0 = lerp128(v, nx00, nx10), nxy1 = lerp128(v, nx01, nx11);
+    _mm_storeu_ps(out + i, lerp128(w, nxy0, nxy1));
+  }
+
+  noise3ColumnScalar(seed, x, z, y0, yStep, i, count, out);
+}
+
+// === AVX2, 8 points at a time === //
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256 select256(__m256 mask, __m256 a, __m256 b) {
+  return _mm256_blendv_ps(b, a, mask);
+}
+
+AVX2 static inline __m256 grad256(__m256i hash, __m256 x, __m256 y,
+                                  __m256 z) {
+  __m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+  __m256 lt8 =
+      _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h));
+  __m256 lt4 =
+      _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h));
+  __m256 xSide = _mm256_castsi256_ps(
+      _mm256_or_si256(_mm256_cmpeq_epi32(h, _mm256_set1_epi32(12)),
+                      _mm256_cmpeq_epi32(h, _mm256_set1_epi32(14))));
+
+  __m256 u = select256(lt8, x, y);
+  __m256 v = select256(lt4, y, select256(xSide, x, z));
+
+  __m256 signU = _mm256_castsi256_ps(
+      _mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(1)), 31));
+  __m256 signV = _mm256_castsi256_ps(
+      _mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(2)), 30));
+  return _mm256_add_ps(_mm256_xor_ps(u, signU), _mm256_xor_ps(v, signV));
+}
+
+AVX2 static inline __m256i hashCorner256(uint32_t xz, __m256i y) {
+  __m256i h = _mm256_xor_si256(_mm256_set1_epi32((int)xz), y);
+  h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)HASH_MIX));
+  return _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+}
+
+AVX2 static inline __m256 lerp256(__m256 t, __m256 a, __m256 b) {
+  return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+AVX2 static inline __m256 fade256(__m256 t) {
+  __m256 inner = _mm256_add_ps(
+      _mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)),
+                                     _mm256_set1_ps(15.0f))),
+      _mm256_set1_ps(10.0f));
+  return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), inner);
+}
+
+AVX2 static void noise3ColumnAVX2(uint32_t seed, float x, float z, float y0,
+                                  float yStep, int first, int count,
+                                  float *out) {
+  int32_t ix = floorToInt(x), iz = floorToInt(z);
+  float fxs = x - (float)ix, fzs = z - (float)iz;
+  __m256 fx = _mm256_set1_ps(fxs), fz = _mm256_set1_ps(fzs);
+  __m256 fx1 = _mm256_set1_ps(fxs - 1.0f), fz1 = _mm256_set1_ps(fzs - 1.0f);
+  __m256 u = _mm256_set1_ps(fade(fxs)), w = _mm256_set1_ps(fade(fzs));
+  __m256 one = _mm256_set1_ps(1.0f);
+
+  uint32_t xz00 = hashXZ(seed, ix, iz), xz10 = hashXZ(seed, ix + 1, iz);
+  uint32_t xz01 = hashXZ(seed, ix, iz + 1);
+  uint32_t xz11 = hashXZ(seed, ix + 1, iz + 1);
+
+  int i = first;
+  for (; i + 8 <= count; i += 8) {
+    __m256 lane = _mm256_set_ps((float)(i + 7), (float)(i + 6), (float)(i + 5),
+                                (float)(i + 4), (float)(i + 3), (float)(i + 2),
+                                (float)(i + 1), (float)i);
+    __m256 y = _mm256_add_ps(_mm256_set1_ps(y0),
+                             _mm256_mul_ps(lane, _mm256_set1_ps(yStep)));
+
+    __m256i iy = _mm256_cvttps_epi32(_mm256_floor_ps(y));
+    __m256 fy = _mm256_sub_ps(y, _mm256_cvtepi32_ps(iy));
+    __m256 fy1 = _mm256_sub_ps(fy, one);
+    __m256 v = fade256(fy);
+
+    __m256i hy0 = _mm256_mullo_epi32(iy, _mm256_set1_epi32((int)HASH_Y));
+    __m256i hy1 = _mm256_add_epi32(hy0, _mm256_set1_epi32((int)HASH_Y));
+
+    __m256 n000 = grad256(hashCorner256(xz00, hy0), fx, fy, fz);
+    __m256 n100 = grad256(hashCorner256(xz10, hy0), fx1, fy, fz);
+    __m256 n010 = grad256(hashCorner256(xz00, hy1), fx, fy1, fz);
+    __m256 n110 = grad256(hashCorner256(xz10, hy1), fx1, fy1, fz);
+    __m256 n001 = grad256(hashCorner256(xz01, hy0), fx, fy, fz1);
+    __m256 n101 = grad256(hashCorner256(xz11, hy0), fx1, fy, fz1);
+    __m256 n011 = grad256(hashCorner256(xz01, hy1), fx, fy1, fz1);
+    __m256 n111 = grad256(hashCorner256(xz11, hy1), fx1, fy1, fz1);
+
+    __m256 nx00 = lerp256(u, n000, n100), nx10 = lerp256(u, n010, n110);
+    __m256 nx01 = lerp256(u, n001, n101), nx11 = lerp256(u, n011, n111);
+    __m256 nxy0 = lerp256(v, nx00, nx10), nxy1 = lerp256(v, nx01, nx11);
+    _mm256_storeu_ps(out + i, lerp256(w, nxy0, nxy1));
+  }
+
+  // Finish off with SSE2, which is always there alongside AVX2
+  noise3ColumnSSE2(seed, x, z, y0, yStep, i, count, out);
+}
+
+#endif
+
+typedef void (*NoiseColumnFn)(uint32_t seed, float x, float z, float y0,
+                              float yStep, int first, int count, float *out);
+
+typedef struct NoiseBackendInfo {
+  const char *name;
+  NoiseColumnFn column;
+} NoiseBackendInfo;
+
+static const NoiseBackendInfo backends[] = {
+#ifdef NOISE_X86
+    {"avx2", noise3ColumnAVX2},
+    {"sse2", noise3ColumnSSE2},
+#endif
+    {"scalar", noise3ColumnScalar},
+};
+
+#define BACKEND_COUNT (sizeof(backends) / sizeof(backends[0]))
+
+// Set once, but possibly from several generator threads at the same time
+static const NoiseBackendInfo *activeBackend = NULL;
+
+static bool backendSupported(const NoiseBackendInfo *backend) {
+#ifdef NOISE_X86
+  if (strcmp(backend->name, "avx2") == 0) {
+    return __builtin_cpu_supports("avx2");
+  }
+  if (strcmp(backend->name, "sse2") == 0) {
+    return __builtin_cpu_supports("sse2");
+  }
+#endif
+  return true;
+}
+
+static const NoiseBackendInfo *selectBackend(void) {
+  const NoiseBackendInfo *backend =
+      __atomic_load_n(&activeBackend, __ATOMIC_ACQUIRE);
+  if (backend == NULL) {
+    // Backends are listed fastest first, scalar always works
+    backend = &backends[BACKEND_COUNT - 1];
+    for (size_t i = 0; i < BACKEND_COUNT; i++) {
+      if (backendSupported(&backends[i])) {
+        backend = &backends[i];
+        break;
+      }
+    }
+    __atomic_store_n(&activeBackend, backend, __ATOMIC_RELEASE);
+  }
+  return backend;
+}
+
+void noise3Column(uint32_t seed, float x, float z, float y0, float yStep,
+                  int count, float *out) {
+  selectBackend()->column(seed, x, z, y0, yStep, 0, count, out);
+}
+
+const char *noiseBackend(void) { return selectBackend()->name; }
+
+bool setNoiseBackend(const char *name) {
+  for (size_t i = 0; i < BACKEND_COUNT; i++) {
+    if (strcmp(backends[i].name, name) == 0 &&
+        backendSupported(&backends[i])) {
+      __atomic_store_n(&activeBackend, &backends[i], __ATOMIC_RELEASE);
+      return true;
+    }
+  }
+  return false;
+}
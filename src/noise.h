@@ -0,0 +1,22 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// 3D gradient noise in roughly [-1, 1]. The same seed and position always
+// give the same value, whichever backend is in use
+float noise3(uint32_t seed, float x, float y, float z);
+
+// Noise at (x, y0 + i * yStep, z) for i in [0, count), evaluated several
+// points at a time with the fastest backend the CPU supports
+void noise3Column(uint32_t seed, float x, float z, float y0, float yStep,
+                  int count, float *out);
+
+// Name of the backend noise3Column uses: "avx2", "sse2" or "scalar"
+const char *noiseBackend(void);
+
+// Force a backend by name, fails if the CPU doesn't support it
+bool setNoiseBackend(const char *name);
+
+#endif
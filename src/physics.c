@@ -0,0 +1,332 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "physics.h"
+#include "profiler.h"
+
+// Bodies stop this far short of what they hit, so a box resting against a
+// block is never inside it
+#define SKIN 0.001f
+
+// Share of the overlap between two bodies pushed out every step, so crowds
+// spread out over a few ticks instead of jittering
+#define PUSH_RATE 0.25f
+
+// Looks blocks up through the last chunk used, since the blocks around a
+// body are nearly always in one or two chunks
+typedef struct BlockCache {
+  const World *world;
+  const Chunk *chunk;
+  int cx, cy, cz;
+  bool looked;
+  PhysicsStats *stats;
+} BlockCache;
+
+static bool solidAt(BlockCache *cache, int x, int y, int z) {
+  int cx = WORLD_TO_CHUNK(x), cy = WORLD_TO_CHUNK(y), cz = WORLD_TO_CHUNK(z);
+  if (!cache->looked || cx != cache->cx || cy != cache->cy ||
+      cz != cache->cz) {
+    cache->chunk = worldGetChunk(cache->world, cx, cy, cz);
+    cache->cx = cx;
+    cache->cy = cy;
+    cache->cz = cz;
+    cache->looked = true;
+  }
+
+  // Missing chunks are air, and so are cells with nothing in them
+  const Chunk *chunk = cache->chunk;
+  if (chunk == NULL || chunk->occupied == 0) {
+    return false;
+  }
+  int lx = WORLD_TO_LOCAL(x), ly = WORLD_TO_LOCAL(y), lz = WORLD_TO_LOCAL(z);
+  if (((chunk->occupied >> CHUNK_CELL_INDEX(lx, ly, lz)) & 1) == 0) {
+    return false;
+  }
+  cache->stats->blocksTested++;
+  return chunkGetBlock(chunk, lx, ly, lz) != BLOCK_AIR;
+}
+
+static void bodyBox(const Body *body, float min[3], float max[3]) {
+  min[0] = body->position[0] - body->halfWidth;
+  min[1] = body->position[1];
+  min[2] = body->position[2] - body->halfWidth;
+  max[0] = body->position[0] + body->halfWidth;
+  max[1] = body->position[1] + body->height;
+  max[2] = body->position[2] + body->halfWidth;
+}
+
+// How much of delta the box can move along the axis before it runs into a
+// block. Reads the layers of blocks its leading face passes into, nearest
+// first, across the blocks the box covers on the other two axes
+static float sweepAxis(BlockCache *cache, const float min[3],
+                       const float max[3], int axis, float delta) {
+  if (delta == 0.0f) {
+    return 0.0f;
+  }
+
+  // A box touching a block boundary doesn't cover the block past it
+  int u = (axis + 1) % 3, v = (axis + 2) % 3;
+  int u0 = (int)floorf(min[u]), u1 = (int)ceilf(max[u]) - 1;
+  int v0 = (int)floorf(min[v]), v1 = (int)ceilf(max[v]) - 1;
+
+  int first, last, step;
+  if (delta > 0.0f) {
+    first = (int)ceilf(max[axis]);
+    last = (int)ceilf(max[axis] + delta) - 1;
+    step = 1;
+  } else {
+    first = (int)floorf(min[axis]) - 1;
+    last = (int)floorf(min[axis] + delta);
+    step = -1;
+  }
+
+  for (int layer = first; step > 0 ? layer <= last : layer >= last;
+       layer += step) {
+    for (int a = u0; a <= u1; a++) {
+      for (int b = v0; b <= v1; b++) {
+        int pos[3];
+        pos[axis] = layer;
+        pos[u] = a;
+        pos[v] = b;
+        if (!solidAt(cache, pos[0], pos[1], pos[2])) {
+          continue;
+        }
+
+        // Already touching it, or a rounding error inside it, moves nowhere
+        if (step > 0) {
+          return fmaxf((float)layer - max[axis] - SKIN, 0.0f);
+        }
+        return fminf((float)(layer + 1) - min[axis] + SKIN, 0.0f);
+      }
+    }
+  }
+  return delta;
+}
+
+// Returns how far the body went
+static float moveAxis(BlockCache *cache, Body *body, int axis, float delta) {
+  float min[3], max[3];
+  bodyBox(body, min, max);
+  float moved = sweepAxis(cache, min, max, axis, delta);
+  body->position[axis] += moved;
+  return moved;
+}
+
+static void moveBody(BlockCache *cache, Body *body, const float delta[3]) {
+  // Up and down first, so a body can land on the ledge it is moving over
+  float fell = moveAxis(cache, body, 1, delta[1]);
+  body->onGround = delta[1] < 0.0f && fell != delta[1];
+  if (fell != delta[1]) {
+    body->velocity[1] = 0.0f;
+  }
+
+  float start[3] = {body->position[0], body->position[1], body->position[2]};
+  float moved[2];
+  moved[0] = moveAxis(cache, body, 0, delta[0]);
+  moved[1] = moveAxis(cache, body, 2, delta[2]);
+  bool blocked = moved[0] != delta[0] || moved[1] != delta[2];
+
+  // Up the ledge, across and back down onto it, kept if that gets further
+  if (blocked && body->onGround && body->stepHeight > 0.0f) {
+    float flat[3] = {body->position[0], body->position[1], body->position[2]};
+    float flatMoved[2] = {moved[0], moved[1]};
+    memcpy(body->position, start, sizeof(start));
+
+    float climbed = moveAxis(cache, body, 1, body->stepHeight);
+    moved[0] = moveAxis(cache, body, 0, delta[0]);
+    moved[1] = moveAxis(cache, body, 2, delta[2]);
+    moveAxis(cache, body, 1, -climbed);
+
+    if (moved[0] * moved[0] + moved[1] * moved[1] <=
+        flatMoved[0] * flatMoved[0] + flatMoved[1] * flatMoved[1]) {
+      memcpy(body->position, flat, sizeof(flat));
+      moved[0] = flatMoved[0];
+      moved[1] = flatMoved[1];
+    }
+  }
+
+  if (moved[0] != delta[0]) {
+    body->velocity[0] = 0.0f;
+  }
+  if (moved[1] != delta[2]) {
+    body->velocity[2] = 0.0f;
+  }
+}
+
+static float fall(float velocity, float seconds) {
+  velocity -= PHYSICS_GRAVITY * seconds;
+  return velocity < -PHYSICS_TERMINAL_VELOCITY ? -PHYSICS_TERMINAL_VELOCITY
+                                               : velocity;
+}
+
+void bodyStep(const World *world, Body *body, float seconds,
+              PhysicsStats *stats) {
+  PhysicsStats unused;
+  BlockCache cache = {world, NULL, 0, 0, 0, false,
+                      stats != NULL ? stats : &unused};
+  body->velocity[1] = fall(body->velocity[1], seconds);
+  float delta[3];
+  for (int i = 0; i < 3; i++) {
+    delta[i] = body->velocity[i] * seconds;
+  }
+  moveBody(&cache, body, delta);
+}
+
+void initPhysics(Physics *physics) { memset(physics, 0, sizeof(*physics)); }
+
+void freePhysics(Physics *physics) {
+  free(physics->bucketStart);
+  free(physics->sorted);
+  free(physics->cells);
+  free(physics->push);
+  memset(physics, 0, sizeof(*physics));
+}
+
+static void reserve(Physics *physics, size_t count) {
+  if (count <= physics->capacity) {
+    return;
+  }
+  size_t capacity = physics->capacity > 0 ? physics->capacity : 64;
+  while (capacity < count) {
+    capacity *= 2;
+  }
+
+  // Twice as many buckets as bodies keeps collisions between cells rare
+  physics->capacity = capacity;
+  physics->bucketCount = capacity * 2;
+  physics->bucketStart =
+      realloc(physics->bucketStart,
+              (physics->bucketCount + 1) * sizeof(*physics->bucketStart));
+  physics->sorted =
+      realloc(physics->sorted, capacity * sizeof(*physics->sorted));
+  physics->cells = realloc(physics->cells, capacity * sizeof(*physics->cells));
+  physics->push = realloc(physics->push, capacity * sizeof(*physics->push));
+}
+
+static uint32_t cellBucket(const Physics *physics, const int cell[3]) {
+  uint32_t hash = (uint32_t)cell[0] * 73856093u ^
+                  (uint32_t)cell[1] * 19349663u ^
+                  (uint32_t)cell[2] * 83492791u;
+  return hash & (uint32_t)(physics->bucketCount - 1);
+}
+
+// Counting sort of the bodies by bucket
+static void binBodies(Physics *physics, const BodyArrays *bodies) {
+  size_t count = bodies->count;
+  uint32_t *start = physics->bucketStart;
+  memset(start, 0, (physics->bucketCount + 1) * sizeof(*start));
+  for (size_t i = 0; i < count; i++) {
+    for (int j = 0; j < 3; j++) {
+      physics->cells[i][j] =
+          (int)floorf(bodies->position[j][i]) >> CHUNK_CELL_SHIFT;
+    }
+    start[cellBucket(physics, physics->cells[i]) + 1]++;
+  }
+  for (size_t b = 0; b < physics->bucketCount; b++) {
+    start[b + 1] += start[b];
+  }
+
+  // Placing moves each start up to the next bucket's, so shift them back
+  for (size_t i = 0; i < count; i++) {
+    physics->sorted[start[cellBucket(physics, physics->cells[i])]++] =
+        (uint32_t)i;
+  }
+  memmove(start + 1, start, physics->bucketCount * sizeof(*start));
+  start[0] = 0;
+}
+
+// Overlapping bodies push each other out sideways, along whichever axis
+// they overlap least on
+static void pushPair(Physics *physics, const BodyArrays *bodies, size_t i,
+                     size_t j) {
+  physics->stats.pairsTested++;
+
+  const float *x = bodies->position[0], *y = bodies->position[1];
+  const float *z = bodies->position[2], *height = bodies->height;
+  float below = fminf(y[i] + height[i], y[j] + height[j]);
+  float above = fmaxf(y[i], y[j]);
+  float reach = bodies->halfWidth[i] + bodies->halfWidth[j];
+  float dx = x[j] - x[i], dz = z[j] - z[i];
+  float overlapX = reach - fabsf(dx), overlapZ = reach - fabsf(dz);
+  if (below <= above || overlapX <= 0.0f || overlapZ <= 0.0f) {
+    return;
+  }
+  physics->stats.contacts++;
+
+  int axis = overlapX < overlapZ ? 0 : 1;
+  float overlap = axis == 0 ? overlapX : overlapZ;
+  float direction = axis == 0 ? dx : dz;
+  // Bodies right on top of each other go apart by index
+  float amount = overlap * PUSH_RATE * 0.5f * (direction < 0.0f ? -1 : 1);
+  physics->push[i][axis] -= amount;
+  physics->push[j][axis] += amount;
+}
+
+// Each pair is found once, from their cell when they share one and
+// otherwise from whichever of their two cells comes first in y, z, x
+// order. So each body looks through 14 cells, not all 27 around it
+static void pushApart(Physics *physics, const BodyArrays *bodies) {
+  size_t count = bodies->count;
+  memset(physics->push, 0, count * sizeof(*physics->push));
+  for (size_t i = 0; i < count; i++) {
+    const int *home = physics->cells[i];
+    for (int n = 13; n < 27; n++) {
+      int cell[3] = {home[0] + n % 3 - 1, home[1] + n / 9 - 1,
+                     home[2] + n / 3 % 3 - 1};
+      uint32_t bucket = cellBucket(physics, cell);
+
+      // Buckets can hold other cells, so only bodies really in this one
+      // count
+      for (uint32_t k = physics->bucketStart[bucket];
+           k < physics->bucketStart[bucket + 1]; k++) {
+        uint32_t j = physics->sorted[k];
+        const int *other = physics->cells[j];
+        if ((n > 13 || j > i) && other[0] == cell[0] &&
+            other[1] == cell[1] && other[2] == cell[2]) {
+          pushPair(physics, bodies, i, j);
+        }
+      }
+    }
+  }
+}
+
+void physicsStep(Physics *physics, const World *world,
+                 const BodyArrays *bodies, float seconds) {
+  double start = profileBegin();
+  size_t count = bodies->count;
+  memset(&physics->stats, 0, sizeof(physics->stats));
+  reserve(physics, count);
+  binBodies(physics, bodies);
+  pushApart(physics, bodies);
+
+  // Straight over the arrays, which compilers turn into vector code
+  float *restrict velocity = bodies->velocity[1];
+  for (size_t i = 0; i < count; i++) {
+    velocity[i] = fall(velocity[i], seconds);
+  }
+
+  // Sweeps go block by block, one body at a time
+  BlockCache cache = {world, NULL, 0, 0, 0, false, &physics->stats};
+  for (size_t i = 0; i < count; i++) {
+    Body body;
+    for (int j = 0; j < 3; j++) {
+      body.position[j] = bodies->position[j][i];
+      body.velocity[j] = bodies->velocity[j][i];
+    }
+    body.halfWidth = bodies->halfWidth[i];
+    body.height = bodies->height[i];
+    body.stepHeight = bodies->stepHeight[i];
+
+    float delta[3] = {body.velocity[0] * seconds + physics->push[i][0],
+                      body.velocity[1] * seconds,
+                      body.velocity[2] * seconds + physics->push[i][1]};
+    moveBody(&cache, &body, delta);
+
+    for (int j = 0; j < 3; j++) {
+      bodies->position[j][i] = body.position[j];
+      bodies->velocity[j][i] = body.velocity[j];
+    }
+    bodies->onGround[i] = body.onGround;
+  }
+  profileEnd("physics step", start);
+}
@@ -0,0 +1,71 @@
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "world.h"
+
+// Blocks per second squared, and the fastest anything falls
+#define PHYSICS_GRAVITY 32.0f
+#define PHYSICS_TERMINAL_VELOCITY 60.0f
+
+// An upright box that collides with every block that isn't air. Bodies
+// can't be more than a cell, 4 blocks, across or tall
+typedef struct Body {
+  float position[3]; // Middle of the bottom face
+  float velocity[3]; // Blocks per second
+  float halfWidth, height;
+  float stepHeight; // Tallest ledge it walks up without jumping
+  bool onGround;
+} Body;
+
+// Many bodies with one array per field, so the arithmetic done for every
+// body runs over contiguous floats. Every array is count long
+typedef struct BodyArrays {
+  float *position[3];
+  float *velocity[3];
+  float *halfWidth, *height, *stepHeight;
+  bool *onGround;
+  size_t count;
+} BodyArrays;
+
+typedef struct PhysicsStats {
+  size_t pairsTested; // Bodies close enough to share a cell neighbourhood
+  size_t contacts;    // Of those, the ones that overlapped
+  size_t blocksTested;
+} PhysicsStats;
+
+// Moves bodies through the world, and apart from each other. Bodies are
+// binned by the 4x4x4 chunk cell they stand in, so only bodies in
+// neighbouring cells are ever compared
+typedef struct Physics {
+  // Rebuilt every step. Bodies sorted by the bucket their cell hashes to,
+  // the ones in bucket b are sorted[bucketStart[b]..bucketStart[b + 1]]
+  size_t capacity, bucketCount;
+  uint32_t *bucketStart;
+  uint32_t *sorted;
+  int (*cells)[3];
+  float (*push)[2]; // How far overlapping bodies push each one this step
+
+  PhysicsStats stats; // Of the latest step
+} Physics;
+
+void initPhysics(Physics *physics);
+
+void freePhysics(Physics *physics);
+
+// Pulls a body down by gravity and moves it by velocity for the given
+// seconds. Each axis is swept on its own, up first, so it slides along
+// whatever it hits, and a body on the ground blocked sideways tries again
+// stepped up by its stepHeight. Only reads the blocks the swept box passes
+// through. stats may be NULL
+void bodyStep(const World *world, Body *body, float seconds,
+              PhysicsStats *stats);
+
+// Steps every body like bodyStep, after pushing overlapping ones apart.
+// Only reads the world, which mustn't change until it returns
+void physicsStep(Physics *physics, const World *world,
+                 const BodyArrays *bodies, float seconds);
+
+#endif
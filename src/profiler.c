@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profiler.h"
+#include "timer.h"
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+static const char *counterNames[COUNTER_COUNT] = {
+    "draw calls",
+    "triangles",
+    "upload bytes",
+    "chunks meshed",
+    "sim ticks",
+};
+
+static ProfileTrack *tracks[PROFILE_MAX_TRACKS];
+static int trackCount;
+
+static THREAD_LOCAL ProfileTrack *threadTrack;
+static THREAD_LOCAL bool threadTrackCreated;
+
+// Summed by any thread, then sampled and reset by profileFrame
+static uint64_t counters[COUNTER_COUNT];
+static uint64_t counterValues[COUNTER_COUNT];
+static double frameStart;
+
+// Returns NULL once there are too many tracks, which drops their events
+static ProfileTrack *newTrack(const char *name) {
+  int id = __atomic_fetch_add(&trackCount, 1, __ATOMIC_ACQ_REL);
+  if (id >= PROFILE_MAX_TRACKS) {
+    return NULL;
+  }
+
+  ProfileTrack *track = calloc(1, sizeof(ProfileTrack));
+  track->name = name;
+  track->id = id;
+  __atomic_store_n(&tracks[id], track, __ATOMIC_RELEASE);
+  return track;
+}
+
+static ProfileTrack *currentTrack(void) {
+  if (!threadTrackCreated) {
+    threadTrack = newTrack("thread");
+    threadTrackCreated = true;
+  }
+  return threadTrack;
+}
+
+static void record(ProfileTrack *track, const char *name, double start,
+                   double value, ProfileEventType type) {
+  if (track == NULL) {
+    return;
+  }
+
+  uint64_t head = track->head;
+  ProfileEvent *event = &track->events[head & (PROFILE_RING_SIZE - 1)];
+  event->name = name;
+  event->start = start;
+  event->value = value;
+  event->type = type;
+  __atomic_store_n(&track->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void profileThreadName(const char *name) {
+  ProfileTrack *track = currentTrack();
+  if (track != NULL) {
+    track->name = name;
+  }
+}
+
+ProfileTrack *profileTrack(const char *name) { return newTrack(name); }
+
+double profileBegin(void) { return timerNow(); }
+
+void profileEnd(const char *name, double start) {
+  record(currentTrack(), name, start, timerNow() - start, PROFILE_ZONE);
+}
+
+void profileTrackZone(ProfileTrack *track, const char *name, double start,
+                      double duration) {
+  record(track, name, start, duration, PROFILE_ZONE);
+}
+
+void profileCount(ProfileCounter counter, uint64_t amount) {
+  __atomic_fetch_add(&counters[counter], amount, __ATOMIC_RELAXED);
+}
+
+double profileFrame(void) {
+  double now = timerNow();
+  double length = frameStart > 0.0 ? now - frameStart : 0.0;
+  if (frameStart > 0.0) {
+    record(currentTrack(), "frame", frameStart, length, PROFILE_ZONE);
+  }
+
+  for (int i = 0; i < COUNTER_COUNT; i++) {
+    counterValues[i] = __atomic_exchange_n(&counters[i], 0, __ATOMIC_RELAXED);
+    record(currentTrack(), counterNames[i], now, (double)counterValues[i],
+           PROFILE_COUNTER);
+  }
+
+  frameStart = now;
+  return length;
+}
+
+uint64_t profileCounterValue(ProfileCounter counter) {
+  return counterValues[counter];
+}
+
+// Copies out the events of a track that are still intact. Other threads
+// can keep recording, so anything they may have overwritten while copying
+// is left out
+static size_t snapshotTrack(const ProfileTrack *track, ProfileEvent *events) {
+  uint64_t head = __atomic_load_n(&track->head, __ATOMIC_ACQUIRE);
+  uint64_t first = head > PROFILE_RING_SIZE ? head - PROFILE_RING_SIZE : 0;
+  for (uint64_t i = first; i < head; i++) {
+    events[i - first] = track->events[i & (PROFILE_RING_SIZE - 1)];
+  }
+
+  uint64_t newHead = __atomic_load_n(&track->head, __ATOMIC_ACQUIRE);
+  uint64_t intact =
+      newHead >= PROFILE_RING_SIZE ? newHead - PROFILE_RING_SIZE + 1 : 0;
+  if (intact > first) {
+    size_t skipped = (size_t)(intact < head ? intact - first : head - first);
+    memmove(events, events + skipped,
+            (size_t)(head - first - skipped) * sizeof(ProfileEvent));
+    return (size_t)(head - first) - skipped;
+  }
+  return (size_t)(head - first);
+}
+
+bool profileDump(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    printf("Failed to open trace file %s\n", path);
+    return false;
+  }
+
+  int count = __atomic_load_n(&trackCount, __ATOMIC_ACQUIRE);
+  count = count < PROFILE_MAX_TRACKS ? count : PROFILE_MAX_TRACKS;
+
+  ProfileEvent *events[PROFILE_MAX_TRACKS] = {NULL};
+  size_t eventCounts[PROFILE_MAX_TRACKS] = {0};
+  double epoch = -1.0;
+
+  for (int t = 0; t < count; t++) {
+    const ProfileTrack *track = __atomic_load_n(&tracks[t], __ATOMIC_ACQUIRE);
+    if (track == NULL) {
+      continue;
+    }
+
+    events[t] = malloc(PROFILE_RING_SIZE * sizeof(ProfileEvent));
+    eventCounts[t] = snapshotTrack(track, events[t]);
+    for (size_t i = 0; i < eventCounts[t]; i++) {
+      if (epoch < 0.0 || events[t][i].start < epoch) {
+        epoch = events[t][i].start;
+      }
+    }
+  }
+
+  // Timestamps are in microseconds from the oldest event
+  fprintf(file, "{\"traceEvents\":[\n");
+  bool first = true;
+  for (int t = 0; t < count; t++) {
+    const ProfileTrack *track = __atomic_load_n(&tracks[t], __ATOMIC_ACQUIRE);
+    if (track == NULL) {
+      continue;
+    }
+
+    fprintf(file,
+            "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+            "\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",\n", track->id, track->name);
+    first = false;
+
+    for (size_t i = 0; i < eventCounts[t]; i++) {
+      const ProfileEvent *event = &events[t][i];
+      double ts = (event->start - epoch) * 1e6;
+      if (event->type == PROFILE_ZONE) {
+        fprintf(file,
+                ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                "\"ts\":%.3f,\"dur\":%.3f}",
+                event->name, track->id, ts, event->value * 1e6);
+      } else {
+        fprintf(file,
+                ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,"
+                "\"ts\":%.3f,\"args\":{\"value\":%.0f}}",
+                event->name, track->id, ts, event->value);
+      }
+    }
+    free(events[t]);
+  }
+  fprintf(file, "\n]}\n");
+
+  bool ok = fclose(file) == 0;
+  if (ok) {
+    printf("Wrote trace to %s\n", path);
+  }
+  return ok;
+}
+
+void profileShutdown(void) {
+  int count = __atomic_load_n(&trackCount, __ATOMIC_ACQUIRE);
+  count = count < PROFILE_MAX_TRACKS ? count : PROFILE_MAX_TRACKS;
+  for (int t = 0; t < count; t++) {
+    free(tracks[t]);
+    tracks[t] = NULL;
+  }
+  trackCount = 0;
+  threadTrack = NULL;
+  threadTrackCreated = false;
+}
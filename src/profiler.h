@@ -0,0 +1,80 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Events kept per track, older ones are overwritten
+#define PROFILE_RING_SIZE (1 << 14)
+#define PROFILE_MAX_TRACKS 64
+
+typedef enum ProfileCounter {
+  COUNTER_DRAW_CALLS,
+  COUNTER_TRIANGLES,
+  COUNTER_UPLOAD_BYTES,
+  COUNTER_CHUNKS_MESHED,
+  COUNTER_SIM_TICKS,
+  COUNTER_COUNT
+} ProfileCounter;
+
+typedef enum ProfileEventType {
+  PROFILE_ZONE,
+  PROFILE_COUNTER
+} ProfileEventType;
+
+// Names are never copied, so they have to outlive the profiler. String
+// literals are the intended use
+typedef struct ProfileEvent {
+  const char *name;
+  double start;
+  // Length of a zone or the value of a counter
+  double value;
+  ProfileEventType type;
+} ProfileEvent;
+
+// A timeline in the trace. Each thread gets its own the first time it
+// records something, and only that thread writes to it
+typedef struct ProfileTrack {
+  const char *name;
+  int id;
+  uint64_t head;
+  ProfileEvent events[PROFILE_RING_SIZE];
+} ProfileTrack;
+
+// Names the calling thread's track
+void profileThreadName(const char *name);
+
+// A track not tied to a thread, e.g. for GPU timings. Only one thread may
+// record to it at a time
+ProfileTrack *profileTrack(const char *name);
+
+// Zones are timed with a pair of calls:
+//   double start = profileBegin();
+//   ...
+//   profileEnd("name", start);
+double profileBegin(void);
+void profileEnd(const char *name, double start);
+
+// Records a zone on another track, start in timerNow seconds
+void profileTrackZone(ProfileTrack *track, const char *name, double start,
+                      double duration);
+
+// Adds to a counter, from any thread
+void profileCount(ProfileCounter counter, uint64_t amount);
+
+// Call once per frame on the main thread. Records the frame as a zone,
+// samples the counters into the trace and starts them over. Returns the
+// frame's length in seconds
+double profileFrame(void);
+
+// Last value profileFrame sampled for a counter
+uint64_t profileCounterValue(ProfileCounter counter);
+
+// Writes every track in Chrome's trace event format, which chrome://tracing
+// and Perfetto can open. Returns false if the file can't be written
+bool profileDump(const char *path);
+
+// Frees the tracks, nothing may record after this
+void profileShutdown(void);
+
+#endif
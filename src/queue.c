@@ -0,0 +1,80 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "queue.h"
+
+// Dmitry Vyukov's bounded MPMC queue. Each cell's sequence number says
+// whether it is ready to be written or read for the current lap
+
+void initAtomicQueue(AtomicQueue *queue, size_t capacity) {
+  size_t size = 2;
+  while (size < capacity) {
+    size *= 2;
+  }
+
+  queue->cells = malloc(size * sizeof(QueueCell));
+  queue->mask = size - 1;
+  for (size_t i = 0; i < size; i++) {
+    queue->cells[i].sequence = i;
+    queue->cells[i].data = NULL;
+  }
+
+  queue->pushPos = 0;
+  queue->popPos = 0;
+}
+
+void freeAtomicQueue(AtomicQueue *queue) {
+  free(queue->cells);
+  queue->cells = NULL;
+}
+
+bool atomicQueuePush(AtomicQueue *queue, void *data) {
+  size_t pos = __atomic_load_n(&queue->pushPos, __ATOMIC_RELAXED);
+  QueueCell *cell;
+
+  for (;;) {
+    cell = &queue->cells[pos & queue->mask];
+    size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+    intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&queue->pushPos, &pos, pos + 1, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = __atomic_load_n(&queue->pushPos, __ATOMIC_RELAXED);
+    }
+  }
+
+  cell->data = data;
+  __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool atomicQueuePop(AtomicQueue *queue, void **data) {
+  size_t pos = __atomic_load_n(&queue->popPos, __ATOMIC_RELAXED);
+  QueueCell *cell;
+
+  for (;;) {
+    cell = &queue->cells[pos & queue->mask];
+    size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+    intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&queue->popPos, &pos, pos + 1, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = __atomic_load_n(&queue->popPos, __ATOMIC_RELAXED);
+    }
+  }
+
+  *data = cell->data;
+  __atomic_store_n(&cell->sequence, pos + queue->mask + 1, __ATOMIC_RELEASE);
+  return true;
+}
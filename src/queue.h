@@ -0,0 +1,36 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Bounded lock-free queue of pointers, safe for any number of producers and
+// consumers. Neither push nor pop ever blocks
+typedef struct QueueCell {
+  size_t sequence;
+  void *data;
+} QueueCell;
+
+typedef struct AtomicQueue {
+  QueueCell *cells;
+  size_t mask;
+  // Kept on separate cache lines so producers and consumers don't contend
+  char padding0[64];
+  size_t pushPos;
+  char padding1[64];
+  size_t popPos;
+  char padding2[64];
+} AtomicQueue;
+
+// Capacity is rounded up to a power of two
+void initAtomicQueue(AtomicQueue *queue, size_t capacity);
+
+void freeAtomicQueue(AtomicQueue *queue);
+
+// Returns false if the queue is full
+bool atomicQueuePush(AtomicQueue *queue, void *data);
+
+// Returns false if the queue is empty
+bool atomicQueuePop(AtomicQueue *queue, void **data);
+
+#endif
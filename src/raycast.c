@@ -0,0 +1,190 @@
+#include <math.h>
+#include "profiler.h"
+#include "raycast.h"
+
+// Amanatides and Woo's traversal. Distances are along the normalised ray,
+// so they are in blocks
+typedef struct Traversal {
+  int pos[3];
+  int step[3];
+  float next[3];  // Distance to the next block boundary on each axis
+  float delta[3]; // Distance between block boundaries on each axis
+  float distance; // Where the ray came into pos
+  int axis;       // Axis of the boundary it came through, -1 at the start
+} Traversal;
+
+static bool startTraversal(Traversal *ray, const float origin[3],
+                           const float direction[3]) {
+  float length = sqrtf(direction[0] * direction[0] +
+                       direction[1] * direction[1] +
+                       direction[2] * direction[2]);
+  if (length == 0.0f) {
+    return false;
+  }
+
+  for (int i = 0; i < 3; i++) {
+    float d = direction[i] / length;
+    float start = floorf(origin[i]);
+    ray->pos[i] = (int)start;
+    ray->step[i] = d > 0.0f ? 1 : (d < 0.0f ? -1 : 0);
+    ray->delta[i] = d != 0.0f ? fabsf(1.0f / d) : INFINITY;
+    if (d > 0.0f) {
+      ray->next[i] = (start + 1.0f - origin[i]) / d;
+    } else if (d < 0.0f) {
+      ray->next[i] = (origin[i] - start) / -d;
+    } else {
+      ray->next[i] = INFINITY;
+    }
+  }
+  ray->distance = 0.0f;
+  ray->axis = -1;
+  return true;
+}
+
+static void stepTraversal(Traversal *ray) {
+  int axis = ray->next[0] < ray->next[1] ? 0 : 1;
+  axis = ray->next[2] < ray->next[axis] ? 2 : axis;
+
+  ray->distance = ray->next[axis];
+  ray->pos[axis] += ray->step[axis];
+  ray->next[axis] += ray->delta[axis];
+  ray->axis = axis;
+}
+
+// Moves straight to the first block past the aligned box of 1 << shift
+// blocks on a side that pos is in, as if stepping through it block by block
+static void leaveBox(Traversal *ray, int shift) {
+  int mask = (1 << shift) - 1;
+
+  // Boundaries left to cross on each axis before the edge of the box
+  int inside[3];
+  int exitAxis = 0;
+  float exitDistance = INFINITY;
+  for (int i = 0; i < 3; i++) {
+    int offset = ray->pos[i] & mask;
+    inside[i] = ray->step[i] > 0 ? mask - offset : offset;
+    float distance = ray->next[i] + inside[i] * ray->delta[i];
+    if (ray->step[i] != 0 && distance < exitDistance) {
+      exitDistance = distance;
+      exitAxis = i;
+    }
+  }
+
+  for (int i = 0; i < 3; i++) {
+    if (ray->step[i] == 0) {
+      continue;
+    }
+
+    // Other axes only go as far as the edge, so the ray always leaves
+    // through the exit face even if rounding puts it on a corner
+    int crossed = inside[i] + 1;
+    if (i != exitAxis) {
+      crossed = ray->next[i] <= exitDistance
+                    ? (int)((exitDistance - ray->next[i]) / ray->delta[i]) + 1
+                    : 0;
+      crossed = crossed < inside[i] ? crossed : inside[i];
+    }
+    ray->pos[i] += crossed * ray->step[i];
+    ray->next[i] += crossed * ray->delta[i];
+  }
+  ray->distance = exitDistance;
+  ray->axis = exitAxis;
+}
+
+static bool castRay(const World *world, const float origin[3],
+                    const float direction[3], float maxDistance,
+                    bool opaqueOnly, RayHit *hit) {
+  hit->hit = false;
+  Traversal ray;
+  if (!startTraversal(&ray, origin, direction)) {
+    return false;
+  }
+
+  // Consecutive blocks are nearly always in the same chunk
+  const Chunk *chunk = NULL;
+  int chunkPos[3] = {0, 0, 0};
+  bool looked = false;
+
+  while (ray.distance <= maxDistance) {
+    int cx = WORLD_TO_CHUNK(ray.pos[0]), cy = WORLD_TO_CHUNK(ray.pos[1]);
+    int cz = WORLD_TO_CHUNK(ray.pos[2]);
+    if (!looked || cx != chunkPos[0] || cy != chunkPos[1] ||
+        cz != chunkPos[2]) {
+      chunk = worldGetChunk(world, cx, cy, cz);
+      chunkPos[0] = cx;
+      chunkPos[1] = cy;
+      chunkPos[2] = cz;
+      looked = true;
+    }
+
+    // Missing chunks are air, and cells with nothing in them can't be hit
+    if (chunk == NULL || chunk->occupied == 0) {
+      leaveBox(&ray, CHUNK_SHIFT);
+      continue;
+    }
+
+    int x = WORLD_TO_LOCAL(ray.pos[0]), y = WORLD_TO_LOCAL(ray.pos[1]);
+    int z = WORLD_TO_LOCAL(ray.pos[2]);
+    if (((chunk->occupied >> CHUNK_CELL_INDEX(x, y, z)) & 1) == 0) {
+      leaveBox(&ray, CHUNK_CELL_SHIFT);
+      continue;
+    }
+
+    BlockId block = chunkGetBlock(chunk, x, y, z);
+    if (opaqueOnly ? blockIsOpaque(block) : block != BLOCK_AIR) {
+      hit->hit = true;
+      hit->x = ray.pos[0];
+      hit->y = ray.pos[1];
+      hit->z = ray.pos[2];
+      // Stepping along +axis goes in through the block's negative face
+      hit->face = ray.axis < 0 ? FACE_COUNT
+                               : (BlockFace)(ray.axis * 2 +
+                                             (ray.step[ray.axis] > 0 ? 1 : 0));
+      hit->distance = ray.distance;
+      hit->block = block;
+      return true;
+    }
+    stepTraversal(&ray);
+  }
+  return false;
+}
+
+bool raycast(const World *world, const float origin[3],
+             const float direction[3], float maxDistance, RayHit *hit) {
+  return castRay(world, origin, direction, maxDistance, false, hit);
+}
+
+bool lineOfSight(const World *world, const float from[3], const float to[3]) {
+  float direction[3] = {to[0] - from[0], to[1] - from[1], to[2] - from[2]};
+  float distance = sqrtf(direction[0] * direction[0] +
+                         direction[1] * direction[1] +
+                         direction[2] * direction[2]);
+  RayHit hit;
+  return !castRay(world, from, direction, distance, true, &hit) ||
+         hit.distance >= distance;
+}
+
+void raycastBatch(const World *world, const RayQuery *rays, size_t count,
+                  RayHit *hits) {
+  double start = profileBegin();
+  for (size_t i = 0; i < count; i++) {
+    castRay(world, rays[i].origin, rays[i].direction, rays[i].maxDistance,
+            false, &hits[i]);
+  }
+  profileEnd("raycast batch", start);
+}
+
+static void runRaycastJob(Job *job) {
+  RaycastJob *raycastJob = (RaycastJob *)job;
+  raycastBatch(raycastJob->world, raycastJob->rays, raycastJob->count,
+               raycastJob->hits);
+}
+
+void initRaycastJob(RaycastJob *job, const World *world,
+                    const RayQuery *rays, size_t count, RayHit *hits) {
+  job->job.run = runRaycastJob;
+  job->world = world;
+  job->rays = rays;
+  job->count = count;
+  job->hits = hits;
+}
@@ -0,0 +1,53 @@
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "block.h"
+#include "threadpool.h"
+#include "world.h"
+
+typedef struct RayHit {
+  bool hit;
+  int x, y, z; // Block that was hit
+  // Face the ray came in through, a block placed against the hit goes on
+  // the other side of it. FACE_COUNT when the ray started inside the block
+  BlockFace face;
+  float distance; // Along the ray to where it came into the block
+  BlockId block;
+} RayHit;
+
+typedef struct RayQuery {
+  float origin[3];
+  float direction[3]; // Doesn't have to be normalised
+  float maxDistance;
+} RayQuery;
+
+// Finds the first block that isn't air along the ray, walking one block at
+// a time and jumping over missing chunks and empty cells whole. Only reads
+// the world, so any number of threads can cast at once while it is left
+// unchanged
+bool raycast(const World *world, const float origin[3],
+             const float direction[3], float maxDistance, RayHit *hit);
+
+// True when no opaque block is in the way from one point to the other
+bool lineOfSight(const World *world, const float from[3], const float to[3]);
+
+// Casts every ray, filling in a hit for each
+void raycastBatch(const World *world, const RayQuery *rays, size_t count,
+                  RayHit *hits);
+
+// A batch of rays for a thread pool. The world must not change and the
+// rays and hits must stay around until the job comes back
+typedef struct RaycastJob {
+  Job job;
+  const World *world;
+  const RayQuery *rays;
+  RayHit *hits;
+  size_t count;
+} RaycastJob;
+
+void initRaycastJob(RaycastJob *job, const World *world,
+                    const RayQuery *rays, size_t count, RayHit *hits);
+
+#endif
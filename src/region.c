@@ -0,0 +1,944 @@
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#include <windows.h>
+#else
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profiler.h"
+#include "region.h"
+
+#define REGION_MAGIC 0x4752434du // "MCRG"
+#define REGION_VERSION 1
+
+// Two header copies, then chunk data
+#define REGION_HEADER_SECTORS (REGION_HEADER_SIZE / REGION_SECTOR)
+#define REGION_DATA_SECTOR (2 * REGION_HEADER_SECTORS)
+
+#define SECTORS(bytes) (((bytes) + REGION_SECTOR - 1) / REGION_SECTOR)
+
+// Written in front of every chunk. Values are stored in host byte order,
+// which is little endian everywhere we build
+typedef struct ChunkRecord {
+  int32_t x, y, z;
+  uint8_t compression;
+  uint8_t unused[3];
+  uint32_t rawSize;  // Palette encoded size
+  uint32_t dataSize; // Size after compression
+  uint32_t checksum; // Of the data
+} ChunkRecord;
+
+// Palette encoding, before compression:
+//   uint16 palette size, uint8 bits per block, uint8 unused
+//   BlockId palette[palette size], padded to 8 bytes
+//   uint64 indices, packed 64 / bits to a word
+// With 16 bits the palette is left out and indices are the blocks themselves
+#define RAW_CAPACITY (8 + CHUNK_VOLUME * sizeof(BlockId))
+#define MAX_PALETTE 256
+
+#define COMPRESSED_CAPACITY (RAW_CAPACITY + RAW_CAPACITY / 64 + 1024)
+
+// === Platform === //
+
+#ifdef _WIN32
+
+static int openFile(const char *path, bool truncate) {
+  return _open(path, _O_RDWR | _O_CREAT | _O_BINARY | (truncate ? _O_TRUNC : 0),
+               _S_IREAD | _S_IWRITE);
+}
+
+static void closeFile(int file) { _close(file); }
+
+static bool writeAt(int file, const void *data, size_t size, size_t offset) {
+  if (_lseeki64(file, (__int64)offset, SEEK_SET) < 0) {
+    return false;
+  }
+  return _write(file, data, (unsigned int)size) == (int)size;
+}
+
+static size_t fileSize(int file) {
+  __int64 size = _lseeki64(file, 0, SEEK_END);
+  return size < 0 ? 0 : (size_t)size;
+}
+
+static bool syncFile(int file) { return _commit(file) == 0; }
+
+static bool truncateFile(int file, size_t size) {
+  return _chsize_s(file, (__int64)size) == 0;
+}
+
+static const uint8_t *mapFile(int file, size_t size) {
+  HANDLE mapping = CreateFileMappingA((HANDLE)_get_osfhandle(file), NULL,
+                                      PAGE_READONLY, 0, 0, NULL);
+  if (mapping == NULL) {
+    return NULL;
+  }
+  const uint8_t *map = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+  CloseHandle(mapping);
+  return map;
+}
+
+static void unmapFile(const uint8_t *map, size_t size) {
+  UnmapViewOfFile(map);
+}
+
+static bool replaceFile(const char *from, const char *to) {
+  return MoveFileExA(from, to,
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+}
+
+static bool makeDirectory(const char *path) {
+  return _mkdir(path) == 0 || errno == EEXIST;
+}
+
+#else
+
+static int openFile(const char *path, bool truncate) {
+  return open(path, O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+}
+
+static void closeFile(int file) { close(file); }
+
+static bool writeAt(int file, const void *data, size_t size, size_t offset) {
+  const uint8_t *bytes = data;
+  while (size > 0) {
+    ssize_t written = pwrite(file, bytes, size, (off_t)offset);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    bytes += written;
+    offset += (size_t)written;
+    size -= (size_t)written;
+  }
+  return true;
+}
+
+static size_t fileSize(int file) {
+  struct stat info;
+  return fstat(file, &info) == 0 ? (size_t)info.st_size : 0;
+}
+
+static bool syncFile(int file) {
+#ifdef __APPLE__
+  return fsync(file) == 0;
+#else
+  return fdatasync(file) == 0;
+#endif
+}
+
+static bool truncateFile(int file, size_t size) {
+  return ftruncate(file, (off_t)size) == 0;
+}
+
+static const uint8_t *mapFile(int file, size_t size) {
+  void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, file, 0);
+  return map == MAP_FAILED ? NULL : map;
+}
+
+static void unmapFile(const uint8_t *map, size_t size) {
+  munmap((void *)map, size);
+}
+
+// The rename itself is only durable once the directory is synced
+static bool replaceFile(const char *from, const char *to) {
+  if (rename(from, to) != 0) {
+    return false;
+  }
+
+  char directory[1024];
+  snprintf(directory, sizeof(directory), "%s", to);
+  char *slash = strrchr(directory, '/');
+  if (slash != NULL) {
+    *slash = '\0';
+  } else {
+    snprintf(directory, sizeof(directory), ".");
+  }
+
+  int file = open(directory, O_RDONLY);
+  if (file >= 0) {
+    fsync(file);
+    close(file);
+  }
+  return true;
+}
+
+static bool makeDirectory(const char *path) {
+  return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+#endif
+
+// === Checksums === //
+
+// CRC-32 a nibble at a time, which keeps the table tiny
+static uint32_t crc32(const void *data, size_t size) {
+  static const uint32_t table[16] = {
+      0x00000000u, 0x1db71064u, 0x3b6e20c8u, 0x26d930acu,
+      0x76dc4190u, 0x6b6b51f4u, 0x4db26158u, 0x5005713cu,
+      0xedb88320u, 0xf00f9344u, 0xd6d6a3e8u, 0xcb61b38cu,
+      0x9b64c2b0u, 0x86d3d2d4u, 0xa00ae278u, 0xbdbdf21cu};
+
+  const uint8_t *bytes = data;
+  uint32_t crc = 0xffffffffu;
+  for (size_t i = 0; i < size; i++) {
+    crc ^= bytes[i];
+    crc = (crc >> 4) ^ table[crc & 15];
+    crc = (crc >> 4) ^ table[crc & 15];
+  }
+  return ~crc;
+}
+
+static uint32_t headerChecksum(const RegionHeader *header) {
+  RegionHeader copy = *header;
+  copy.checksum = 0;
+  return crc32(&copy, sizeof(copy));
+}
+
+// === Palette encoding === //
+
+static int paletteBits(int paletteSize) {
+  if (paletteSize <= 1) {
+    return 0;
+  }
+  if (paletteSize <= 2) {
+    return 1;
+  }
+  if (paletteSize <= 4) {
+    return 2;
+  }
+  if (paletteSize <= 16) {
+    return 4;
+  }
+  return paletteSize <= MAX_PALETTE ? 8 : 16;
+}
+
+static size_t encodeChunk(const Chunk *chunk, uint8_t *out) {
+  BlockId blocks[CHUNK_VOLUME];
+  chunkGetBlocks(chunk, blocks);
+
+  BlockId palette[MAX_PALETTE];
+  uint8_t indices[CHUNK_VOLUME];
+  int paletteSize = 0;
+
+  // Terrain is mostly runs of the same block, so check the last one first
+  int last = -1;
+  for (int i = 0; i < CHUNK_VOLUME && paletteSize <= MAX_PALETTE; i++) {
+    BlockId block = blocks[i];
+    if (last >= 0 && palette[last] == block) {
+      indices[i] = (uint8_t)last;
+      continue;
+    }
+
+    int index = 0;
+    while (index < paletteSize && palette[index] != block) {
+      index++;
+    }
+    if (index == paletteSize) {
+      if (paletteSize == MAX_PALETTE) {
+        paletteSize++;
+        break;
+      }
+      palette[paletteSize++] = block;
+    }
+    indices[i] = (uint8_t)index;
+    last = index;
+  }
+
+  int bits = paletteBits(paletteSize);
+  out[0] = (uint8_t)(bits == 16 ? 0 : paletteSize);
+  out[1] = (uint8_t)((bits == 16 ? 0 : paletteSize) >> 8);
+  out[2] = (uint8_t)bits;
+  out[3] = 0;
+
+  if (bits == 16) {
+    memcpy(out + 4, blocks, sizeof(blocks));
+    return 4 + sizeof(blocks);
+  }
+
+  size_t size = 4 + paletteSize * sizeof(BlockId);
+  memcpy(out + 4, palette, paletteSize * sizeof(BlockId));
+  size = (size + 7) & ~(size_t)7;
+  if (bits == 0) {
+    return size;
+  }
+
+  int perWord = 64 / bits;
+  size_t wordCount = CHUNK_VOLUME / perWord;
+  for (size_t w = 0; w < wordCount; w++) {
+    uint64_t word = 0;
+    const uint8_t *source = &indices[w * perWord];
+    for (int i = 0; i < perWord; i++) {
+      word |= (uint64_t)source[i] << (i * bits);
+    }
+    memcpy(out + size + w * sizeof(word), &word, sizeof(word));
+  }
+  return size + wordCount * sizeof(uint64_t);
+}
+
+static bool decodeChunk(const uint8_t *data, size_t size, Chunk *chunk) {
+  if (size < 4) {
+    return false;
+  }
+
+  int paletteSize = data[0] | (data[1] << 8);
+  int bits = data[2];
+
+  if (bits == 16) {
+    BlockId blocks[CHUNK_VOLUME];
+    if (size != 4 + sizeof(blocks)) {
+      return false;
+    }
+    memcpy(blocks, data + 4, sizeof(blocks));
+    chunkSetBlocks(chunk, blocks);
+    return true;
+  }
+
+  if (paletteSize == 0 || paletteSize > MAX_PALETTE ||
+      bits != paletteBits(paletteSize)) {
+    return false;
+  }
+
+  // The size has to match before anything is read, or the chunk touched
+  size_t offset = (4 + paletteSize * sizeof(BlockId) + 7) & ~(size_t)7;
+  int perWord = bits > 0 ? 64 / bits : 0;
+  size_t wordCount = bits > 0 ? CHUNK_VOLUME / perWord : 0;
+  if (size != offset + wordCount * sizeof(uint64_t)) {
+    return false;
+  }
+
+  BlockId palette[MAX_PALETTE];
+  memcpy(palette, data + 4, paletteSize * sizeof(BlockId));
+  if (bits == 0) {
+    chunkFill(chunk, palette[0]);
+    return true;
+  }
+
+  // Chunks pack their blocks the same way, so the words go straight in once
+  // every index is known to be in the palette
+  uint64_t words[CHUNK_VOLUME / 64 * 8];
+  memcpy(words, data + offset, wordCount * sizeof(uint64_t));
+  uint64_t mask = (1u << bits) - 1;
+  for (size_t w = 0; w < wordCount && paletteSize <= (int)mask; w++) {
+    for (int i = 0; i < perWord; i++) {
+      if ((int)((words[w] >> (i * bits)) & mask) >= paletteSize) {
+        return false;
+      }
+    }
+  }
+  chunkSetPacked(chunk, palette, paletteSize, words);
+  return true;
+}
+
+// === Compression === //
+
+bool regionCompressionSupported(RegionCompression compression) {
+  switch (compression) {
+  case REGION_COMPRESS_NONE:
+    return true;
+#ifdef HAVE_LZ4
+  case REGION_COMPRESS_LZ4:
+    return true;
+#endif
+#ifdef HAVE_ZSTD
+  case REGION_COMPRESS_ZSTD:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+const char *regionCompressionName(RegionCompression compression) {
+  static const char *names[REGION_COMPRESS_COUNT] = {"none", "lz4", "zstd"};
+  return compression < REGION_COMPRESS_COUNT ? names[compression] : "unknown";
+}
+
+// Returns 0 when the data can't be compressed this way
+static size_t compressData(RegionCompression compression, const uint8_t *in,
+                           size_t size, uint8_t *out, size_t capacity) {
+  switch (compression) {
+#ifdef HAVE_LZ4
+  case REGION_COMPRESS_LZ4: {
+    int written = LZ4_compress_default((const char *)in, (char *)out,
+                                       (int)size, (int)capacity);
+    return written > 0 ? (size_t)written : 0;
+  }
+#endif
+#ifdef HAVE_ZSTD
+  case REGION_COMPRESS_ZSTD: {
+    // Low levels are several times faster and barely any bigger on chunks
+    size_t written = ZSTD_compress(out, capacity, in, size, 1);
+    return ZSTD_isError(written) ? 0 : written;
+  }
+#endif
+  default:
+    return 0;
+  }
+}
+
+static bool decompressData(RegionCompression compression, const uint8_t *in,
+                           size_t size, uint8_t *out, size_t rawSize) {
+  switch (compression) {
+  case REGION_COMPRESS_NONE:
+    if (size != rawSize) {
+      return false;
+    }
+    memcpy(out, in, size);
+    return true;
+#ifdef HAVE_LZ4
+  case REGION_COMPRESS_LZ4:
+    return LZ4_decompress_safe((const char *)in, (char *)out, (int)size,
+                               (int)rawSize) == (int)rawSize;
+#endif
+#ifdef HAVE_ZSTD
+  case REGION_COMPRESS_ZSTD:
+    return ZSTD_decompress(out, rawSize, in, size) == rawSize;
+#endif
+  default:
+    return false;
+  }
+}
+
+// === Region files === //
+
+static int chunkSlot(int cx, int cy, int cz) {
+  return (cx & REGION_MASK) + ((cz & REGION_MASK) << REGION_SHIFT) +
+         ((cy & REGION_MASK) << (2 * REGION_SHIFT));
+}
+
+static bool inRegion(const Region *region, int cx, int cy, int cz) {
+  return cx >> REGION_SHIFT == region->x && cy >> REGION_SHIFT == region->y &&
+         cz >> REGION_SHIFT == region->z;
+}
+
+// Makes sure the map covers the first end bytes of the file
+static bool mapRegion(Region *region, size_t end) {
+  if (end <= region->mapSize) {
+    return true;
+  }
+  if (region->file < 0) {
+    return false;
+  }
+
+  if (region->map != NULL) {
+    unmapFile(region->map, region->mapSize);
+    region->map = NULL;
+    region->mapSize = 0;
+  }
+
+  size_t size = (size_t)region->sectorCount * REGION_SECTOR;
+  if (end > size) {
+    return false;
+  }
+
+  region->map = mapFile(region->file, size);
+  if (region->map == NULL) {
+    return false;
+  }
+  region->mapSize = size;
+  return true;
+}
+
+static bool validHeader(const RegionHeader *header, size_t fileSectors) {
+  if (header->magic != REGION_MAGIC || header->version != REGION_VERSION ||
+      header->checksum != headerChecksum(header) ||
+      header->sectorCount < REGION_DATA_SECTOR ||
+      header->sectorCount > fileSectors) {
+    return false;
+  }
+
+  for (int i = 0; i < REGION_CHUNKS; i++) {
+    const RegionEntry *entry = &header->entries[i];
+    if (entry->size > 0 &&
+        (entry->sector < REGION_DATA_SECTOR ||
+         entry->sector + SECTORS(entry->size) > header->sectorCount)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool writeHeader(int file, int slot, const RegionHeader *header) {
+  uint8_t sectors[REGION_HEADER_SIZE] = {0};
+  memcpy(sectors, header, sizeof(*header));
+  return writeAt(file, sectors, sizeof(sectors),
+                 (size_t)slot * REGION_HEADER_SIZE);
+}
+
+static void fillHeader(const Region *region, uint64_t generation,
+                       RegionHeader *header) {
+  memset(header, 0, sizeof(*header));
+  header->magic = REGION_MAGIC;
+  header->version = REGION_VERSION;
+  header->generation = generation;
+  header->sectorCount = region->sectorCount;
+  memcpy(header->entries, region->entries, sizeof(region->entries));
+  header->checksum = headerChecksum(header);
+}
+
+// Starts an empty file with a single valid header
+static bool createRegionFile(Region *region) {
+  region->sectorCount = REGION_DATA_SECTOR;
+  region->generation = 1;
+  region->headerSlot = 0;
+  memset(region->entries, 0, sizeof(region->entries));
+
+  RegionHeader header;
+  fillHeader(region, region->generation, &header);
+
+  static const uint8_t empty[REGION_HEADER_SIZE];
+  return truncateFile(region->file, 0) &&
+         writeHeader(region->file, 0, &header) &&
+         writeAt(region->file, empty, sizeof(empty), sizeof(empty)) &&
+         syncFile(region->file);
+}
+
+static bool readRegionFile(Region *region, size_t size) {
+  region->sectorCount = (uint32_t)(size / REGION_SECTOR);
+  if (!mapRegion(region, REGION_DATA_SECTOR * REGION_SECTOR)) {
+    return false;
+  }
+
+  const RegionHeader *newest = NULL;
+  for (int slot = 0; slot < 2; slot++) {
+    const RegionHeader *header =
+        (const RegionHeader *)(region->map +
+                               slot * REGION_HEADER_SIZE);
+    if (validHeader(header, region->sectorCount) &&
+        (newest == NULL || header->generation > newest->generation)) {
+      newest = header;
+      region->headerSlot = slot;
+    }
+  }
+
+  if (newest == NULL) {
+    return false;
+  }
+
+  memcpy(region->entries, newest->entries, sizeof(region->entries));
+  region->generation = newest->generation;
+
+  // Anything past the end of the header is from a save that never finished
+  uint32_t sectorCount = newest->sectorCount;
+  if (sectorCount < region->sectorCount) {
+    unmapFile(region->map, region->mapSize);
+    region->map = NULL;
+    region->mapSize = 0;
+    if (!truncateFile(region->file, (size_t)sectorCount * REGION_SECTOR)) {
+      return false;
+    }
+  }
+  region->sectorCount = sectorCount;
+  return true;
+}
+
+Region *openRegion(const char *path, int rx, int ry, int rz) {
+  Region *region = calloc(1, sizeof(Region));
+  region->x = rx;
+  region->y = ry;
+  region->z = rz;
+  region->path = malloc(strlen(path) + 1);
+  strcpy(region->path, path);
+
+  region->file = openFile(path, false);
+  if (region->file < 0) {
+    printf("Failed to open region %s\n", path);
+    free(region->path);
+    free(region);
+    return NULL;
+  }
+
+  // A file too short for both headers never finished being created
+  size_t size = fileSize(region->file);
+  bool ok = size < REGION_DATA_SECTOR * REGION_SECTOR
+                ? createRegionFile(region)
+                : readRegionFile(region, size);
+  if (!ok) {
+    printf("Region %s is corrupt\n", path);
+    if (region->map != NULL) {
+      unmapFile(region->map, region->mapSize);
+    }
+    closeFile(region->file);
+    free(region->path);
+    free(region);
+    return NULL;
+  }
+
+  for (int i = 0; i < REGION_CHUNKS; i++) {
+    region->liveSectors += SECTORS(region->entries[i].size);
+  }
+  return region;
+}
+
+void closeRegion(Region *region) {
+  // Compacting also writes out anything unsaved
+  size_t deadSectors =
+      region->sectorCount - REGION_DATA_SECTOR - region->liveSectors;
+  if (deadSectors > region->liveSectors && deadSectors > SECTORS(1 << 20)) {
+    regionCompact(region);
+  }
+  regionFlush(region);
+
+  if (region->map != NULL) {
+    unmapFile(region->map, region->mapSize);
+  }
+  if (region->file >= 0) {
+    closeFile(region->file);
+  }
+  free(region->path);
+  free(region);
+}
+
+bool regionHasChunk(const Region *region, int cx, int cy, int cz) {
+  return inRegion(region, cx, cy, cz) &&
+         region->entries[chunkSlot(cx, cy, cz)].size > 0;
+}
+
+uint8_t *regionReadChunk(Region *region, int cx, int cy, int cz,
+                         size_t *size) {
+  if (!regionHasChunk(region, cx, cy, cz)) {
+    return NULL;
+  }
+
+  double zoneStart = profileBegin();
+  const RegionEntry *entry = &region->entries[chunkSlot(cx, cy, cz)];
+  size_t offset = (size_t)entry->sector * REGION_SECTOR;
+  if (!mapRegion(region, offset + entry->size)) {
+    printf("Chunk %d %d %d in %s is past the end of the file\n", cx, cy, cz,
+           region->path);
+    profileEnd("read chunk", zoneStart);
+    return NULL;
+  }
+
+  // Copied straight out of the page cache
+  uint8_t *data = malloc(entry->size);
+  memcpy(data, region->map + offset, entry->size);
+  *size = entry->size;
+  profileEnd("read chunk", zoneStart);
+  return data;
+}
+
+Chunk *regionDecodeChunk(int cx, int cy, int cz, const uint8_t *data,
+                         size_t size) {
+  double zoneStart = profileBegin();
+  ChunkRecord record;
+  if (size >= sizeof(record)) {
+    memcpy(&record, data, sizeof(record));
+    data += sizeof(record);
+  }
+
+  Chunk *chunk = NULL;
+  uint64_t raw[RAW_CAPACITY / sizeof(uint64_t) + 1];
+  if (size >= sizeof(record) && record.x == cx && record.y == cy &&
+      record.z == cz && record.dataSize <= size - sizeof(record) &&
+      record.rawSize <= RAW_CAPACITY &&
+      record.checksum == crc32(data, record.dataSize) &&
+      decompressData(record.compression, data, record.dataSize,
+                     (uint8_t *)raw, record.rawSize)) {
+    chunk = createChunk(cx, cy, cz);
+    if (!decodeChunk((const uint8_t *)raw, record.rawSize, chunk)) {
+      destroyChunk(chunk);
+      chunk = NULL;
+    } else {
+      chunk->modified = false;
+    }
+  }
+
+  if (chunk == NULL) {
+    printf("Chunk %d %d %d is corrupt\n", cx, cy, cz);
+  }
+  profileEnd("decode chunk", zoneStart);
+  return chunk;
+}
+
+Chunk *regionLoadChunk(Region *region, int cx, int cy, int cz) {
+  size_t size;
+  uint8_t *data = regionReadChunk(region, cx, cy, cz, &size);
+  if (data == NULL) {
+    return NULL;
+  }
+  Chunk *chunk = regionDecodeChunk(cx, cy, cz, data, size);
+  free(data);
+  return chunk;
+}
+
+bool regionSaveChunk(Region *region, const Chunk *chunk,
+                     RegionCompression compression) {
+  if (region->file < 0 || !inRegion(region, chunk->x, chunk->y, chunk->z)) {
+    return false;
+  }
+
+  double zoneStart = profileBegin();
+  uint64_t raw[RAW_CAPACITY / sizeof(uint64_t) + 1];
+  size_t rawSize = encodeChunk(chunk, (uint8_t *)raw);
+
+  // Whole sectors are written, so the tail of the last one is zeroed
+  uint8_t buffer[SECTORS(sizeof(ChunkRecord) + COMPRESSED_CAPACITY) *
+                 REGION_SECTOR];
+  uint8_t *data = buffer + sizeof(ChunkRecord);
+  size_t dataSize = compressData(compression, (const uint8_t *)raw, rawSize,
+                                 data, COMPRESSED_CAPACITY);
+  if (dataSize == 0 || dataSize >= rawSize) {
+    compression = REGION_COMPRESS_NONE;
+    dataSize = rawSize;
+    memcpy(data, raw, rawSize);
+  }
+
+  ChunkRecord record = {0};
+  record.x = chunk->x;
+  record.y = chunk->y;
+  record.z = chunk->z;
+  record.compression = (uint8_t)compression;
+  record.rawSize = (uint32_t)rawSize;
+  record.dataSize = (uint32_t)dataSize;
+  record.checksum = crc32(data, dataSize);
+  memcpy(buffer, &record, sizeof(record));
+
+  size_t size = sizeof(record) + dataSize;
+  size_t sectors = SECTORS(size);
+  memset(buffer + size, 0, sectors * REGION_SECTOR - size);
+
+  // Never overwrite anything, the header on disk may still refer to it
+  if (!writeAt(region->file, buffer, sectors * REGION_SECTOR,
+               (size_t)region->sectorCount * REGION_SECTOR)) {
+    profileEnd("save chunk", zoneStart);
+    return false;
+  }
+
+  RegionEntry *entry = &region->entries[chunkSlot(chunk->x, chunk->y,
+                                                  chunk->z)];
+  region->liveSectors -= SECTORS(entry->size);
+  region->liveSectors += (uint32_t)sectors;
+  entry->sector = region->sectorCount;
+  entry->size = (uint32_t)size;
+  region->sectorCount += (uint32_t)sectors;
+  region->dirty = true;
+
+  profileEnd("save chunk", zoneStart);
+  return true;
+}
+
+bool regionFlush(Region *region) {
+  if (!region->dirty) {
+    return true;
+  }
+  if (region->file < 0) {
+    return false;
+  }
+
+  // The data has to be on disk before a header that points at it
+  if (!syncFile(region->file)) {
+    return false;
+  }
+
+  RegionHeader header;
+  int slot = 1 - region->headerSlot;
+  fillHeader(region, region->generation + 1, &header);
+  if (!writeHeader(region->file, slot, &header) ||
+      !syncFile(region->file)) {
+    return false;
+  }
+
+  region->generation++;
+  region->headerSlot = slot;
+  region->dirty = false;
+  return true;
+}
+
+bool regionCompact(Region *region) {
+  if (!mapRegion(region, (size_t)region->sectorCount * REGION_SECTOR)) {
+    return false;
+  }
+
+  char path[1024];
+  snprintf(path, sizeof(path), "%s.tmp", region->path);
+  int file = openFile(path, true);
+  if (file < 0) {
+    return false;
+  }
+
+  // Chunks are copied in file order, so the result is laid out the same
+  RegionEntry entries[REGION_CHUNKS];
+  uint32_t sector = REGION_DATA_SECTOR;
+  bool ok = true;
+  for (int i = 0; i < REGION_CHUNKS && ok; i++) {
+    entries[i] = region->entries[i];
+    if (entries[i].size == 0) {
+      continue;
+    }
+
+    uint32_t sectors = SECTORS(entries[i].size);
+    ok = writeAt(file, region->map + (size_t)entries[i].sector * REGION_SECTOR,
+                 (size_t)sectors * REGION_SECTOR,
+                 (size_t)sector * REGION_SECTOR);
+    entries[i].sector = sector;
+    sector += sectors;
+  }
+
+  Region compacted = *region;
+  memcpy(compacted.entries, entries, sizeof(entries));
+  compacted.sectorCount = sector;
+
+  RegionHeader header;
+  fillHeader(&compacted, region->generation + 1, &header);
+  static const uint8_t empty[REGION_HEADER_SIZE];
+  ok = ok && writeHeader(file, 0, &header) &&
+       writeAt(file, empty, sizeof(empty), sizeof(empty)) && syncFile(file);
+  closeFile(file);
+
+  if (!ok) {
+    remove(path);
+    return false;
+  }
+
+  // Windows can't replace a file that is still open. If the rename fails
+  // the old file opens again unchanged, and if neither opens the region is
+  // left without one, refusing to read or write anything more
+  unmapFile(region->map, region->mapSize);
+  region->map = NULL;
+  region->mapSize = 0;
+  closeFile(region->file);
+
+  ok = replaceFile(path, region->path);
+  region->file = openFile(region->path, false);
+  if (region->file < 0) {
+    printf("Region %s could not be opened again after compacting\n",
+           region->path);
+    return false;
+  }
+  if (!ok) {
+    remove(path);
+    return false;
+  }
+
+  memcpy(region->entries, entries, sizeof(entries));
+  region->sectorCount = sector;
+  region->generation++;
+  region->headerSlot = 0;
+  region->dirty = false;
+  return true;
+}
+
+size_t regionLiveBytes(const Region *region) {
+  return (size_t)region->liveSectors * REGION_SECTOR;
+}
+
+size_t regionFileBytes(const Region *region) {
+  return (size_t)region->sectorCount * REGION_SECTOR;
+}
+
+// === Region cache === //
+
+RegionCache *createRegionCache(const char *directory,
+                               RegionCompression compression) {
+  if (!makeDirectory(directory)) {
+    printf("Failed to create %s\n", directory);
+    return NULL;
+  }
+
+  RegionCache *cache = calloc(1, sizeof(RegionCache));
+  cache->directory = malloc(strlen(directory) + 1);
+  strcpy(cache->directory, directory);
+  cache->compression = regionCompressionSupported(compression)
+                           ? compression
+                           : REGION_COMPRESS_NONE;
+  return cache;
+}
+
+void destroyRegionCache(RegionCache *cache) {
+  for (int i = 0; i < cache->regionCount; i++) {
+    closeRegion(cache->regions[i]);
+  }
+  free(cache->directory);
+  free(cache);
+}
+
+// Finds the region holding a chunk, opening it if needed. Without create,
+// regions that don't exist yet aren't made
+static Region *cacheRegion(RegionCache *cache, int cx, int cy, int cz,
+                           bool create) {
+  int rx = cx >> REGION_SHIFT, ry = cy >> REGION_SHIFT, rz = cz >> REGION_SHIFT;
+
+  for (int i = 0; i < cache->regionCount; i++) {
+    Region *region = cache->regions[i];
+    if (region->x == rx && region->y == ry && region->z == rz) {
+      memmove(&cache->regions[1], &cache->regions[0], i * sizeof(Region *));
+      cache->regions[0] = region;
+      return region;
+    }
+  }
+
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/r.%d.%d.%d.bin", cache->directory, rx, ry,
+           rz);
+  if (!create) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+      return NULL;
+    }
+    fclose(file);
+  }
+
+  Region *region = openRegion(path, rx, ry, rz);
+  if (region == NULL) {
+    return NULL;
+  }
+
+  if (cache->regionCount == REGION_CACHE_SIZE) {
+    closeRegion(cache->regions[--cache->regionCount]);
+  }
+  memmove(&cache->regions[1], &cache->regions[0],
+          cache->regionCount * sizeof(Region *));
+  cache->regions[0] = region;
+  cache->regionCount++;
+  return region;
+}
+
+bool regionCacheHasChunk(RegionCache *cache, int cx, int cy, int cz) {
+  Region *region = cacheRegion(cache, cx, cy, cz, false);
+  return region != NULL && regionHasChunk(region, cx, cy, cz);
+}
+
+Chunk *regionCacheLoad(RegionCache *cache, int cx, int cy, int cz) {
+  Region *region = cacheRegion(cache, cx, cy, cz, false);
+  return region != NULL ? regionLoadChunk(region, cx, cy, cz) : NULL;
+}
+
+uint8_t *regionCacheRead(RegionCache *cache, int cx, int cy, int cz,
+                         size_t *size) {
+  Region *region = cacheRegion(cache, cx, cy, cz, false);
+  return region != NULL ? regionReadChunk(region, cx, cy, cz, size) : NULL;
+}
+
+bool regionCacheSave(RegionCache *cache, const Chunk *chunk) {
+  Region *region = cacheRegion(cache, chunk->x, chunk->y, chunk->z, true);
+  return region != NULL && regionSaveChunk(region, chunk, cache->compression);
+}
+
+bool regionCacheFlush(RegionCache *cache) {
+  bool ok = true;
+  for (int i = 0; i < cache->regionCount; i++) {
+    ok = regionFlush(cache->regions[i]) && ok;
+  }
+  return ok;
+}
@@ -0,0 +1,137 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "chunk.h"
+
+// Each region file holds an 8x8x8 cube of chunks
+#define REGION_SHIFT 3
+#define REGION_SIZE (1 << REGION_SHIFT)
+#define REGION_MASK (REGION_SIZE - 1)
+#define REGION_CHUNKS (REGION_SIZE * REGION_SIZE * REGION_SIZE)
+
+// Chunk data starts on a sector boundary. They are small since most chunks
+// palette encode and compress down to a few hundred bytes
+#define REGION_SECTOR 512
+
+// Bytes taken by each of the two header copies at the start of the file
+#define REGION_HEADER_SIZE 8192
+
+// Regions kept open by a RegionCache before the least recently used closes
+#define REGION_CACHE_SIZE 16
+
+typedef enum RegionCompression {
+  REGION_COMPRESS_NONE = 0, // Palette encoding only
+  REGION_COMPRESS_LZ4,
+  REGION_COMPRESS_ZSTD,
+  REGION_COMPRESS_COUNT
+} RegionCompression;
+
+// Where a chunk lives in the file. A size of 0 means it was never saved
+typedef struct RegionEntry {
+  uint32_t sector;
+  uint32_t size;
+} RegionEntry;
+
+// The file starts with two copies of this, REGION_HEADER_SIZE apart. Saving
+// only ever appends chunk data, then writes the header into whichever copy
+// is older. A crash part way through leaves the other copy intact, and
+// opening picks the newest copy whose checksum matches
+typedef struct RegionHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t generation;
+  uint32_t checksum; // Of the whole header with this field zeroed
+  uint32_t sectorCount; // End of the data this header refers to
+  RegionEntry entries[REGION_CHUNKS];
+} RegionHeader;
+
+typedef struct Region {
+  char *path;
+  int file; // -1 once compacting lost the file, then nothing more is saved
+  int x, y, z; // Region coordinates (chunk coordinates / REGION_SIZE)
+
+  // Read only view of the file, remapped when reads go past its end
+  const uint8_t *map;
+  size_t mapSize;
+
+  // Entries include chunks saved since the last flush
+  RegionEntry entries[REGION_CHUNKS];
+  uint64_t generation;
+  int headerSlot; // Copy holding the newest header on disk
+  uint32_t sectorCount;
+  uint32_t liveSectors;
+  bool dirty;
+} Region;
+
+// Opens the region file at path, creating it if it doesn't exist. Returns
+// NULL if it can't be opened or neither header copy is valid
+Region *openRegion(const char *path, int rx, int ry, int rz);
+
+// Flushes anything unsaved, and compacts the file first if most of it is
+// data that was overwritten since
+void closeRegion(Region *region);
+
+bool regionHasChunk(const Region *region, int cx, int cy, int cz);
+
+// Returns NULL when the chunk was never saved or fails its checksum
+Chunk *regionLoadChunk(Region *region, int cx, int cy, int cz);
+
+// regionLoadChunk in two steps. Reading only copies the chunk's bytes out
+// of the file, so it is all that needs to hold a lock shared with saves.
+// The copy is freed by the caller once decoded, which checks the checksum
+// and needs nothing from the region
+uint8_t *regionReadChunk(Region *region, int cx, int cy, int cz,
+                         size_t *size);
+Chunk *regionDecodeChunk(int cx, int cy, int cz, const uint8_t *data,
+                         size_t size);
+
+// Appends the chunk to the file. It isn't durable until regionFlush
+bool regionSaveChunk(Region *region, const Chunk *chunk,
+                     RegionCompression compression);
+
+// Syncs the appended data, then swaps in a header that refers to it
+bool regionFlush(Region *region);
+
+// Rewrites the file with only live chunks and atomically replaces it
+bool regionCompact(Region *region);
+
+// Bytes of the file taken by chunks that are still referenced
+size_t regionLiveBytes(const Region *region);
+size_t regionFileBytes(const Region *region);
+
+// False when the build doesn't include the library for it
+bool regionCompressionSupported(RegionCompression compression);
+
+const char *regionCompressionName(RegionCompression compression);
+
+// A directory of region files, opened as chunks in them are used
+typedef struct RegionCache {
+  char *directory;
+  RegionCompression compression;
+  Region *regions[REGION_CACHE_SIZE]; // Most recently used first
+  int regionCount;
+} RegionCache;
+
+// Creates the directory if it doesn't exist
+RegionCache *createRegionCache(const char *directory,
+                               RegionCompression compression);
+
+// Flushes and closes every region
+void destroyRegionCache(RegionCache *cache);
+
+bool regionCacheHasChunk(RegionCache *cache, int cx, int cy, int cz);
+
+Chunk *regionCacheLoad(RegionCache *cache, int cx, int cy, int cz);
+
+// Decode with regionDecodeChunk, see regionReadChunk
+uint8_t *regionCacheRead(RegionCache *cache, int cx, int cy, int cz,
+                         size_t *size);
+
+bool regionCacheSave(RegionCache *cache, const Chunk *chunk);
+
+bool regionCacheFlush(RegionCache *cache);
+
+#endif
@@ -0,0 +1,312 @@
+#include <stdlib.h>
+#include <string.h>
+#include <glad/glad.h>
+#include "profiler.h"
+#include "renderer.h"
+
+// Vertex attribute locations, see vertex.vs
+#define ATTRIB_VERTEX 0
+#define ATTRIB_ORIGIN 1
+
+void initChunkRenderer(ChunkRenderer *renderer, size_t bufferSize) {
+  memset(renderer, 0, sizeof(*renderer));
+  initGpuArena(&renderer->arena, bufferSize);
+  initChunkBounds(&renderer->bounds);
+
+  // Needs base instance for the origins as well as indirect draws
+  renderer->indirect = GLAD_GL_VERSION_4_3;
+
+  glGenBuffers(1, &renderer->originBuffer);
+  glGenBuffers(1, &renderer->commandBuffer);
+}
+
+void freeChunkRenderer(ChunkRenderer *renderer) {
+  glDeleteVertexArrays(renderer->VAOCount, renderer->VAOs);
+  glDeleteBuffers(1, &renderer->originBuffer);
+  glDeleteBuffers(1, &renderer->commandBuffer);
+  freeGpuArena(&renderer->arena);
+
+  free(renderer->draws);
+  free(renderer->slots);
+  free(renderer->freeIds);
+  free(renderer->visible);
+  free(renderer->commands);
+  free(renderer->origins);
+  freeChunkBounds(&renderer->bounds);
+}
+
+// Points each buffer's VAO at it again after the arena adds or replaces one
+static void syncVertexArrays(ChunkRenderer *renderer) {
+  const GpuArena *arena = &renderer->arena;
+
+  for (int b = 0; b < arena->bufferCount; b++) {
+    if (b == renderer->VAOCount) {
+      glGenVertexArrays(1, &renderer->VAOs[b]);
+      renderer->VAOCount++;
+    }
+
+    unsigned int buffer = arena->buffers[b].buffer;
+    if (renderer->VAOBuffers[b] == buffer) {
+      continue;
+    }
+    renderer->VAOBuffers[b] = buffer;
+
+    glBindVertexArray(renderer->VAOs[b]);
+
+    // Vertices and indices both come out of the same buffer
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+    glVertexAttribIPointer(ATTRIB_VERTEX, 2, GL_UNSIGNED_INT,
+                           sizeof(PackedVertex), (void *)0);
+    glEnableVertexAttribArray(ATTRIB_VERTEX);
+
+    // One origin per draw, picked by the draw's base instance
+    if (renderer->indirect) {
+      glBindBuffer(GL_ARRAY_BUFFER, renderer->originBuffer);
+      glVertexAttribPointer(ATTRIB_ORIGIN, 3, GL_FLOAT, GL_FALSE,
+                            3 * sizeof(float), (void *)0);
+      glVertexAttribDivisor(ATTRIB_ORIGIN, 1);
+      glEnableVertexAttribArray(ATTRIB_ORIGIN);
+    }
+
+    glBindVertexArray(0);
+  }
+}
+
+static size_t meshSize(const Mesh *mesh) {
+  return mesh->vertexCount * sizeof(PackedVertex) +
+         mesh->indexCount * sizeof(uint32_t);
+}
+
+static GpuHandle allocMesh(ChunkRenderer *renderer, size_t size) {
+  GpuHandle allocation = gpuArenaAlloc(&renderer->arena, size);
+
+  // The space might be there, just not in one piece
+  if (allocation == GPU_HANDLE_NONE && gpuArenaCompact(&renderer->arena)) {
+    allocation = gpuArenaAlloc(&renderer->arena, size);
+  }
+
+  syncVertexArrays(renderer);
+  return allocation;
+}
+
+static void writeMesh(ChunkRenderer *renderer, ChunkDraw *draw,
+                      const Mesh *mesh) {
+  size_t vertexBytes = mesh->vertexCount * sizeof(PackedVertex);
+  gpuArenaUpload(&renderer->arena, draw->allocation, 0, vertexBytes,
+                 mesh->vertices);
+  gpuArenaUpload(&renderer->arena, draw->allocation, vertexBytes,
+                 mesh->indexCount * sizeof(uint32_t), mesh->indices);
+
+  draw->vertexCount = (uint32_t)mesh->vertexCount;
+  draw->indexCount = (uint32_t)mesh->indexCount;
+}
+
+static ChunkDrawId newDrawId(ChunkRenderer *renderer) {
+  if (renderer->freeIdCount > 0) {
+    return renderer->freeIds[--renderer->freeIdCount];
+  }
+
+  if (renderer->slotCount == renderer->slotCapacity) {
+    renderer->slotCapacity =
+        renderer->slotCapacity ? renderer->slotCapacity * 2 : 256;
+    renderer->slots =
+        realloc(renderer->slots, renderer->slotCapacity * sizeof(uint32_t));
+    renderer->freeIds = realloc(renderer->freeIds,
+                                renderer->slotCapacity * sizeof(ChunkDrawId));
+  }
+
+  return (ChunkDrawId)renderer->slotCount++;
+}
+
+ChunkDrawId chunkRendererAdd(ChunkRenderer *renderer, int cx, int cy, int cz,
+                             const Mesh *mesh) {
+  GpuHandle allocation = allocMesh(renderer, meshSize(mesh));
+  if (allocation == GPU_HANDLE_NONE) {
+    return CHUNK_DRAW_NONE;
+  }
+
+  if (renderer->drawCount == renderer->drawCapacity) {
+    renderer->drawCapacity =
+        renderer->drawCapacity ? renderer->drawCapacity * 2 : 256;
+    renderer->draws = realloc(renderer->draws,
+                              renderer->drawCapacity * sizeof(ChunkDraw));
+  }
+
+  size_t index = renderer->drawCount++;
+  ChunkDraw *draw = &renderer->draws[index];
+  draw->origin[0] = (float)(cx * CHUNK_SIZE);
+  draw->origin[1] = (float)(cy * CHUNK_SIZE);
+  draw->origin[2] = (float)(cz * CHUNK_SIZE);
+  draw->allocation = allocation;
+  draw->id = newDrawId(renderer);
+  renderer->slots[draw->id] = (uint32_t)index;
+  writeMesh(renderer, draw, mesh);
+
+  float max[3] = {draw->origin[0] + CHUNK_SIZE, draw->origin[1] + CHUNK_SIZE,
+                  draw->origin[2] + CHUNK_SIZE};
+  addChunkBounds(&renderer->bounds, draw->origin, max);
+  return draw->id;
+}
+
+bool chunkRendererUpdate(ChunkRenderer *renderer, ChunkDrawId id,
+                         const Mesh *mesh) {
+  ChunkDraw *draw = &renderer->draws[renderer->slots[id]];
+
+  const GpuAllocation *current =
+      gpuArenaGet(&renderer->arena, draw->allocation);
+  if (meshSize(mesh) > current->size) {
+    // A chunk that grew is likely being built on, so leave it room to grow
+    // more and still be written in place
+    GpuHandle allocation =
+        allocMesh(renderer, meshSize(mesh) + meshSize(mesh) / 4);
+    if (allocation == GPU_HANDLE_NONE) {
+      return false;
+    }
+    gpuArenaFree(&renderer->arena, draw->allocation);
+    draw->allocation = allocation;
+  }
+
+  writeMesh(renderer, draw, mesh);
+  return true;
+}
+
+void chunkRendererRemove(ChunkRenderer *renderer, ChunkDrawId id) {
+  size_t index = renderer->slots[id];
+  gpuArenaFree(&renderer->arena, renderer->draws[index].allocation);
+
+  // Keep the draws dense for culling by moving the last one into the gap
+  size_t last = --renderer->drawCount;
+  renderer->draws[index] = renderer->draws[last];
+  renderer->slots[renderer->draws[index].id] = (uint32_t)index;
+  removeChunkBounds(&renderer->bounds, index);
+
+  renderer->slots[id] = CHUNK_DRAW_NONE;
+  renderer->freeIds[renderer->freeIdCount++] = id;
+}
+
+void chunkRendererCompact(ChunkRenderer *renderer) {
+  if (gpuArenaCompact(&renderer->arena)) {
+    syncVertexArrays(renderer);
+  }
+}
+
+static void reserveScratch(ChunkRenderer *renderer) {
+  if (renderer->scratchCapacity >= renderer->drawCount) {
+    return;
+  }
+
+  renderer->scratchCapacity = renderer->drawCapacity;
+  renderer->visible = realloc(renderer->visible,
+                              renderer->scratchCapacity * sizeof(uint32_t));
+  renderer->commands = realloc(
+      renderer->commands, renderer->scratchCapacity * sizeof(DrawCommand));
+  renderer->origins = realloc(renderer->origins,
+                              renderer->scratchCapacity * 3 * sizeof(float));
+}
+
+static void fillCommand(const ChunkRenderer *renderer, const ChunkDraw *draw,
+                        DrawCommand *command) {
+  const GpuAllocation *allocation =
+      gpuArenaGet(&renderer->arena, draw->allocation);
+  size_t indexOffset =
+      allocation->offset + draw->vertexCount * sizeof(PackedVertex);
+
+  command->count = draw->indexCount;
+  command->instanceCount = 1;
+  command->firstIndex = (uint32_t)(indexOffset / sizeof(uint32_t));
+  command->baseVertex = (int32_t)(allocation->offset / sizeof(PackedVertex));
+  command->baseInstance = 0;
+}
+
+static void countDraws(const RenderStats *stats) {
+  profileCount(COUNTER_DRAW_CALLS, stats->drawCalls);
+  profileCount(COUNTER_TRIANGLES, stats->triangles);
+}
+
+void chunkRendererDraw(ChunkRenderer *renderer, const Frustum *frustum) {
+  RenderStats *stats = &renderer->stats;
+  memset(stats, 0, sizeof(*stats));
+
+  reserveScratch(renderer);
+  double start = profileBegin();
+  size_t visibleCount = cullChunkBounds(frustum, &renderer->bounds,
+                                        renderer->visible, &stats->cull);
+  profileEnd("cull chunks", start);
+  if (visibleCount == 0) {
+    return;
+  }
+
+  if (!renderer->indirect) {
+    int boundBuffer = -1;
+    for (size_t i = 0; i < visibleCount; i++) {
+      const ChunkDraw *draw = &renderer->draws[renderer->visible[i]];
+      int buffer =
+          (int)gpuArenaGet(&renderer->arena, draw->allocation)->buffer;
+      if (buffer != boundBuffer) {
+        glBindVertexArray(renderer->VAOs[buffer]);
+        boundBuffer = buffer;
+      }
+
+      DrawCommand command;
+      fillCommand(renderer, draw, &command);
+      glVertexAttrib3fv(ATTRIB_ORIGIN, draw->origin);
+      glDrawElementsBaseVertex(
+          GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+          (void *)((size_t)command.firstIndex * sizeof(uint32_t)),
+          command.baseVertex);
+      stats->triangles += draw->indexCount / 3;
+    }
+    stats->drawCalls = visibleCount;
+    countDraws(stats);
+    return;
+  }
+
+  // Commands are grouped by buffer, since each buffer needs its own call
+  size_t bufferStart[GPU_ARENA_MAX_BUFFERS + 1] = {0};
+  for (size_t i = 0; i < visibleCount; i++) {
+    const ChunkDraw *draw = &renderer->draws[renderer->visible[i]];
+    uint32_t buffer = gpuArenaGet(&renderer->arena, draw->allocation)->buffer;
+    bufferStart[buffer + 1]++;
+  }
+  for (int b = 0; b < GPU_ARENA_MAX_BUFFERS; b++) {
+    bufferStart[b + 1] += bufferStart[b];
+  }
+
+  size_t next[GPU_ARENA_MAX_BUFFERS];
+  memcpy(next, bufferStart, sizeof(next));
+  for (size_t i = 0; i < visibleCount; i++) {
+    const ChunkDraw *draw = &renderer->draws[renderer->visible[i]];
+    uint32_t buffer = gpuArenaGet(&renderer->arena, draw->allocation)->buffer;
+    size_t slot = next[buffer]++;
+
+    DrawCommand *command = &renderer->commands[slot];
+    fillCommand(renderer, draw, command);
+    command->baseInstance = (uint32_t)slot;
+    memcpy(&renderer->origins[slot * 3], draw->origin, sizeof(draw->origin));
+    stats->triangles += draw->indexCount / 3;
+  }
+
+  // Orphan last frame's data rather than wait for the GPU to finish with it
+  glBindBuffer(GL_ARRAY_BUFFER, renderer->originBuffer);
+  glBufferData(GL_ARRAY_BUFFER, visibleCount * 3 * sizeof(float),
+               renderer->origins, GL_STREAM_DRAW);
+
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, renderer->commandBuffer);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER, visibleCount * sizeof(DrawCommand),
+               renderer->commands, GL_STREAM_DRAW);
+
+  for (int b = 0; b < renderer->VAOCount; b++) {
+    size_t count = bufferStart[b + 1] - bufferStart[b];
+    if (count == 0) {
+      continue;
+    }
+
+    glBindVertexArray(renderer->VAOs[b]);
+    glMultiDrawElementsIndirect(
+        GL_TRIANGLES, GL_UNSIGNED_INT,
+        (void *)(bufferStart[b] * sizeof(DrawCommand)), (GLsizei)count, 0);
+    stats->drawCalls++;
+  }
+  countDraws(stats);
+}
@@ -0,0 +1,94 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "frustum.h"
+#include "gpu_arena.h"
+#include "mesher.h"
+
+// Stays the same for as long as the chunk is in the renderer
+typedef uint32_t ChunkDrawId;
+#define CHUNK_DRAW_NONE UINT32_MAX
+
+// A chunk mesh living in the arena, vertices first and then indices
+typedef struct ChunkDraw {
+  float origin[3];
+  GpuHandle allocation;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  ChunkDrawId id;
+} ChunkDraw;
+
+// Layout glMultiDrawElementsIndirect expects
+typedef struct DrawCommand {
+  uint32_t count;
+  uint32_t instanceCount;
+  uint32_t firstIndex;
+  int32_t baseVertex;
+  uint32_t baseInstance;
+} DrawCommand;
+
+typedef struct RenderStats {
+  size_t drawCalls;
+  size_t triangles;
+  CullStats cull;
+} RenderStats;
+
+// Chunk meshes are suballocated from a few large buffers, and all visible
+// chunks in a buffer are drawn with a single glMultiDrawElementsIndirect on
+// GL 4.3. Older contexts fall back to one glDrawElementsBaseVertex per chunk
+typedef struct ChunkRenderer {
+  GpuArena arena;
+  // One per arena buffer, with the buffer name it was set up for
+  unsigned int VAOs[GPU_ARENA_MAX_BUFFERS];
+  unsigned int VAOBuffers[GPU_ARENA_MAX_BUFFERS];
+  int VAOCount;
+
+  unsigned int originBuffer;
+  unsigned int commandBuffer;
+  bool indirect;
+
+  // Draws and bounds share indices, which change as chunks are removed.
+  // slots maps each id to its draw, or CHUNK_DRAW_NONE
+  ChunkDraw *draws;
+  size_t drawCount, drawCapacity;
+  ChunkBounds bounds;
+  uint32_t *slots;
+  ChunkDrawId *freeIds;
+  size_t slotCount, slotCapacity, freeIdCount;
+
+  // Per frame scratch space
+  uint32_t *visible;
+  DrawCommand *commands;
+  float *origins;
+  size_t scratchCapacity;
+
+  RenderStats stats;
+} ChunkRenderer;
+
+// bufferSize is the size of each of the arena's buffers in bytes
+void initChunkRenderer(ChunkRenderer *renderer, size_t bufferSize);
+
+void freeChunkRenderer(ChunkRenderer *renderer);
+
+// Uploads a mesh for the chunk at the given chunk coordinates. Returns
+// CHUNK_DRAW_NONE if the arena is full
+ChunkDrawId chunkRendererAdd(ChunkRenderer *renderer, int cx, int cy, int cz,
+                             const Mesh *mesh);
+
+// Replaces a chunk's mesh, in place when the new one fits. Returns false
+// and keeps the old mesh if there is no room
+bool chunkRendererUpdate(ChunkRenderer *renderer, ChunkDrawId id,
+                         const Mesh *mesh);
+
+void chunkRendererRemove(ChunkRenderer *renderer, ChunkDrawId id);
+
+// Packs the arena's buffers, worth doing when its fragmentation gets high
+void chunkRendererCompact(ChunkRenderer *renderer);
+
+// Draws every chunk inside the frustum with the bound shader program
+void chunkRendererDraw(ChunkRenderer *renderer, const Frustum *frustum);
+
+#endif
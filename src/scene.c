@@ -0,0 +1,452 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glad/glad.h>
+#include "frustum.h"
+#include "profiler.h"
+#include "scene.h"
+#include "shader.h"
+#include "texture.h"
+
+static void queueMesh(Scene *scene, Chunk *chunk) {
+  // Any mesh job already running for the chunk is now out of date
+  MeshState *state =
+      meshStatesAdd(&scene->meshStates, chunk->x, chunk->y, chunk->z);
+  state->meshVersion = ++scene->meshVersion;
+  if (state->meshQueued) {
+    return;
+  }
+
+  if (scene->meshQueueEnd == scene->meshQueueCapacity) {
+    size_t count = scene->meshQueueEnd - scene->meshQueueStart;
+    if (scene->meshQueueStart > 0) {
+      memmove(scene->meshQueue, &scene->meshQueue[scene->meshQueueStart],
+              count * sizeof(ChunkPos));
+    } else {
+      scene->meshQueueCapacity =
+          scene->meshQueueCapacity ? scene->meshQueueCapacity * 2 : 256;
+      scene->meshQueue = realloc(scene->meshQueue,
+                                 scene->meshQueueCapacity * sizeof(ChunkPos));
+    }
+    scene->meshQueueStart = 0;
+    scene->meshQueueEnd = count;
+  }
+
+  scene->meshQueue[scene->meshQueueEnd++] =
+      (ChunkPos){chunk->x, chunk->y, chunk->z};
+  state->meshQueued = true;
+}
+
+static const int neighbourOffsets[6][3] = {
+    {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+
+// Meshing before the neighbours arrive would only have to be redone, unless
+// they are never going to be loaded
+static bool readyToMesh(const Scene *scene, const Chunk *chunk) {
+  for (int i = 0; i < 6; i++) {
+    int x = chunk->x + neighbourOffsets[i][0];
+    int y = chunk->y + neighbourOffsets[i][1];
+    int z = chunk->z + neighbourOffsets[i][2];
+    if (worldGetChunk(scene->world, x, y, z) == NULL &&
+        streamerInRange(&scene->streamer, x, y, z)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void markDirty(Scene *scene, Chunk *chunk) {
+  if (chunk == NULL) {
+    return;
+  }
+  MeshState *state =
+      meshStatesAdd(&scene->meshStates, chunk->x, chunk->y, chunk->z);
+  if (state->meshDirty) {
+    return;
+  }
+
+  if (scene->dirtyCount == scene->dirtyCapacity) {
+    scene->dirtyCapacity = scene->dirtyCapacity ? scene->dirtyCapacity * 2 : 64;
+    scene->dirty =
+        realloc(scene->dirty, scene->dirtyCapacity * sizeof(ChunkPos));
+  }
+  scene->dirty[scene->dirtyCount++] = (ChunkPos){chunk->x, chunk->y, chunk->z};
+  state->meshDirty = true;
+}
+
+// Light is baked into the meshes, so they have to be rebuilt with it
+static void chunkRelit(void *user, Chunk *chunk) {
+  Scene *scene = user;
+  if (scene->editing) {
+    markDirty(scene, chunk);
+  } else if (readyToMesh(scene, chunk)) {
+    queueMesh(scene, chunk);
+  }
+}
+
+// The chunk's border changes the faces its neighbours need, so they are
+// meshed again along with it
+static void chunkLoaded(void *user, Chunk *chunk) {
+  Scene *scene = user;
+  lightChunkLoaded(&scene->light, chunk);
+  if (readyToMesh(scene, chunk)) {
+    queueMesh(scene, chunk);
+  }
+
+  for (int i = 0; i < 6; i++) {
+    Chunk *neighbour = worldGetChunk(scene->world,
+                                     chunk->x + neighbourOffsets[i][0],
+                                     chunk->y + neighbourOffsets[i][1],
+                                     chunk->z + neighbourOffsets[i][2]);
+    if (neighbour != NULL && readyToMesh(scene, neighbour)) {
+      queueMesh(scene, neighbour);
+    }
+  }
+}
+
+static void removeMesh(Scene *scene, MeshState *state) {
+  if (state->drawId != CHUNK_DRAW_NONE) {
+    chunkRendererRemove(&scene->chunkRenderer, state->drawId);
+    state->drawId = CHUNK_DRAW_NONE;
+  }
+}
+
+static void chunkUnloaded(void *user, Chunk *chunk) {
+  Scene *scene = user;
+  MeshState *state =
+      meshStatesGet(&scene->meshStates, chunk->x, chunk->y, chunk->z);
+  if (state != NULL) {
+    removeMesh(scene, state);
+    meshStatesRemove(&scene->meshStates, chunk->x, chunk->y, chunk->z);
+  }
+}
+
+Scene *createScene(const SceneConfig *config, int width, int height) {
+  Scene *scene = calloc(1, sizeof(Scene));
+  scene->config = *config;
+
+  glEnable(GL_DEPTH_TEST);
+
+  // Shaders
+  char *vertexShaderSource = getShaderContent("./assets/shaders/vertex.vs");
+  unsigned int vertexShader =
+      createShader(vertexShaderSource, GL_VERTEX_SHADER);
+
+  char *fragmentShaderSource =
+      getShaderContent("./assets/shaders/fragment.fs");
+  unsigned int fragmentShader =
+      createShader(fragmentShaderSource, GL_FRAGMENT_SHADER);
+
+  scene->shaderProgram = createProgram(vertexShader, fragmentShader);
+  scene->viewLoc = glGetUniformLocation(scene->shaderProgram, "view");
+  scene->projectionLoc =
+      glGetUniformLocation(scene->shaderProgram, "projection");
+
+  // Every block tile lives in one texture array
+  scene->blockTextures = loadBlockTextures("./assets/textures");
+
+  glUseProgram(scene->shaderProgram);
+  glUniform1i(glGetUniformLocation(scene->shaderProgram, "blocks"), 0);
+  sceneResize(scene, width, height);
+
+  // === World ===
+  initTerrain(&scene->terrain, config->seed);
+  scene->world = createWorld();
+  initLightEngine(&scene->light, scene->world, config->worldHeight);
+  scene->light.onChanged = chunkRelit;
+  scene->light.user = scene;
+
+  // Chunks are loaded or generated on worker threads around the camera
+  initChunkStreamer(&scene->streamer, scene->world, &scene->terrain,
+                    config->saveDirectory, config->viewDistance,
+                    config->worldSize, config->worldHeight);
+  scene->streamer.onLoad = chunkLoaded;
+  scene->streamer.onUnload = chunkUnloaded;
+  scene->streamer.user = scene;
+
+  // Then meshed on worker threads and uploaded as they finish
+  initChunkRenderer(&scene->chunkRenderer, CHUNK_BUFFER_SIZE);
+  initMeshStates(&scene->meshStates);
+  initInstanceRenderer(&scene->instances);
+  initGpuTimers(&scene->gpuTimers);
+
+  int workerCount = cpuCount() > 1 ? cpuCount() - 1 : 1;
+  scene->meshPool = createThreadPool(workerCount, MESH_JOB_COUNT);
+
+  scene->freeMeshJobCount = MESH_JOB_COUNT;
+  for (int i = 0; i < MESH_JOB_COUNT; i++) {
+    scene->meshJobs[i] = scene->freeMeshJobs[i] = createMeshJob();
+  }
+  scene->editJob = createMeshJob();
+  return scene;
+}
+
+void destroyScene(Scene *scene) {
+  destroyThreadPool(scene->meshPool);
+  for (int i = 0; i < MESH_JOB_COUNT; i++) {
+    destroyMeshJob(scene->meshJobs[i]);
+  }
+  destroyMeshJob(scene->editJob);
+
+  freeChunkStreamer(&scene->streamer);
+  freeChunkRenderer(&scene->chunkRenderer);
+  freeMeshStates(&scene->meshStates);
+  freeInstanceRenderer(&scene->instances);
+  freeGpuTimers(&scene->gpuTimers);
+  freeLightEngine(&scene->light);
+  destroyWorld(scene->world);
+  free(scene->meshQueue);
+  free(scene->edits);
+  free(scene->dirty);
+  free(scene->meshTimes);
+  glDeleteTextures(1, &scene->blockTextures);
+  glDeleteProgram(scene->shaderProgram);
+  free(scene);
+}
+
+void sceneResize(Scene *scene, int width, int height) {
+  glViewport(0, 0, width, height);
+  glm_perspective(glm_rad(45.0f), (float)width / (float)height, 0.1f, 500.0f,
+                  scene->projection);
+
+  // Projection Matrix doesn't change often
+  glUseProgram(scene->shaderProgram);
+  glUniformMatrix4fv(scene->projectionLoc, 1, GL_FALSE, scene->projection[0]);
+}
+
+// Out of room usually means the arena is fragmented, so pack it and retry
+static void uploadMesh(Scene *scene, MeshState *state, const Mesh *mesh) {
+  ChunkRenderer *renderer = &scene->chunkRenderer;
+  if (mesh->indexCount == 0) {
+    removeMesh(scene, state);
+    return;
+  }
+
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (state->drawId == CHUNK_DRAW_NONE) {
+      state->drawId =
+          chunkRendererAdd(renderer, state->x, state->y, state->z, mesh);
+      if (state->drawId != CHUNK_DRAW_NONE) {
+        return;
+      }
+    } else if (chunkRendererUpdate(renderer, state->drawId, mesh)) {
+      return;
+    }
+    chunkRendererCompact(renderer);
+  }
+  printf("Out of chunk buffer space\n");
+}
+
+// Relights around a block already set and remeshes what it touched
+static void relightEdit(Scene *scene, int x, int y, int z, BlockId previous) {
+  scene->editing = true;
+  lightRelightBlock(&scene->light, x, y, z, previous);
+  scene->editing = false;
+
+  // Meshes take in a one block border of the chunks around them, so an
+  // edit on a border dirties the neighbours across it. Diagonal ones too,
+  // since their corners are shaded by it
+  int local[3] = {WORLD_TO_LOCAL(x), WORLD_TO_LOCAL(y), WORLD_TO_LOCAL(z)};
+  int from[3], to[3];
+  for (int i = 0; i < 3; i++) {
+    from[i] = local[i] == 0 ? -1 : 0;
+    to[i] = local[i] == CHUNK_MASK ? 1 : 0;
+  }
+
+  int cx = WORLD_TO_CHUNK(x), cy = WORLD_TO_CHUNK(y), cz = WORLD_TO_CHUNK(z);
+  for (int dy = from[1]; dy <= to[1]; dy++) {
+    for (int dz = from[2]; dz <= to[2]; dz++) {
+      for (int dx = from[0]; dx <= to[0]; dx++) {
+        markDirty(scene,
+                  worldGetChunk(scene->world, cx + dx, cy + dy, cz + dz));
+      }
+    }
+  }
+}
+
+void sceneSetBlock(Scene *scene, int x, int y, int z, BlockId block) {
+  if (scene->editCount == scene->editCapacity) {
+    scene->editCapacity = scene->editCapacity ? scene->editCapacity * 2 : 16;
+    scene->edits =
+        realloc(scene->edits, scene->editCapacity * sizeof(BlockEdit));
+  }
+  scene->edits[scene->editCount++] = (BlockEdit){x, y, z, block};
+}
+
+// Only the block itself changes under the lock, the sim waits on it. Light
+// spreads and meshes are marked after it's let go, that only reads blocks
+// and nothing else writes them. Edits left when the sim holds the lock
+// wait for the next frame, in order
+static void applyEdits(Scene *scene) {
+  size_t applied = 0;
+  while (applied < scene->editCount &&
+         pthread_mutex_trylock(&scene->world->lock) == 0) {
+    const BlockEdit *edit = &scene->edits[applied++];
+    BlockId previous = lightReplaceBlock(&scene->light, edit->x, edit->y,
+                                         edit->z, edit->block);
+    pthread_mutex_unlock(&scene->world->lock);
+    relightEdit(scene, edit->x, edit->y, edit->z, previous);
+  }
+
+  scene->editCount -= applied;
+  memmove(scene->edits, scene->edits + applied,
+          scene->editCount * sizeof(BlockEdit));
+}
+
+void sceneFlushEdits(Scene *scene) {
+  double zoneStart = profileBegin();
+  applyEdits(scene);
+  for (size_t i = 0; i < scene->dirtyCount; i++) {
+    ChunkPos pos = scene->dirty[i];
+    MeshState *state = meshStatesGet(&scene->meshStates, pos.x, pos.y, pos.z);
+    Chunk *chunk = worldGetChunk(scene->world, pos.x, pos.y, pos.z);
+    if (state == NULL || chunk == NULL || !state->meshDirty) {
+      continue;
+    }
+    state->meshDirty = false;
+
+    // Chunks still waiting on neighbours get meshed when they arrive
+    if (!readyToMesh(scene, chunk)) {
+      continue;
+    }
+
+    // Whatever is queued or running for the chunk is out of date now
+    state->meshVersion = ++scene->meshVersion;
+    state->meshQueued = false;
+    scene->editsMeshed++;
+    if (meshIsEmpty(scene->world, chunk)) {
+      removeMesh(scene, state);
+      continue;
+    }
+
+    MeshJob *job = scene->editJob;
+    prepareMeshJob(job, scene->world, chunk, MESH_GREEDY);
+    meshChunk(&job->input, job->mode, &job->mesh);
+    uploadMesh(scene, state, &job->mesh);
+  }
+  scene->dirtyCount = 0;
+  profileEnd("mesh edits", zoneStart);
+}
+
+void sceneUpdate(Scene *scene, const float eye[3], const float target[3]) {
+  streamerUpdate(&scene->streamer, eye, target);
+  sceneFlushEdits(scene);
+
+  double zoneStart = profileBegin();
+  while (scene->meshQueueStart < scene->meshQueueEnd &&
+         scene->freeMeshJobCount > 0) {
+    ChunkPos pos = scene->meshQueue[scene->meshQueueStart++];
+    MeshState *state = meshStatesGet(&scene->meshStates, pos.x, pos.y, pos.z);
+    Chunk *chunk = worldGetChunk(scene->world, pos.x, pos.y, pos.z);
+    if (state == NULL || chunk == NULL || !state->meshQueued) {
+      continue;
+    }
+
+    // Open sky and buried rock have nothing to draw
+    if (meshIsEmpty(scene->world, chunk)) {
+      state->meshQueued = false;
+      removeMesh(scene, state);
+      continue;
+    }
+
+    MeshJob *job = scene->freeMeshJobs[scene->freeMeshJobCount - 1];
+    prepareMeshJob(job, scene->world, chunk, MESH_GREEDY);
+    job->version = state->meshVersion;
+    if (!threadPoolSubmit(scene->meshPool, &job->job)) {
+      scene->meshQueueStart--;
+      break;
+    }
+    state->meshQueued = false;
+    scene->freeMeshJobCount--;
+  }
+  profileEnd("submit meshing", zoneStart);
+
+  zoneStart = profileBegin();
+  Job *meshed[MESH_JOB_COUNT];
+  size_t meshedCount = threadPoolPoll(scene->meshPool, meshed, MESH_JOB_COUNT);
+  for (size_t i = 0; i < meshedCount; i++) {
+    MeshJob *job = (MeshJob *)meshed[i];
+    scene->freeMeshJobs[scene->freeMeshJobCount++] = job;
+
+    // The chunk may have been unloaded or queued again since
+    MeshState *state =
+        meshStatesGet(&scene->meshStates, job->x, job->y, job->z);
+    if (state != NULL && state->meshVersion == job->version) {
+      uploadMesh(scene, state, &job->mesh);
+    }
+
+    if (scene->meshTimeCount == scene->meshTimeCapacity) {
+      scene->meshTimeCapacity =
+          scene->meshTimeCapacity ? scene->meshTimeCapacity * 2 : 256;
+      scene->meshTimes = realloc(scene->meshTimes,
+                                 scene->meshTimeCapacity * sizeof(double));
+    }
+    scene->meshTimes[scene->meshTimeCount++] = job->meshTime;
+  }
+  profileCount(COUNTER_CHUNKS_MESHED, meshedCount);
+  profileEnd("upload meshes", zoneStart);
+}
+
+bool sceneLoaded(const Scene *scene) {
+  return streamerIdle(&scene->streamer) &&
+         scene->meshQueueStart == scene->meshQueueEnd &&
+         scene->freeMeshJobCount == MESH_JOB_COUNT;
+}
+
+void sceneRender(Scene *scene, const float eye[3], const float target[3]) {
+  glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, scene->blockTextures);
+  glUseProgram(scene->shaderProgram);
+
+  mat4 view;
+  glm_lookat((float *)eye, (float *)target, (vec3){0.0f, 1.0f, 0.0f}, view);
+  glUniformMatrix4fv(scene->viewLoc, 1, GL_FALSE, view[0]);
+
+  // Draw every chunk inside the view
+  mat4 viewProjection;
+  glm_mat4_mul(scene->projection, view, viewProjection);
+
+  double zoneStart = profileBegin();
+  gpuTimerBegin(&scene->gpuTimers, "chunks");
+
+  Frustum frustum;
+  extractFrustum(viewProjection[0], &frustum);
+  chunkRendererDraw(&scene->chunkRenderer, &frustum);
+
+  gpuTimerEnd(&scene->gpuTimers);
+  profileEnd("draw chunks", zoneStart);
+}
+
+void sceneRenderInstances(Scene *scene, const float eye[3],
+                          const float target[3], const float (*transforms)[16],
+                          size_t count, const float color[3]) {
+  mat4 view, viewProjection;
+  glm_lookat((float *)eye, (float *)target, (vec3){0.0f, 1.0f, 0.0f}, view);
+  glm_mat4_mul(scene->projection, view, viewProjection);
+
+  gpuTimerBegin(&scene->gpuTimers, "instances");
+  instanceRendererDraw(&scene->instances, viewProjection[0], transforms, count,
+                       color);
+  gpuTimerEnd(&scene->gpuTimers);
+}
+
+void orbitCamera(const Scene *scene, double time, float eye[3],
+                 float target[3]) {
+  // Unbounded worlds circle the area the view distance would cover
+  int size = scene->config.worldSize > 0 ? scene->config.worldSize
+                                         : scene->config.viewDistance;
+  const float radius = size * CHUNK_SIZE * 0.75f;
+  const float center = size * CHUNK_SIZE * 0.5f;
+  float angle = (float)(time * 0.2);
+
+  eye[0] = center + sinf(angle) * radius;
+  eye[1] = 90.0f;
+  eye[2] = center + cosf(angle) * radius;
+  target[0] = center;
+  target[1] = 30.0f;
+  target[2] = center;
+}
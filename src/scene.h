@@ -0,0 +1,138 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <cglm/cglm.h>
+#include "gpu_timer.h"
+#include "instancing.h"
+#include "light.h"
+#include "mesh_state.h"
+#include "mesher.h"
+#include "renderer.h"
+#include "stream.h"
+#include "terrain.h"
+#include "threadpool.h"
+#include "world.h"
+
+// Default world size in chunks
+#define WORLD_SIZE 8
+#define WORLD_HEIGHT 6
+#define WORLD_SEED 1337u
+
+// Default horizontal radius of chunks kept loaded around the camera
+#define VIEW_DISTANCE 12
+
+// Chunks that can be meshing at once
+#define MESH_JOB_COUNT 64
+
+// Size of each GPU buffer chunk meshes are allocated from
+#define CHUNK_BUFFER_SIZE (32 * 1024 * 1024)
+
+typedef struct SceneConfig {
+  uint32_t seed;
+  int viewDistance; // Chunks around the camera to keep loaded
+  int worldSize;    // Chunks along x and z from 0, or 0 for no limit
+  int worldHeight;  // Chunks from y = 0 up
+  // Chunks saved here are loaded instead of generated, and chunks that
+  // changed are saved back. NULL to always generate and never save
+  const char *saveDirectory;
+} SceneConfig;
+
+typedef struct ChunkPos {
+  int x, y, z;
+} ChunkPos;
+
+typedef struct BlockEdit {
+  int x, y, z;
+  BlockId block;
+} BlockEdit;
+
+// The world and everything needed to draw it, shared by the window and
+// headless runs. Needs a current GL context
+typedef struct Scene {
+  SceneConfig config;
+  Terrain terrain;
+  World *world;
+  ChunkStreamer streamer;
+  LightEngine light;
+
+  ThreadPool *meshPool;
+  MeshJob *meshJobs[MESH_JOB_COUNT];
+  MeshJob *freeMeshJobs[MESH_JOB_COUNT];
+  int freeMeshJobCount;
+
+  // Mesh and draw state of the chunks the scene has meshed or queued,
+  // dropped as they unload
+  MeshStates meshStates;
+
+  // Chunks waiting for a mesh job, in the order they became ready
+  ChunkPos *meshQueue;
+  size_t meshQueueStart, meshQueueEnd, meshQueueCapacity;
+  uint32_t meshVersion;
+
+  // Blocks set while the world was locked, applied in order once it isn't
+  BlockEdit *edits;
+  size_t editCount, editCapacity;
+
+  // Chunks with edits that aren't drawn yet. These skip the queue and are
+  // meshed on the main thread, so an edit shows up in the next frame
+  ChunkPos *dirty;
+  size_t dirtyCount, dirtyCapacity;
+  bool editing; // Chunks relit while this is set are dirty too
+  MeshJob *editJob;
+  size_t editsMeshed; // Dirty chunks meshed so far
+
+  ChunkRenderer chunkRenderer;
+  InstanceRenderer instances;
+  GpuTimers gpuTimers;
+
+  // How long each chunk took to mesh, in seconds
+  double *meshTimes;
+  size_t meshTimeCount, meshTimeCapacity;
+
+  unsigned int shaderProgram;
+  unsigned int blockTextures;
+  int viewLoc, projectionLoc;
+  mat4 projection;
+} Scene;
+
+// The world starts empty and streams in around the camera passed to
+// sceneUpdate. Drawn to a width x height viewport
+Scene *createScene(const SceneConfig *config, int width, int height);
+
+// Saves every chunk that changed
+void destroyScene(Scene *scene);
+
+void sceneResize(Scene *scene, int width, int height);
+
+// Streams chunks around the camera, hands them to the mesh workers and
+// uploads the finished meshes
+void sceneUpdate(Scene *scene, const float eye[3], const float target[3]);
+
+// Sets a block, relights around it and marks every chunk whose mesh it
+// changes as dirty. Chunks that aren't loaded are left alone. The block
+// changes in the next sceneFlushEdits that finds the world unlocked
+void sceneSetBlock(Scene *scene, int x, int y, int z, BlockId block);
+
+// Applies the blocks set unless the world is locked, then meshes the dirty
+// chunks and writes them over their old meshes. Called by sceneUpdate,
+// edits made before it are drawn in that frame when the world was free
+void sceneFlushEdits(Scene *scene);
+
+// True once every chunk in range is loaded, meshed and uploaded
+bool sceneLoaded(const Scene *scene);
+
+// Draws the world seen from eye towards target
+void sceneRender(Scene *scene, const float eye[3], const float target[3]);
+
+// Draws a unit cube through each model matrix, after sceneRender
+void sceneRenderInstances(Scene *scene, const float eye[3],
+                          const float target[3], const float (*transforms)[16],
+                          size_t count, const float color[3]);
+
+// The camera path the window and benchmarks follow, time in seconds
+void orbitCamera(const Scene *scene, double time, float eye[3],
+                 float target[3]);
+
+#endif
@@ -0,0 +1,329 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profiler.h"
+#include "sim.h"
+#include "timer.h"
+
+// Set in Simulation.latest while the snapshot there hasn't been read
+#define SNAPSHOT_FRESH 4
+
+// Landing starts the player's feet below wherever the camera is
+static void toggleFlying(SimState *state) {
+  Camera *camera = &state->camera;
+  camera->flying = !camera->flying;
+  if (!camera->flying) {
+    Body *player = &state->player;
+    memset(player->velocity, 0, sizeof(player->velocity));
+    for (int i = 0; i < 3; i++) {
+      player->position[i] = camera->position[i];
+    }
+    player->position[1] -= PLAYER_EYE_HEIGHT;
+    player->onGround = false;
+  }
+}
+
+// The main thread only holds the world's lock while it swaps chunks in or
+// out or sets blocks, so this never waits long. The wait isn't counted as
+// part of the tick
+static void lockWorld(Simulation *sim) {
+  double start = timerNow();
+  pthread_mutex_lock(&sim->scene->world->lock);
+  sim->worldWait += timerNow() - start;
+}
+
+// Walking moves the player's body through the world, jumping off the ground
+// with up held. The world has to be locked
+static void walk(Simulation *sim, SimState *state) {
+  Body *player = &state->player;
+  cameraVelocity(&state->camera, sim->held, player->velocity);
+  if (sim->held[ACTION_UP] && player->onGround) {
+    player->velocity[1] = PLAYER_JUMP_SPEED;
+  }
+
+  // Chunks that haven't streamed in yet would be fallen straight through,
+  // so wait for them. Above the world there is only sky
+  const Scene *scene = sim->scene;
+  int cx = WORLD_TO_CHUNK((int)floorf(player->position[0]));
+  int cy = WORLD_TO_CHUNK((int)floorf(player->position[1]));
+  int cz = WORLD_TO_CHUNK((int)floorf(player->position[2]));
+  if (cy >= scene->config.worldHeight ||
+      worldGetChunk(scene->world, cx, cy, cz) != NULL) {
+    bodyStep(scene->world, player, (float)SIM_TICK, NULL);
+  }
+
+  for (int i = 0; i < 3; i++) {
+    state->camera.position[i] = player->position[i];
+  }
+  state->camera.position[1] += PLAYER_EYE_HEIGHT;
+}
+
+// Entities stepped through the world by physics
+static size_t countBoxes(const EntityStore *entities) {
+  size_t count = 0;
+  for (int a = 0; a < entities->archetypeCount; a++) {
+    if (entities->archetypes[a].mask & COMPONENT_BOX) {
+      count += entities->archetypes[a].count;
+    }
+  }
+  return count;
+}
+
+// Mobs, dropped items and particles thrown out from 8 blocks ahead, as
+// many as fit under the limits
+static void spawnBurst(Simulation *sim, const SimState *state) {
+  float eye[3], target[3];
+  cameraEyeTarget(&state->camera, eye, target);
+  float origin[3];
+  for (int i = 0; i < 3; i++) {
+    origin[i] = eye[i] + (target[i] - eye[i]) * 8.0f;
+  }
+
+  // Seeded by the tick, so the same input always spawns the same burst
+  uint32_t random = (uint32_t)state->tick * 2654435761u | 1u;
+  size_t boxes = countBoxes(&sim->entities);
+  for (int i = 0; i < SPAWN_MOBS + SPAWN_ITEMS + SPAWN_PARTICLES; i++) {
+    bool mob = i < SPAWN_MOBS, item = !mob && i < SPAWN_MOBS + SPAWN_ITEMS;
+    if (sim->entities.entityCount >= SIM_MAX_ENTITIES) {
+      break;
+    }
+    if ((mob || item) && boxes >= SIM_MAX_BOXES) {
+      continue;
+    }
+    boxes += mob || item;
+
+    ComponentMask mask = COMPONENT_POSITION | COMPONENT_VELOCITY |
+                         COMPONENT_TRANSFORM |
+                         (mob || item ? COMPONENT_BOX : 0);
+    EntityId entity = createEntity(&sim->entities, mask);
+    if (entity == ENTITY_NONE) {
+      break;
+    }
+
+    float velocity[3];
+    for (int j = 0; j < 3; j++) {
+      random ^= random << 13;
+      random ^= random >> 17;
+      random ^= random << 5;
+      velocity[j] = (random & 0xffff) / 65536.0f * 8.0f - 4.0f;
+    }
+    velocity[1] += 6.0f;
+    entitySetPosition(&sim->entities, entity, origin);
+    entitySetVelocity(&sim->entities, entity, velocity);
+    if (mob) {
+      entitySetBox(&sim->entities, entity, 0.3f, 1.8f, 1.0f);
+    } else if (item) {
+      entitySetBox(&sim->entities, entity, 0.125f, 0.25f, 0.0f);
+    } else {
+      entitySetScale(&sim->entities, entity, 0.1f);
+    }
+  }
+}
+
+// Destroying moves the last row into the gap, so go from the end
+static void destroyFallen(EntityStore *entities) {
+  for (int a = 0; a < entities->archetypeCount; a++) {
+    Archetype *archetype = &entities->archetypes[a];
+    for (size_t row = archetype->count; row-- > 0;) {
+      if (archetype->position[1][row] < -CHUNK_SIZE) {
+        destroyEntity(entities, archetype->ids[row]);
+      }
+    }
+  }
+}
+
+// Advances the state by exactly one tick. Depends on nothing but the state,
+// the input it reads and the world, so the same input in the same world
+// always gives the same result
+static void simTick(Simulation *sim, SimState *state) {
+  state->tick++;
+  state->time += SIM_TICK;
+
+  bool first = true;
+  InputEvent event;
+  while (inputPop(&sim->input, &event)) {
+    if (first) {
+      state->inputTime = event.time;
+      first = false;
+    }
+    switch (event.type) {
+    case INPUT_PRESS:
+      if (event.action == ACTION_TOGGLE_FLY) {
+        toggleFlying(state);
+      }
+      if (event.action == ACTION_SPAWN) {
+        spawnBurst(sim, state);
+      }
+      sim->held[event.action] = true;
+      break;
+    case INPUT_RELEASE:
+      sim->held[event.action] = false;
+      break;
+    case INPUT_LOOK:
+      cameraTurn(&state->camera, event.dx, event.dy);
+      break;
+    }
+  }
+
+  Camera *camera = &state->camera;
+  if (camera->flying) {
+    float velocity[3];
+    cameraVelocity(camera, sim->held, velocity);
+    for (int i = 0; i < 3; i++) {
+      camera->position[i] += velocity[i] * (float)SIM_TICK;
+    }
+  }
+
+  // Everything reading the world happens in one hold of its lock. The main
+  // thread never waits for it, it only puts off changing the world, so
+  // however many entities there are frames aren't held up. Particles don't
+  // collide, and are moved outside it
+  EntityStore *entities = &sim->entities;
+  moveSystem(entities, (float)SIM_TICK);
+  if (!camera->flying || countBoxes(entities) > 0) {
+    lockWorld(sim);
+    if (!camera->flying) {
+      walk(sim, state);
+    }
+    physicsSystem(entities, sim->scene->world, (float)SIM_TICK);
+    pthread_mutex_unlock(&sim->scene->world->lock);
+  }
+  transformSystem(entities);
+  destroyFallen(entities);
+  cameraEyeTarget(&state->camera, state->eye, state->target);
+}
+
+static void publish(Simulation *sim, const SimState *previous,
+                    double tickSeconds) {
+  SimSnapshot *snapshot = &sim->snapshots[sim->writing];
+  snapshot->previous = *previous;
+  snapshot->current = sim->state;
+  snapshot->tickSeconds = tickSeconds;
+
+  // Only the simulation thread touches the snapshot being written, so its
+  // buffer can grow here
+  const EntityStore *entities = &sim->entities;
+  if (entities->entityCount > snapshot->transformCapacity) {
+    snapshot->transformCapacity = entities->entityCount * 2;
+    snapshot->transforms =
+        realloc(snapshot->transforms,
+                snapshot->transformCapacity * sizeof(*snapshot->transforms));
+  }
+  size_t count = 0;
+  for (int boxes = 1; boxes >= 0; boxes--) {
+    for (int a = 0; a < entities->archetypeCount; a++) {
+      const Archetype *archetype = &entities->archetypes[a];
+      if ((archetype->mask & COMPONENT_TRANSFORM) &&
+          ((archetype->mask & COMPONENT_BOX) != 0) == boxes) {
+        memcpy(snapshot->transforms + count, archetype->transform,
+               archetype->count * sizeof(*archetype->transform));
+        count += archetype->count;
+      }
+    }
+    if (boxes) {
+      snapshot->boxCount = count;
+    }
+  }
+  snapshot->transformCount = count;
+
+  int old = __atomic_exchange_n(&sim->latest, sim->writing | SNAPSHOT_FRESH,
+                                __ATOMIC_ACQ_REL);
+  sim->writing = old & ~SNAPSHOT_FRESH;
+}
+
+static void *simMain(void *arg) {
+  Simulation *sim = arg;
+  profileThreadName("sim");
+
+  double last = timerNow();
+  while (__atomic_load_n(&sim->running, __ATOMIC_ACQUIRE)) {
+    double now = timerNow();
+    sim->accumulator += now - last;
+    last = now;
+
+    if (sim->accumulator > SIM_MAX_LAG) {
+      sim->state.time += sim->accumulator - SIM_TICK;
+      sim->accumulator = SIM_TICK;
+    }
+
+    while (sim->accumulator >= SIM_TICK) {
+      SimState previous = sim->state;
+      double start = profileBegin();
+      sim->worldWait = 0.0;
+      simTick(sim, &sim->state);
+      profileEnd("sim tick", start);
+      profileCount(COUNTER_SIM_TICKS, 1);
+
+      publish(sim, &previous, timerNow() - start - sim->worldWait);
+      sim->accumulator -= SIM_TICK;
+    }
+
+    timerSleep(SIM_TICK - sim->accumulator);
+  }
+  return NULL;
+}
+
+void startSimulation(Simulation *sim, const Scene *scene) {
+  memset(sim, 0, sizeof(*sim));
+  sim->scene = scene;
+
+  initInputQueue(&sim->input);
+  initEntityStore(&sim->entities);
+
+  sim->state.time = timerNow();
+  orbitCamera(scene, 0.0, sim->state.eye, sim->state.target);
+  cameraLookAt(&sim->state.camera, sim->state.eye, sim->state.target);
+  sim->state.camera.flying = true;
+  sim->state.player.halfWidth = PLAYER_HALF_WIDTH;
+  sim->state.player.height = PLAYER_HEIGHT;
+  sim->state.player.stepHeight = PLAYER_STEP_HEIGHT;
+  for (int i = 0; i < 3; i++) {
+    sim->snapshots[i].previous = sim->state;
+    sim->snapshots[i].current = sim->state;
+  }
+  sim->writing = 0;
+  sim->latest = 1;
+  sim->reading = 2;
+
+  sim->running = true;
+  if (pthread_create(&sim->thread, NULL, simMain, sim) != 0) {
+    sim->running = false;
+  }
+}
+
+void stopSimulation(Simulation *sim) {
+  if (sim->running) {
+    __atomic_store_n(&sim->running, false, __ATOMIC_RELEASE);
+    pthread_join(sim->thread, NULL);
+  }
+  freeEntityStore(&sim->entities);
+  for (int i = 0; i < 3; i++) {
+    free(sim->snapshots[i].transforms);
+  }
+}
+
+const SimSnapshot *simLatest(Simulation *sim) {
+  if (__atomic_load_n(&sim->latest, __ATOMIC_ACQUIRE) & SNAPSHOT_FRESH) {
+    sim->reading = __atomic_exchange_n(&sim->latest, sim->reading,
+                                       __ATOMIC_ACQ_REL) &
+                   ~SNAPSHOT_FRESH;
+  }
+  return &sim->snapshots[sim->reading];
+}
+
+const SimSnapshot *simRenderState(Simulation *sim, double now,
+                                  SimState *state) {
+  const SimSnapshot *snapshot = simLatest(sim);
+  const SimState *a = &snapshot->previous, *b = &snapshot->current;
+
+  // The latest tick is reached a tick after it was due
+  float t = (float)((now - b->time) / SIM_TICK);
+  t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+
+  *state = *b;
+  for (int i = 0; i < 3; i++) {
+    state->eye[i] = a->eye[i] + (b->eye[i] - a->eye[i]) * t;
+    state->target[i] = a->target[i] + (b->target[i] - a->target[i]) * t;
+  }
+  return snapshot;
+}
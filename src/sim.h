@@ -0,0 +1,106 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "camera.h"
+#include "entity.h"
+#include "input.h"
+#include "physics.h"
+#include "scene.h"
+
+// Ticks per second. Every tick advances the same amount of time however
+// fast frames are drawn, so the simulation plays out the same every run
+#define SIM_TICK_RATE 60
+#define SIM_TICK (1.0 / SIM_TICK_RATE)
+
+// Falling further behind than this, after a stall, drops the time instead
+// of running every missed tick back to back
+#define SIM_MAX_LAG 0.25
+
+// The walking player's body, in blocks
+#define PLAYER_HALF_WIDTH 0.3f
+#define PLAYER_HEIGHT 1.8f
+#define PLAYER_EYE_HEIGHT 1.62f
+#define PLAYER_STEP_HEIGHT 1.0f // Every block is a full cube
+#define PLAYER_JUMP_SPEED 9.0f  // A little over a block high
+
+// Entities dropped by one press of spawn
+#define SPAWN_MOBS 10
+#define SPAWN_ITEMS 100
+#define SPAWN_PARTICLES 1000
+
+// Spawning stops at these, so ticks stay well inside their time and the
+// world isn't kept locked from the main thread for long. Boxes cost far
+// more than particles, they go through physics
+#define SIM_MAX_ENTITIES 20000
+#define SIM_MAX_BOXES 2000
+
+// What rendering needs from a tick
+typedef struct SimState {
+  uint64_t tick;
+  double time; // timerNow seconds the tick is shown at
+  Camera camera;
+  Body player; // Moved by physics while walking, the camera is at its eyes
+  float eye[3], target[3];
+
+  // When the oldest input the tick used happened. Ticks without input keep
+  // the last one, so rendering sees when it changes
+  double inputTime;
+} SimState;
+
+// Ticks are shown one tick late, blending from the one before, so every
+// snapshot carries both
+typedef struct SimSnapshot {
+  SimState previous, current;
+  double tickSeconds; // How long the tick took, not waiting for the world
+
+  // Model matrices of every entity as of current, the ones with a box
+  // first. Entities aren't blended between ticks
+  float (*transforms)[16];
+  size_t boxCount, transformCount, transformCapacity;
+} SimSnapshot;
+
+// Runs fixed timestep ticks on its own thread. Finished ticks are traded to
+// rendering through three snapshots, one being written, one holding the
+// latest tick and one being read, so neither side ever waits on the other.
+// Ticks read the world with its lock held, which rendering only ever tries
+// when it changes the world, putting the change off to a later frame
+typedef struct Simulation {
+  const Scene *scene;
+  pthread_t thread;
+  bool running;
+
+  SimSnapshot snapshots[3];
+  int writing; // Only the simulation thread touches this
+  int reading; // Only the rendering thread touches this
+  int latest;  // Swapped atomically by both
+
+  // Filled by the window, emptied at the start of every tick
+  InputQueue input;
+
+  // Only the simulation thread touches these
+  SimState state;
+  bool held[ACTION_COUNT];
+  EntityStore entities;
+  double worldWait; // Spent by the tick in progress waiting for the world
+  double accumulator; // Time passed that ticks haven't caught up with yet
+} Simulation;
+
+// Starts ticking from now, from where the orbit camera would start
+void startSimulation(Simulation *sim, const Scene *scene);
+
+// Waits for the tick in progress to finish
+void stopSimulation(Simulation *sim);
+
+// State to draw at time now, blended between the two latest ticks. Returns
+// the snapshot it came from, which stays put until the next call. Never
+// blocks
+const SimSnapshot *simRenderState(Simulation *sim, double now,
+                                  SimState *state);
+
+// The latest finished tick
+const SimSnapshot *simLatest(Simulation *sim);
+
+#endif
@@ -0,0 +1,461 @@
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profiler.h"
+#include "stream.h"
+#include "timer.h"
+
+// Chunks are only unloaded this far past the view distance, so moving back
+// and forth over a chunk border doesn't load and unload the same chunks
+#define UNLOAD_MARGIN 2
+
+// Jobs loads leave free, so unloading chunks can always save them
+#define SAVE_RESERVE 8
+
+// Turning further than this re-sorts the load order, as a cosine
+#define RETARGET_TURN 0.9f
+
+static bool loadJob(StreamJob *job) {
+  ChunkStreamer *streamer = job->streamer;
+  // Only finding the region and copying the chunk out of it needs the lock,
+  // loads decode alongside each other and saves
+  if (streamer->save != NULL) {
+    size_t size;
+    pthread_mutex_lock(&streamer->saveMutex);
+    uint8_t *data =
+        regionCacheRead(streamer->save, job->x, job->y, job->z, &size);
+    pthread_mutex_unlock(&streamer->saveMutex);
+    if (data != NULL) {
+      job->chunk = regionDecodeChunk(job->x, job->y, job->z, data, size);
+      free(data);
+    }
+  }
+
+  // Generating is the slow part, so check again before starting
+  if (job->chunk == NULL &&
+      !__atomic_load_n(&job->cancelled, __ATOMIC_ACQUIRE)) {
+    job->chunk = createChunk(job->x, job->y, job->z);
+    generateChunk(streamer->terrain, job->chunk);
+    job->chunk->modified = true; // Not in the save yet
+    return true;
+  }
+  return false;
+}
+
+static void runStreamJob(Job *job) {
+  StreamJob *streamJob = (StreamJob *)job;
+  ChunkStreamer *streamer = streamJob->streamer;
+
+  switch (streamJob->kind) {
+  case STREAM_LOAD:
+    if (!__atomic_load_n(&streamJob->cancelled, __ATOMIC_ACQUIRE)) {
+      streamJob->generated = loadJob(streamJob);
+    }
+    break;
+  case STREAM_SAVE:
+    pthread_mutex_lock(&streamer->saveMutex);
+    if (!regionCacheSave(streamer->save, streamJob->chunk)) {
+      printf("Failed to save chunk %d %d %d\n", streamJob->x, streamJob->y,
+             streamJob->z);
+    }
+    pthread_mutex_unlock(&streamer->saveMutex);
+    break;
+  case STREAM_FLUSH:
+    pthread_mutex_lock(&streamer->saveMutex);
+    regionCacheFlush(streamer->save);
+    pthread_mutex_unlock(&streamer->saveMutex);
+    break;
+  }
+
+  __atomic_store_n(&streamJob->done, true, __ATOMIC_RELEASE);
+}
+
+void initChunkStreamer(ChunkStreamer *streamer, World *world,
+                       const Terrain *terrain, const char *saveDirectory,
+                       int viewDistance, int worldSize, int worldHeight) {
+  memset(streamer, 0, sizeof(*streamer));
+  streamer->world = world;
+  streamer->terrain = terrain;
+  streamer->viewDistance = viewDistance;
+  streamer->worldSize = worldSize;
+  streamer->worldHeight = worldHeight;
+
+  if (saveDirectory != NULL) {
+    streamer->save = createRegionCache(saveDirectory, REGION_COMPRESS_LZ4);
+  }
+  pthread_mutex_init(&streamer->saveMutex, NULL);
+
+  // Leave most cores to meshing, generation is the only heavy part here
+  int workerCount = cpuCount() > 2 ? cpuCount() / 2 : 1;
+  streamer->pool = createThreadPool(workerCount, STREAM_JOB_COUNT);
+
+  streamer->freeJobCount = STREAM_JOB_COUNT;
+  for (int i = 0; i < STREAM_JOB_COUNT; i++) {
+    streamer->jobs[i].job.run = runStreamJob;
+    streamer->jobs[i].streamer = streamer;
+    streamer->freeJobs[i] = &streamer->jobs[i];
+  }
+
+  // Nothing is loaded until the first update says where the camera is
+  streamer->centerX = streamer->centerZ = INT_MAX;
+  streamer->retarget = true;
+  streamer->lastFlush = timerNow();
+}
+
+void freeChunkStreamer(ChunkStreamer *streamer) {
+  destroyThreadPool(streamer->pool);
+
+  // Jobs that never ran or were never polled still own their chunks
+  for (int i = 0; i < STREAM_JOB_COUNT; i++) {
+    StreamJob *job = &streamer->jobs[i];
+    if (!job->active || job->chunk == NULL) {
+      continue;
+    }
+    if (job->kind == STREAM_SAVE && !job->done) {
+      regionCacheSave(streamer->save, job->chunk);
+    }
+    destroyChunk(job->chunk);
+  }
+
+  if (streamer->save != NULL) {
+    size_t iter = 0;
+    Chunk *chunk;
+    while ((chunk = worldNextChunk(streamer->world, &iter)) != NULL) {
+      if (chunk->modified && !regionCacheSave(streamer->save, chunk)) {
+        printf("Failed to save chunk %d %d %d\n", chunk->x, chunk->y,
+               chunk->z);
+      }
+    }
+    destroyRegionCache(streamer->save);
+  }
+
+  pthread_mutex_destroy(&streamer->saveMutex);
+  free(streamer->targets);
+}
+
+static StreamJob *takeJob(ChunkStreamer *streamer, StreamJobKind kind, int x,
+                          int y, int z) {
+  StreamJob *job = streamer->freeJobs[--streamer->freeJobCount];
+  job->kind = kind;
+  job->x = x;
+  job->y = y;
+  job->z = z;
+  job->chunk = NULL;
+  job->cancelled = false;
+  job->done = false;
+  job->generated = false;
+  job->active = true;
+  return job;
+}
+
+static void releaseJob(ChunkStreamer *streamer, StreamJob *job) {
+  job->active = false;
+  streamer->freeJobs[streamer->freeJobCount++] = job;
+}
+
+static bool submitJob(ChunkStreamer *streamer, StreamJob *job) {
+  if (!threadPoolSubmit(streamer->pool, &job->job)) {
+    releaseJob(streamer, job);
+    return false;
+  }
+  return true;
+}
+
+static const StreamJob *findJob(const ChunkStreamer *streamer,
+                                StreamJobKind kind, int x, int y, int z) {
+  if (streamer->freeJobCount == STREAM_JOB_COUNT) {
+    return NULL;
+  }
+
+  for (int i = 0; i < STREAM_JOB_COUNT; i++) {
+    const StreamJob *job = &streamer->jobs[i];
+    if (job->active && job->kind == kind && !job->cancelled && job->x == x &&
+        job->y == y && job->z == z) {
+      return job;
+    }
+  }
+  return NULL;
+}
+
+static bool inRadius(const ChunkStreamer *streamer, int cx, int cz,
+                     int radius) {
+  int dx = cx - streamer->centerX, dz = cz - streamer->centerZ;
+  return dx * dx + dz * dz <= radius * radius;
+}
+
+bool streamerInRange(const ChunkStreamer *streamer, int cx, int cy, int cz) {
+  if (cy < 0 || cy >= streamer->worldHeight) {
+    return false;
+  }
+  if (streamer->worldSize > 0 &&
+      (cx < 0 || cz < 0 || cx >= streamer->worldSize ||
+       cz >= streamer->worldSize)) {
+    return false;
+  }
+  return inRadius(streamer, cx, cz, streamer->viewDistance);
+}
+
+bool streamerIdle(const ChunkStreamer *streamer) {
+  return !streamer->retarget && streamer->nextTarget == streamer->targetCount &&
+         streamer->freeJobCount == STREAM_JOB_COUNT;
+}
+
+static int compareTargets(const void *a, const void *b) {
+  float x = ((const StreamTarget *)a)->priority;
+  float y = ((const StreamTarget *)b)->priority;
+  return (x > y) - (x < y);
+}
+
+// Lists the missing chunks in range, nearest first, preferring those in
+// front of the camera over those behind it
+static void buildTargets(ChunkStreamer *streamer, int centerY) {
+  int radius = streamer->viewDistance;
+  size_t maxTargets = (size_t)(2 * radius + 1) * (2 * radius + 1) *
+                      (size_t)streamer->worldHeight;
+  if (maxTargets > streamer->targetCapacity) {
+    streamer->targetCapacity = maxTargets;
+    streamer->targets = realloc(streamer->targets,
+                                maxTargets * sizeof(StreamTarget));
+  }
+
+  streamer->targetCount = 0;
+  streamer->nextTarget = 0;
+  for (int dz = -radius; dz <= radius; dz++) {
+    for (int dx = -radius; dx <= radius; dx++) {
+      int x = streamer->centerX + dx, z = streamer->centerZ + dz;
+      if (!streamerInRange(streamer, x, 0, z)) {
+        continue;
+      }
+
+      float flat = sqrtf((float)(dx * dx + dz * dz));
+      float facing =
+          flat > 0.0f
+              ? (dx * streamer->forward[0] + dz * streamer->forward[1]) / flat
+              : 1.0f;
+
+      for (int y = 0; y < streamer->worldHeight; y++) {
+        if (worldGetChunk(streamer->world, x, y, z) != NULL ||
+            findJob(streamer, STREAM_LOAD, x, y, z) != NULL) {
+          continue;
+        }
+
+        int dy = y - centerY;
+        float distance = sqrtf(flat * flat + (float)(dy * dy));
+        StreamTarget *target = &streamer->targets[streamer->targetCount++];
+        target->x = x;
+        target->y = y;
+        target->z = z;
+        target->priority = distance * (1.5f - 0.5f * facing);
+      }
+    }
+  }
+
+  qsort(streamer->targets, streamer->targetCount, sizeof(StreamTarget),
+        compareTargets);
+}
+
+// Drops chunks that are well out of range, saving them first if they
+// changed. Returns false if some had to stay for lack of free jobs
+static bool unloadChunks(ChunkStreamer *streamer) {
+  int radius = streamer->viewDistance + UNLOAD_MARGIN;
+  Chunk **far = NULL;
+  size_t farCount = 0, farCapacity = 0;
+
+  // Removing chunks while iterating would move others past the iterator
+  size_t iter = 0;
+  Chunk *chunk;
+  while ((chunk = worldNextChunk(streamer->world, &iter)) != NULL) {
+    if (inRadius(streamer, chunk->x, chunk->z, radius)) {
+      continue;
+    }
+    if (farCount == farCapacity) {
+      farCapacity = farCapacity ? farCapacity * 2 : 64;
+      far = realloc(far, farCapacity * sizeof(Chunk *));
+    }
+    far[farCount++] = chunk;
+  }
+
+  // Whoever is reading the world has it until they're done, so try again
+  // on a later update
+  if (farCount > 0 && pthread_mutex_trylock(&streamer->world->lock) != 0) {
+    free(far);
+    return false;
+  }
+
+  bool finished = true;
+  for (size_t i = 0; i < farCount; i++) {
+    chunk = far[i];
+    bool save = chunk->modified && streamer->save != NULL;
+    if (save && streamer->freeJobCount == 0) {
+      finished = false;
+      continue;
+    }
+
+    streamer->onUnload(streamer->user, chunk);
+    worldRemoveChunk(streamer->world, chunk->x, chunk->y, chunk->z);
+    streamer->stats.unloaded++;
+
+    if (save) {
+      StreamJob *job =
+          takeJob(streamer, STREAM_SAVE, chunk->x, chunk->y, chunk->z);
+      job->chunk = chunk;
+      if (!submitJob(streamer, job)) {
+        // The pool queue holds every job, so this can't happen
+        destroyChunk(chunk);
+      }
+    } else {
+      destroyChunk(chunk);
+    }
+  }
+  if (farCount > 0) {
+    pthread_mutex_unlock(&streamer->world->lock);
+  }
+
+  free(far);
+  return finished;
+}
+
+// Loads that are no longer wanted skip their work if they haven't started,
+// and their chunks are thrown away when they come back
+static void cancelLoads(ChunkStreamer *streamer) {
+  int radius = streamer->viewDistance + UNLOAD_MARGIN;
+  for (int i = 0; i < STREAM_JOB_COUNT; i++) {
+    StreamJob *job = &streamer->jobs[i];
+    if (job->active && job->kind == STREAM_LOAD && !job->cancelled &&
+        !inRadius(streamer, job->x, job->z, radius)) {
+      __atomic_store_n(&job->cancelled, true, __ATOMIC_RELEASE);
+      streamer->stats.cancelled++;
+    }
+  }
+}
+
+static void finishJobs(ChunkStreamer *streamer) {
+  Job *polled[STREAM_JOB_COUNT];
+  size_t polledCount =
+      threadPoolPoll(streamer->pool, polled,
+                     STREAM_JOB_COUNT - streamer->finishedCount);
+  for (size_t i = 0; i < polledCount; i++) {
+    streamer->finished[streamer->finishedCount++] = (StreamJob *)polled[i];
+  }
+
+  size_t taken;
+  for (taken = 0; taken < streamer->finishedCount; taken++) {
+    StreamJob *job = streamer->finished[taken];
+
+    // Loads go into the world, so while it's locked they and everything
+    // after them wait for a later update
+    bool inserted = false;
+    if (job->kind == STREAM_LOAD && job->chunk != NULL && !job->cancelled) {
+      if (pthread_mutex_trylock(&streamer->world->lock) != 0) {
+        break;
+      }
+      inserted = worldInsertChunk(streamer->world, job->chunk);
+      pthread_mutex_unlock(&streamer->world->lock);
+    }
+
+    switch (job->kind) {
+    case STREAM_LOAD:
+      if (!inserted) {
+        destroyChunk(job->chunk);
+        break;
+      }
+      streamer->stats.loaded++;
+      streamer->stats.generated += job->generated;
+      streamer->onLoad(streamer->user, job->chunk);
+      break;
+    case STREAM_SAVE:
+      destroyChunk(job->chunk);
+      streamer->stats.saved++;
+      streamer->unflushed = true;
+      break;
+    case STREAM_FLUSH:
+      streamer->flushing = false;
+      break;
+    }
+    job->chunk = NULL;
+    releaseJob(streamer, job);
+  }
+
+  streamer->finishedCount -= taken;
+  memmove(streamer->finished, &streamer->finished[taken],
+          streamer->finishedCount * sizeof(StreamJob *));
+}
+
+static void submitLoads(ChunkStreamer *streamer) {
+  while (streamer->nextTarget < streamer->targetCount &&
+         streamer->freeJobCount > SAVE_RESERVE) {
+    const StreamTarget *target = &streamer->targets[streamer->nextTarget++];
+    int x = target->x, y = target->y, z = target->z;
+    if (worldGetChunk(streamer->world, x, y, z) != NULL ||
+        findJob(streamer, STREAM_LOAD, x, y, z) != NULL) {
+      continue;
+    }
+
+    // Loading before the save finishes would read the old chunk back, so
+    // come back to it once the targets are rebuilt
+    if (findJob(streamer, STREAM_SAVE, x, y, z) != NULL) {
+      streamer->retarget = true;
+      continue;
+    }
+
+    submitJob(streamer, takeJob(streamer, STREAM_LOAD, x, y, z));
+  }
+}
+
+void streamerUpdate(ChunkStreamer *streamer, const float eye[3],
+                    const float target[3]) {
+  double zoneStart = profileBegin();
+  finishJobs(streamer);
+
+  int centerX = WORLD_TO_CHUNK((int)floorf(eye[0]));
+  int centerY = WORLD_TO_CHUNK((int)floorf(eye[1]));
+  int centerZ = WORLD_TO_CHUNK((int)floorf(eye[2]));
+  bool moved = centerX != streamer->centerX || centerZ != streamer->centerZ;
+
+  float forward[2] = {target[0] - eye[0], target[2] - eye[2]};
+  float length = sqrtf(forward[0] * forward[0] + forward[1] * forward[1]);
+  bool turned = false;
+  if (length > 0.0f) {
+    forward[0] /= length;
+    forward[1] /= length;
+    turned = forward[0] * streamer->forward[0] +
+                 forward[1] * streamer->forward[1] <
+             RETARGET_TURN;
+  }
+
+  if (moved) {
+    streamer->centerX = centerX;
+    streamer->centerZ = centerZ;
+    cancelLoads(streamer);
+  }
+
+  if (moved || turned || streamer->retarget) {
+    if (length > 0.0f) {
+      streamer->forward[0] = forward[0];
+      streamer->forward[1] = forward[1];
+    }
+
+    // Unloading waits for free jobs when chunks need saving
+    bool unload = moved || streamer->retarget;
+    streamer->retarget = unload && !unloadChunks(streamer);
+    buildTargets(streamer, centerY);
+  }
+
+  submitLoads(streamer);
+
+  // Saved chunks only survive a crash once they are flushed
+  if (streamer->unflushed && !streamer->flushing &&
+      streamer->freeJobCount > 0 &&
+      timerNow() - streamer->lastFlush > STREAM_FLUSH_INTERVAL) {
+    streamer->unflushed = false;
+    streamer->flushing = true;
+    streamer->lastFlush = timerNow();
+    if (!submitJob(streamer, takeJob(streamer, STREAM_FLUSH, 0, 0, 0))) {
+      streamer->flushing = false;
+    }
+  }
+
+  profileEnd("stream chunks", zoneStart);
+}
@@ -0,0 +1,113 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "chunk.h"
+#include "region.h"
+#include "terrain.h"
+#include "threadpool.h"
+#include "world.h"
+
+// Loads, saves and flushes in flight at once
+#define STREAM_JOB_COUNT 64
+
+// Seconds between syncing saved chunks to disk
+#define STREAM_FLUSH_INTERVAL 5.0
+
+typedef enum StreamJobKind {
+  STREAM_LOAD = 0, // Read from the save, or generate if it isn't there
+  STREAM_SAVE,
+  STREAM_FLUSH
+} StreamJobKind;
+
+typedef struct StreamJob {
+  Job job;
+  struct ChunkStreamer *streamer;
+  StreamJobKind kind;
+  int x, y, z;
+  Chunk *chunk; // The chunk loaded, or being saved
+  bool cancelled; // Set from the main thread once the chunk is out of range
+  bool generated; // Loads that weren't in the save
+  bool done;
+  bool active; // Handed to the pool and not polled back yet
+} StreamJob;
+
+typedef struct StreamTarget {
+  int x, y, z;
+  float priority; // Lower loads first
+} StreamTarget;
+
+typedef struct StreamStats {
+  size_t loaded, generated, unloaded, saved, cancelled;
+} StreamStats;
+
+// Keeps the chunks around the camera loaded. Loading, generating and saving
+// all happen on worker threads, the main thread only swaps finished chunks
+// in and out of the world
+typedef struct ChunkStreamer {
+  World *world;
+  const Terrain *terrain;
+
+  // Only touched by workers, and only with saveMutex held
+  RegionCache *save;
+  pthread_mutex_t saveMutex;
+
+  int viewDistance; // Horizontal radius in chunks
+  int worldSize;    // Chunks along x and z from 0, or 0 for no limit
+  int worldHeight;  // Chunks from y = 0 up
+
+  ThreadPool *pool;
+  StreamJob jobs[STREAM_JOB_COUNT];
+  StreamJob *freeJobs[STREAM_JOB_COUNT];
+  int freeJobCount;
+
+  // Jobs back from the pool that haven't been taken in yet, oldest first.
+  // Loads wait here while the world is locked
+  StreamJob *finished[STREAM_JOB_COUNT];
+  size_t finishedCount;
+
+  // Chunks in range that were missing when the camera last moved, best
+  // first. Rebuilt whenever the camera enters a new chunk or turns
+  StreamTarget *targets;
+  size_t targetCount, nextTarget, targetCapacity;
+  int centerX, centerZ;
+  float forward[2];
+  bool retarget;
+
+  bool unflushed;
+  bool flushing;
+  double lastFlush;
+
+  // Called as chunks enter the world, and just before they leave it
+  void (*onLoad)(void *user, Chunk *chunk);
+  void (*onUnload)(void *user, Chunk *chunk);
+  void *user;
+
+  StreamStats stats;
+} ChunkStreamer;
+
+// saveDirectory may be NULL, in which case chunks are always generated and
+// never saved
+void initChunkStreamer(ChunkStreamer *streamer, World *world,
+                       const Terrain *terrain, const char *saveDirectory,
+                       int viewDistance, int worldSize, int worldHeight);
+
+// Waits for running jobs, then saves every modified chunk still in the world
+// on the calling thread
+void freeChunkStreamer(ChunkStreamer *streamer);
+
+// Unloads chunks behind the camera, hands out loads for the nearest missing
+// ones and takes in whatever finished. Never waits on a worker, or on the
+// world's lock, chunks go in and out once it is free
+void streamerUpdate(ChunkStreamer *streamer, const float eye[3],
+                    const float target[3]);
+
+// Whether the chunk should be loaded with the camera where it last was
+bool streamerInRange(const ChunkStreamer *streamer, int cx, int cy, int cz);
+
+// True when every chunk in range is loaded and nothing is in flight
+bool streamerIdle(const ChunkStreamer *streamer);
+
+#endif
@@ -0,0 +1,199 @@
+#include <math.h>
+#include "noise.h"
+#include "profiler.h"
+#include "terrain.h"
+
+// Each noise layer gets its own seed so they don't line up
+#define SALT_CONTINENT 0x3c6ef372u
+#define SALT_HEIGHT 0xa54ff53au
+#define SALT_TEMPERATURE 0x510e527fu
+#define SALT_MOISTURE 0x9b05688cu
+#define SALT_OVERHANG 0x1f83d9abu
+#define SALT_CAVE 0x5be0cd19u
+
+#define SEA_LEVEL 24
+#define SNOW_LINE 62
+#define SURFACE_DEPTH 3
+
+// Overhangs move the surface by at most this many blocks
+#define MAX_OVERHANG 24.0f
+
+// Blocks per column the density is evaluated for, enough to know how deep
+// under the surface the top of the chunk is
+#define COLUMN_SIZE (CHUNK_SIZE + SURFACE_DEPTH + 1)
+
+typedef struct ColumnShape {
+  float height;
+  float roughness; // 0 on flat land, 1 in the mountains
+  Biome biome;
+} ColumnShape;
+
+void initTerrain(Terrain *terrain, uint32_t seed) { terrain->seed = seed; }
+
+// Fractal noise over the x/z plane, normalized to roughly [-1, 1]
+static float fbm2(uint32_t seed, float x, float z, int octaves) {
+  float sum = 0.0f, amplitude = 1.0f, frequency = 1.0f, total = 0.0f;
+  for (int i = 0; i < octaves; i++) {
+    sum += noise3(seed + (uint32_t)i, x * frequency, 0.5f, z * frequency) *
+           amplitude;
+    total += amplitude;
+    amplitude *= 0.5f;
+    frequency *= 2.0f;
+  }
+  return sum / total;
+}
+
+static float smoothstep(float edge0, float edge1, float x) {
+  float t = (x - edge0) / (edge1 - edge0);
+  t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+  return t * t * (3.0f - 2.0f * t);
+}
+
+static ColumnShape columnShape(const Terrain *terrain, int x, int z) {
+  uint32_t seed = terrain->seed;
+  float fx = (float)x, fz = (float)z;
+
+  // Large scale noise decides where the mountains are, and the heightmap
+  // gets rougher towards them so biomes blend without cliffs
+  float continent = fbm2(seed ^ SALT_CONTINENT, fx / 256.0f, fz / 256.0f, 4);
+  float roughness = smoothstep(0.0f, 0.35f, continent);
+  float detail = fbm2(seed ^ SALT_HEIGHT, fx / 96.0f, fz / 96.0f, 5);
+
+  ColumnShape shape;
+  shape.height =
+      SEA_LEVEL + 36.0f * roughness + detail * (6.0f + 30.0f * roughness);
+  shape.roughness = roughness;
+
+  float temperature =
+      fbm2(seed ^ SALT_TEMPERATURE, fx / 400.0f, fz / 400.0f, 3);
+  float moisture = fbm2(seed ^ SALT_MOISTURE, fx / 400.0f, fz / 400.0f, 3);
+
+  if (roughness > 0.6f) {
+    shape.biome = BIOME_MOUNTAINS;
+  } else if (temperature > 0.15f && moisture < 0.0f) {
+    shape.biome = BIOME_DESERT;
+  } else if (roughness > 0.2f) {
+    shape.biome = BIOME_HILLS;
+  } else {
+    shape.biome = BIOME_PLAINS;
+  }
+
+  return shape;
+}
+
+int terrainHeight(const Terrain *terrain, int x, int z) {
+  return (int)floorf(columnShape(terrain, x, z).height);
+}
+
+Biome terrainBiome(const Terrain *terrain, int x, int z) {
+  return columnShape(terrain, x, z).biome;
+}
+
+static BlockId surfaceBlock(Biome biome, int y) {
+  switch (biome) {
+  case BIOME_DESERT:
+    return BLOCK_SAND;
+  case BIOME_MOUNTAINS:
+    return y >= SNOW_LINE ? BLOCK_SNOW : BLOCK_STONE;
+  default:
+    return BLOCK_GRASS;
+  }
+}
+
+static BlockId fillerBlock(Biome biome) {
+  switch (biome) {
+  case BIOME_DESERT:
+    return BLOCK_SAND;
+  case BIOME_MOUNTAINS:
+    return BLOCK_STONE;
+  default:
+    return BLOCK_DIRT;
+  }
+}
+
+static void generateColumn(const Terrain *terrain, const Chunk *chunk,
+                           const ColumnShape *shape, int x, int z,
+                           BlockId *blocks) {
+  int worldX = chunk->x * CHUNK_SIZE + x;
+  int worldZ = chunk->z * CHUNK_SIZE + z;
+  int originY = chunk->y * CHUNK_SIZE;
+  float fx = (float)worldX, fz = (float)worldZ, fy = (float)originY;
+
+  // The whole column of 3D noise at once, so the SIMD backends can work
+  // through it several blocks at a time
+  float overhang[COLUMN_SIZE], overhangDetail[COLUMN_SIZE], cave[COLUMN_SIZE];
+  noise3Column(terrain->seed ^ SALT_OVERHANG, fx / 32.0f, fz / 32.0f,
+               fy / 24.0f, 1.0f / 24.0f, COLUMN_SIZE, overhang);
+  noise3Column((terrain->seed ^ SALT_OVERHANG) + 1, fx / 16.0f, fz / 16.0f,
+               fy / 12.0f, 1.0f / 12.0f, COLUMN_SIZE, overhangDetail);
+  noise3Column(terrain->seed ^ SALT_CAVE, fx / 28.0f, fz / 28.0f, fy / 18.0f,
+               1.0f / 18.0f, COLUMN_SIZE, cave);
+
+  float overhangAmount = 3.0f + (MAX_OVERHANG - 3.0f) * shape->roughness;
+
+  bool solid[COLUMN_SIZE];
+  for (int i = 0; i < COLUMN_SIZE; i++) {
+    int worldY = originY + i;
+    float density = shape->height - (float)worldY +
+                    (overhang[i] + 0.5f * overhangDetail[i]) * overhangAmount;
+
+    bool inCave = fabsf(cave[i]) < 0.06f && worldY > 2 &&
+                  (float)worldY < shape->height - 4.0f;
+    solid[i] = (density > 0.0f && !inCave) || worldY <= 0;
+  }
+
+  for (int y = 0; y < CHUNK_SIZE; y++) {
+    BlockId block = BLOCK_AIR;
+
+    if (solid[y]) {
+      // How far below open air this block is decides what it's made of
+      int depth = 1;
+      while (depth <= SURFACE_DEPTH && solid[y + depth]) {
+        depth++;
+      }
+
+      if (depth == 1) {
+        block = surfaceBlock(shape->biome, originY + y);
+      } else if (depth <= SURFACE_DEPTH) {
+        block = fillerBlock(shape->biome);
+      } else {
+        block = BLOCK_STONE;
+      }
+    }
+
+    blocks[CHUNK_INDEX(x, y, z)] = block;
+  }
+}
+
+void generateChunk(const Terrain *terrain, Chunk *chunk) {
+  double start = profileBegin();
+  ColumnShape shapes[CHUNK_SIZE * CHUNK_SIZE];
+  float highest = -INFINITY;
+
+  for (int z = 0; z < CHUNK_SIZE; z++) {
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+      ColumnShape *shape = &shapes[x + z * CHUNK_SIZE];
+      *shape = columnShape(terrain, chunk->x * CHUNK_SIZE + x,
+                           chunk->z * CHUNK_SIZE + z);
+      highest = fmaxf(highest, shape->height);
+    }
+  }
+
+  // Nothing can reach up into this chunk, so skip the 3D noise
+  if ((float)(chunk->y * CHUNK_SIZE) > highest + MAX_OVERHANG * 1.5f) {
+    chunkFill(chunk, BLOCK_AIR);
+    profileEnd("generate chunk", start);
+    return;
+  }
+
+  // Packed in one go once the palette is known
+  BlockId blocks[CHUNK_VOLUME];
+  for (int z = 0; z < CHUNK_SIZE; z++) {
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+      generateColumn(terrain, chunk, &shapes[x + z * CHUNK_SIZE], x, z,
+                     blocks);
+    }
+  }
+  chunkSetBlocks(chunk, blocks);
+  profileEnd("generate chunk", start);
+}
@@ -0,0 +1,31 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <stdint.h>
+#include "chunk.h"
+
+typedef enum Biome {
+  BIOME_PLAINS = 0,
+  BIOME_HILLS,
+  BIOME_DESERT,
+  BIOME_MOUNTAINS,
+  BIOME_COUNT
+} Biome;
+
+// Everything generation depends on. The same seed always generates the
+// same world
+typedef struct Terrain {
+  uint32_t seed;
+} Terrain;
+
+void initTerrain(Terrain *terrain, uint32_t seed);
+
+// Height of the heightmap at a column, before caves and overhangs
+int terrainHeight(const Terrain *terrain, int x, int z);
+
+Biome terrainBiome(const Terrain *terrain, int x, int z);
+
+// Fill a chunk based on its world position. Safe to call from any thread
+void generateChunk(const Terrain *terrain, Chunk *chunk);
+
+#endif
@@ -0,0 +1,142 @@
+#include <dirent.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glad/glad.h>
+#include <stb_image.h>
+#include "block.h"
+#include "texture.h"
+
+// Used when no tile has a texture file
+#define DEFAULT_TILE_SIZE 16
+
+typedef struct TileImage {
+  unsigned char *pixels; // RGBA
+  int width, height;
+} TileImage;
+
+// Tile with the same name as the file, without its .png extension
+static int findTile(const char *fileName) {
+  const char *extension = strrchr(fileName, '.');
+  if (extension == NULL || strcmp(extension, ".png") != 0) {
+    return -1;
+  }
+
+  size_t length = (size_t)(extension - fileName);
+  for (int i = 0; i < TILE_COUNT; i++) {
+    if (strlen(tileInfo[i].name) == length &&
+        strncmp(tileInfo[i].name, fileName, length) == 0) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+// Nearest neighbour, so tiles of different sizes fit in one array
+static void scaleImage(const TileImage *image, unsigned char *dest, int size) {
+  for (int y = 0; y < size; y++) {
+    int sourceY = y * image->height / size;
+    for (int x = 0; x < size; x++) {
+      int sourceX = x * image->width / size;
+      memcpy(&dest[(x + y * size) * 4],
+             &image->pixels[(sourceX + sourceY * image->width) * 4], 4);
+    }
+  }
+}
+
+// Stand in for a missing texture, the tile's color with a little noise
+static void fillTileColor(const TileInfo *tile, unsigned char *dest,
+                          int size) {
+  int pixelSize = size / DEFAULT_TILE_SIZE > 0 ? size / DEFAULT_TILE_SIZE : 1;
+
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      unsigned int h = (unsigned int)(x / pixelSize) * 73856093u ^
+                       (unsigned int)(y / pixelSize) * 19349663u;
+      h = (h ^ (h >> 13)) * 1274126177u;
+      float shade = 0.9f + (float)(h >> 24) / 255.0f * 0.2f;
+
+      unsigned char *pixel = &dest[(x + y * size) * 4];
+      for (int c = 0; c < 3; c++) {
+        float value = tile->color[c] * shade;
+        pixel[c] = (unsigned char)(value > 255.0f ? 255.0f : value);
+      }
+      pixel[3] = 255;
+    }
+  }
+}
+
+unsigned int loadBlockTextures(const char *directory) {
+  TileImage images[TILE_COUNT];
+  memset(images, 0, sizeof(images));
+
+  DIR *dir = opendir(directory);
+  if (dir == NULL) {
+    printf("Failed to open texture directory %s\n", directory);
+  } else {
+    stbi_set_flip_vertically_on_load(true);
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+      int tile = findTile(entry->d_name);
+      if (tile < 0) {
+        continue;
+      }
+
+      char path[1024];
+      snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+
+      TileImage *image = &images[tile];
+      int channels;
+      image->pixels =
+          stbi_load(path, &image->width, &image->height, &channels, 4);
+      if (image->pixels == NULL) {
+        printf("Failed to load texture %s\n", path);
+      }
+    }
+
+    closedir(dir);
+  }
+
+  // Every layer has the size of the largest texture
+  int size = DEFAULT_TILE_SIZE;
+  for (int i = 0; i < TILE_COUNT; i++) {
+    if (images[i].pixels != NULL) {
+      size = images[i].width > size ? images[i].width : size;
+      size = images[i].height > size ? images[i].height : size;
+    }
+  }
+
+  unsigned int texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, size, size, TILE_COUNT, 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+  unsigned char *layer = malloc((size_t)size * size * 4);
+  for (int i = 0; i < TILE_COUNT; i++) {
+    if (images[i].pixels != NULL) {
+      scaleImage(&images[i], layer, size);
+      stbi_image_free(images[i].pixels);
+    } else {
+      fillTileColor(&tileInfo[i], layer, size);
+    }
+
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, size, size, 1, GL_RGBA,
+                    GL_UNSIGNED_BYTE, layer);
+  }
+  free(layer);
+
+  // Layers never sample each other, so there is no bleeding between tiles
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+  return texture;
+}
@@ -0,0 +1,9 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+// Loads the block tiles from a directory into a single GL_TEXTURE_2D_ARRAY,
+// with one layer per tile in tile order. Every PNG in the directory named
+// after a tile is used, so the whole world renders with one texture bind
+unsigned int loadBlockTextures(const char *directory);
+
+#endif
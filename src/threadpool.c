@@ -0,0 +1,125 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#include <stdlib.h>
+#include "profiler.h"
+#include "threadpool.h"
+
+int cpuCount(void) {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  int count = (int)info.dwNumberOfProcessors;
+#else
+  int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  return count > 0 ? count : 1;
+}
+
+static void yieldThread(void) {
+#ifdef _WIN32
+  SwitchToThread();
+#else
+  sched_yield();
+#endif
+}
+
+static void *workerMain(void *arg) {
+  ThreadPool *pool = arg;
+  profileThreadName("worker");
+
+  for (;;) {
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->queued == 0 && !pool->stopping) {
+      pthread_cond_wait(&pool->wake, &pool->mutex);
+    }
+    if (pool->stopping) {
+      pthread_mutex_unlock(&pool->mutex);
+      break;
+    }
+    pool->queued--;
+    pthread_mutex_unlock(&pool->mutex);
+
+    // The job was pushed before queued was raised, so it is there
+    void *data;
+    while (!atomicQueuePop(&pool->jobs, &data)) {
+      yieldThread();
+    }
+
+    Job *job = data;
+    job->run(job);
+
+    // Wait for the owner to drain completed jobs rather than lose one,
+    // unless the pool is going away
+    while (!atomicQueuePush(&pool->completed, job) &&
+           !__atomic_load_n(&pool->stopping, __ATOMIC_ACQUIRE)) {
+      yieldThread();
+    }
+  }
+
+  return NULL;
+}
+
+ThreadPool *createThreadPool(int threadCount, size_t capacity) {
+  ThreadPool *pool = calloc(1, sizeof(ThreadPool));
+
+  // Room for every queued job plus one in flight per worker
+  initAtomicQueue(&pool->jobs, capacity);
+  initAtomicQueue(&pool->completed, capacity + threadCount);
+
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+
+  pool->threads = malloc(threadCount * sizeof(pthread_t));
+  for (int i = 0; i < threadCount; i++) {
+    if (pthread_create(&pool->threads[i], NULL, workerMain, pool) != 0) {
+      break;
+    }
+    pool->threadCount++;
+  }
+
+  return pool;
+}
+
+void destroyThreadPool(ThreadPool *pool) {
+  pthread_mutex_lock(&pool->mutex);
+  __atomic_store_n(&pool->stopping, true, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for (int i = 0; i < pool->threadCount; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->mutex);
+  freeAtomicQueue(&pool->jobs);
+  freeAtomicQueue(&pool->completed);
+  free(pool->threads);
+  free(pool);
+}
+
+bool threadPoolSubmit(ThreadPool *pool, Job *job) {
+  if (!atomicQueuePush(&pool->jobs, job)) {
+    return false;
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->queued++;
+  pthread_cond_signal(&pool->wake);
+  pthread_mutex_unlock(&pool->mutex);
+  return true;
+}
+
+size_t threadPoolPoll(ThreadPool *pool, Job **jobs, size_t max) {
+  size_t count = 0;
+  void *data;
+  while (count < max && atomicQueuePop(&pool->completed, &data)) {
+    jobs[count++] = data;
+  }
+  return count;
+}
@@ -0,0 +1,43 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "queue.h"
+
+// Embed as the first member of a job struct. run is called on a worker
+// thread, then the job is handed back through threadPoolPoll
+typedef struct Job {
+  void (*run)(struct Job *job);
+} Job;
+
+typedef struct ThreadPool {
+  pthread_t *threads;
+  int threadCount;
+
+  AtomicQueue jobs;
+  AtomicQueue completed;
+
+  // Only guards sleeping and waking workers, never held while a job runs
+  pthread_mutex_t mutex;
+  pthread_cond_t wake;
+  size_t queued;
+  bool stopping;
+} ThreadPool;
+
+// Number of logical processors, at least 1
+int cpuCount(void);
+
+ThreadPool *createThreadPool(int threadCount, size_t capacity);
+
+// Waits for running jobs, jobs still queued or completed are dropped
+void destroyThreadPool(ThreadPool *pool);
+
+// Never blocks, returns false if the queue is full
+bool threadPoolSubmit(ThreadPool *pool, Job *job);
+
+// Never blocks, returns up to max finished jobs
+size_t threadPoolPoll(ThreadPool *pool, Job **jobs, size_t max);
+
+#endif
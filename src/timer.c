@@ -0,0 +1,35 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#define _POSIX_C_SOURCE 199309L
+#include <time.h>
+#endif
+
+#include "timer.h"
+
+double timerNow(void) {
+#ifdef _WIN32
+  LARGE_INTEGER frequency, counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+void timerSleep(double seconds) {
+  if (seconds <= 0.0) {
+    return;
+  }
+#ifdef _WIN32
+  Sleep((DWORD)(seconds * 1000.0));
+#else
+  struct timespec ts;
+  ts.tv_sec = (time_t)seconds;
+  ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+  nanosleep(&ts, NULL);
+#endif
+}
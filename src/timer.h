@@ -0,0 +1,10 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+// Monotonic time in seconds. Unlike glfwGetTime this works without a window
+double timerNow(void);
+
+// Sleeps the calling thread for about that long
+void timerSleep(double seconds);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef VERTEX_H
+#define VERTEX_H
+
+#include <stdint.h>
+
+// Chunk mesh vertex packed into 8 bytes, decoded in vertex.vs
+//
+// data0: x:5 y:5 z:5 normal:3 ao:2 sky:4 block:4 (4 bits unused)
+// data1: tile:16 (16 bits unused)
+//
+// Positions are chunk local corners in [0, CHUNK_SIZE], normal is a
+// BlockFace and ao is 3 for a fully lit corner. Sky and block are the light
+// levels in front of the face. Texture coordinates are derived from the
+// position and normal in the shader
+typedef struct PackedVertex {
+  uint32_t data0;
+  uint32_t data1;
+} PackedVertex;
+
+// Every field of a packed vertex, for the CPU side
+typedef struct VertexFields {
+  int x, y, z;
+  int normal;
+  int ao;
+  int skyLight, blockLight;
+  int tile;
+} VertexFields;
+
+#define VERTEX_POSITION_BITS 5
+#define VERTEX_POSITION_MASK ((1u << VERTEX_POSITION_BITS) - 1)
+#define VERTEX_Y_SHIFT 5
+#define VERTEX_Z_SHIFT 10
+#define VERTEX_NORMAL_SHIFT 15
+#define VERTEX_NORMAL_MASK 7u
+#define VERTEX_AO_SHIFT 18
+#define VERTEX_AO_MASK 3u
+#define VERTEX_SKY_SHIFT 20
+#define VERTEX_BLOCK_SHIFT 24
+#define VERTEX_LIGHT_MASK 15u
+#define VERTEX_TILE_MASK 0xffffu
+
+static inline PackedVertex packVertex(const VertexFields *fields) {
+  uint32_t data0 = (uint32_t)fields->x & VERTEX_POSITION_MASK;
+  data0 |= ((uint32_t)fields->y & VERTEX_POSITION_MASK) << VERTEX_Y_SHIFT;
+  data0 |= ((uint32_t)fields->z & VERTEX_POSITION_MASK) << VERTEX_Z_SHIFT;
+  data0 |= ((uint32_t)fields->normal & VERTEX_NORMAL_MASK)
+           << VERTEX_NORMAL_SHIFT;
+  data0 |= ((uint32_t)fields->ao & VERTEX_AO_MASK) << VERTEX_AO_SHIFT;
+  data0 |= ((uint32_t)fields->skyLight & VERTEX_LIGHT_MASK)
+           << VERTEX_SKY_SHIFT;
+  data0 |= ((uint32_t)fields->blockLight & VERTEX_LIGHT_MASK)
+           << VERTEX_BLOCK_SHIFT;
+
+  PackedVertex vertex;
+  vertex.data0 = data0;
+  vertex.data1 = (uint32_t)fields->tile & VERTEX_TILE_MASK;
+  return vertex;
+}
+
+static inline VertexFields unpackVertex(PackedVertex vertex) {
+  uint32_t data0 = vertex.data0;
+
+  VertexFields fields;
+  fields.x = (int)(data0 & VERTEX_POSITION_MASK);
+  fields.y = (int)(data0 >> VERTEX_Y_SHIFT & VERTEX_POSITION_MASK);
+  fields.z = (int)(data0 >> VERTEX_Z_SHIFT & VERTEX_POSITION_MASK);
+  fields.normal = (int)(data0 >> VERTEX_NORMAL_SHIFT & VERTEX_NORMAL_MASK);
+  fields.ao = (int)(data0 >> VERTEX_AO_SHIFT & VERTEX_AO_MASK);
+  fields.skyLight = (int)(data0 >> VERTEX_SKY_SHIFT & VERTEX_LIGHT_MASK);
+  fields.blockLight = (int)(data0 >> VERTEX_BLOCK_SHIFT & VERTEX_LIGHT_MASK);
+  fields.tile = (int)(vertex.data1 & VERTEX_TILE_MASK);
+  return fields;
+}
+
+#endif
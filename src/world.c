@@ -0,0 +1,154 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "world.h"
+
+#define WORLD_INITIAL_CAPACITY 256
+
+static size_t findSlot(const World *world, int x, int y, int z) {
+  size_t mask = world->capacity - 1;
+  size_t i = chunkHash(x, y, z) & mask;
+
+  while (world->slots[i] != NULL) {
+    Chunk *chunk = world->slots[i];
+    if (chunk->x == x && chunk->y == y && chunk->z == z) {
+      break;
+    }
+    i = (i + 1) & mask;
+  }
+
+  return i;
+}
+
+static void growWorld(World *world) {
+  Chunk **oldSlots = world->slots;
+  size_t oldCapacity = world->capacity;
+
+  world->capacity = oldCapacity * 2;
+  world->slots = calloc(world->capacity, sizeof(Chunk *));
+
+  for (size_t i = 0; i < oldCapacity; i++) {
+    Chunk *chunk = oldSlots[i];
+    if (chunk != NULL) {
+      world->slots[findSlot(world, chunk->x, chunk->y, chunk->z)] = chunk;
+    }
+  }
+
+  free(oldSlots);
+}
+
+World *createWorld(void) {
+  World *world = calloc(1, sizeof(World));
+  world->capacity = WORLD_INITIAL_CAPACITY;
+  world->slots = calloc(world->capacity, sizeof(Chunk *));
+  pthread_mutex_init(&world->lock, NULL);
+  return world;
+}
+
+void destroyWorld(World *world) {
+  for (size_t i = 0; i < world->capacity; i++) {
+    destroyChunk(world->slots[i]);
+  }
+
+  free(world->slots);
+  pthread_mutex_destroy(&world->lock);
+  free(world);
+}
+
+Chunk *worldGetChunk(const World *world, int cx, int cy, int cz) {
+  return world->slots[findSlot(world, cx, cy, cz)];
+}
+
+bool worldInsertChunk(World *world, Chunk *chunk) {
+  // Keep the load factor under one half so probe sequences stay short
+  if ((world->chunkCount + 1) * 2 > world->capacity) {
+    growWorld(world);
+  }
+
+  size_t i = findSlot(world, chunk->x, chunk->y, chunk->z);
+  if (world->slots[i] != NULL) {
+    return false;
+  }
+
+  world->slots[i] = chunk;
+  world->chunkCount++;
+  return true;
+}
+
+Chunk *worldCreateChunk(World *world, int cx, int cy, int cz) {
+  Chunk *chunk = worldGetChunk(world, cx, cy, cz);
+  if (chunk != NULL) {
+    return chunk;
+  }
+
+  chunk = createChunk(cx, cy, cz);
+  worldInsertChunk(world, chunk);
+  return chunk;
+}
+
+Chunk *worldRemoveChunk(World *world, int cx, int cy, int cz) {
+  size_t mask = world->capacity - 1;
+  size_t i = findSlot(world, cx, cy, cz);
+  Chunk *removed = world->slots[i];
+  if (removed == NULL) {
+    return NULL;
+  }
+
+  // Backward shift deletion, so lookups never need tombstones
+  size_t j = i;
+  for (;;) {
+    j = (j + 1) & mask;
+    Chunk *chunk = world->slots[j];
+    if (chunk == NULL) {
+      break;
+    }
+
+    size_t home = chunkHash(chunk->x, chunk->y, chunk->z) & mask;
+    // Move the entry back if its home slot is not between i and j
+    if ((j > i && (home <= i || home > j)) ||
+        (j < i && (home <= i && home > j))) {
+      world->slots[i] = chunk;
+      i = j;
+    }
+  }
+
+  world->slots[i] = NULL;
+  world->chunkCount--;
+  return removed;
+}
+
+BlockId worldGetBlock(const World *world, int x, int y, int z) {
+  Chunk *chunk = worldGetChunk(world, WORLD_TO_CHUNK(x), WORLD_TO_CHUNK(y),
+                               WORLD_TO_CHUNK(z));
+  if (chunk == NULL) {
+    return BLOCK_AIR;
+  }
+
+  return chunkGetBlock(chunk, WORLD_TO_LOCAL(x), WORLD_TO_LOCAL(y),
+                       WORLD_TO_LOCAL(z));
+}
+
+void worldSetBlock(World *world, int x, int y, int z, BlockId block) {
+  int cx = WORLD_TO_CHUNK(x), cy = WORLD_TO_CHUNK(y), cz = WORLD_TO_CHUNK(z);
+
+  Chunk *chunk = worldGetChunk(world, cx, cy, cz);
+  if (chunk == NULL) {
+    if (block == BLOCK_AIR) {
+      return;
+    }
+    chunk = worldCreateChunk(world, cx, cy, cz);
+  }
+
+  chunkSetBlock(chunk, WORLD_TO_LOCAL(x), WORLD_TO_LOCAL(y), WORLD_TO_LOCAL(z),
+                block);
+}
+
+Chunk *worldNextChunk(const World *world, size_t *iter) {
+  while (*iter < world->capacity) {
+    Chunk *chunk = world->slots[(*iter)++];
+    if (chunk != NULL) {
+      return chunk;
+    }
+  }
+
+  return NULL;
+}
@@ -0,0 +1,53 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "block.h"
+#include "chunk.h"
+
+// Convert a world block coordinate to a chunk coordinate and back
+#define WORLD_TO_CHUNK(v) ((v) >> CHUNK_SHIFT)
+#define WORLD_TO_LOCAL(v) ((v) & CHUNK_MASK)
+
+// Open addressing hash map of chunks keyed on chunk coordinates
+typedef struct World {
+  Chunk **slots;
+  size_t capacity; // Always a power of two
+  size_t chunkCount;
+
+  // Held while chunks go in or out and while blocks change, and by other
+  // threads for as long as they read the world. The thread that changes it
+  // only ever tries it, putting the change off when it's taken, so readers
+  // never hold up the owner
+  pthread_mutex_t lock;
+} World;
+
+World *createWorld(void);
+
+// Destroys the world and every chunk it owns
+void destroyWorld(World *world);
+
+Chunk *worldGetChunk(const World *world, int cx, int cy, int cz);
+
+// Returns the existing chunk at the coordinates, creating an empty one if
+// there is none
+Chunk *worldCreateChunk(World *world, int cx, int cy, int cz);
+
+// Takes ownership of a chunk. Fails if a chunk already exists at its position
+bool worldInsertChunk(World *world, Chunk *chunk);
+
+// Removes the chunk from the world and hands ownership back to the caller
+Chunk *worldRemoveChunk(World *world, int cx, int cy, int cz);
+
+// Blocks in chunks that don't exist are air
+BlockId worldGetBlock(const World *world, int x, int y, int z);
+
+// Creates the chunk if needed, unless the block is air
+void worldSetBlock(World *world, int x, int y, int z, BlockId block);
+
+// Iterate over every chunk, start with *iter = 0
+Chunk *worldNextChunk(const World *world, size_t *iter);
+
+#endif
@@ -0,0 +1,109 @@
+#include <string.h>
+#include "chunk.h"
+#include "tests.h"
+
+// Width the chunk should pack to with this many different blocks in it
+static int expectedBits(int distinct) {
+  if (distinct <= 1) {
+    return 0;
+  }
+  if (distinct <= 2) {
+    return 1;
+  }
+  if (distinct <= 4) {
+    return 2;
+  }
+  if (distinct <= 16) {
+    return 4;
+  }
+  return distinct <= 256 ? 8 : 16;
+}
+
+// Positions spread over the chunk, 211 shares no factor with its volume so
+// the first CHUNK_VOLUME are all different
+static int spread(int n) { return n * 211 % CHUNK_VOLUME; }
+
+static void setBoth(Chunk *chunk, BlockId *expected, int i, BlockId block) {
+  chunkSetBlock(chunk, i & CHUNK_MASK, i >> (2 * CHUNK_SHIFT),
+                (i >> CHUNK_SHIFT) & CHUNK_MASK, block);
+  expected[i] = block;
+}
+
+// Whole chunk and single block reads both match, at the width expected
+static int checkChunk(const Chunk *chunk, const BlockId *expected, int bits,
+                      const char *stage) {
+  int failures = 0;
+  CHECK(chunk->bits == bits);
+
+  BlockId blocks[CHUNK_VOLUME];
+  chunkGetBlocks(chunk, blocks);
+  CHECK(memcmp(blocks, expected, sizeof(blocks)) == 0);
+  for (int i = 0; i < CHUNK_VOLUME; i++) {
+    if (chunkGetBlock(chunk, i & CHUNK_MASK, i >> (2 * CHUNK_SHIFT),
+                      (i >> CHUNK_SHIFT) & CHUNK_MASK) != expected[i]) {
+      CHECK(!"chunkGetBlock matches");
+      break;
+    }
+  }
+
+  if (failures > 0) {
+    printf("  %s, %d bits\n", stage, chunk->bits);
+  }
+  return failures;
+}
+
+int testChunkPalette(void) {
+  int failures = 0;
+  Chunk *chunk = createChunk(0, 0, 0);
+  BlockId expected[CHUNK_VOLUME];
+  for (int i = 0; i < CHUNK_VOLUME; i++) {
+    expected[i] = BLOCK_AIR;
+  }
+  failures += checkChunk(chunk, expected, 0, "new chunk");
+  CHECK(chunkIsUniform(chunk));
+
+  // Widening one block at a time, through every width to BlockIds stored
+  // directly
+  for (int n = 1; n <= 300 && failures == 0; n++) {
+    setBoth(chunk, expected, spread(n), (BlockId)n);
+    failures += checkChunk(chunk, expected, expectedBits(n + 1), "widening");
+  }
+
+  // Single blocks never narrow BlockIds stored directly, replacing the
+  // whole chunk does
+  for (int i = 0; i < CHUNK_VOLUME; i++) {
+    setBoth(chunk, expected, i, BLOCK_STONE);
+  }
+  failures += checkChunk(chunk, expected, 16, "all stone, one at a time");
+  chunkSetBlocks(chunk, expected);
+  failures += checkChunk(chunk, expected, 0, "all stone, replaced");
+  CHECK(chunkIsUniform(chunk));
+
+  // A full palette repacks when another block comes in, dropping blocks
+  // overwritten since and narrowing if that leaves few enough
+  for (int n = 1; n < 16; n++) {
+    setBoth(chunk, expected, spread(n), (BlockId)(100 + n));
+  }
+  failures += checkChunk(chunk, expected, 4, "16 blocks");
+  for (int n = 3; n < 16; n++) {
+    setBoth(chunk, expected, spread(n), BLOCK_STONE);
+  }
+  setBoth(chunk, expected, spread(3), 200);
+  failures += checkChunk(chunk, expected, 2, "repacked to 4 blocks");
+
+  setBoth(chunk, expected, spread(1), BLOCK_STONE);
+  setBoth(chunk, expected, spread(2), BLOCK_STONE);
+  setBoth(chunk, expected, spread(3), BLOCK_STONE);
+  setBoth(chunk, expected, spread(4), 201);
+  failures += checkChunk(chunk, expected, 1, "repacked to 2 blocks");
+
+  // And back to a single block
+  setBoth(chunk, expected, spread(4), BLOCK_STONE);
+  chunkSetBlocks(chunk, expected);
+  failures += checkChunk(chunk, expected, 0, "back to uniform");
+  CHECK(chunkIsUniform(chunk));
+  CHECK(chunkMemoryUsage(chunk) < sizeof(Chunk) + 64);
+
+  destroyChunk(chunk);
+  return failures;
+}
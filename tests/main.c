@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <string.h>
+#include "tests.h"
+
+typedef struct Test {
+  const char *name;
+  int (*run)(void);
+} Test;
+
+static const Test tests[] = {
+    {"vertex", testVertexRoundTrip},
+    {"world", testWorldBlocks},
+    {"palette", testChunkPalette},
+    {"meshstate", testMeshStates},
+    {"region", testRegionFiles},
+};
+
+#define TEST_COUNT (int)(sizeof(tests) / sizeof(tests[0]))
+
+// Runs every test, or the one named, and exits 1 if any check failed
+int main(int argc, char **argv) {
+  const char *only = argc > 1 ? argv[1] : NULL;
+  int failed = 0, ran = 0;
+  for (int i = 0; i < TEST_COUNT; i++) {
+    if (only != NULL && strcmp(only, tests[i].name) != 0) {
+      continue;
+    }
+    int failures = tests[i].run();
+    printf("%-12s %s\n", tests[i].name, failures == 0 ? "ok" : "FAILED");
+    failed += failures > 0;
+    ran++;
+  }
+
+  if (ran == 0) {
+    printf("Unknown test %s\n", only);
+    return 2;
+  }
+  printf("%d of %d tests failed\n", failed, ran);
+  return failed > 0 ? 1 : 0;
+}
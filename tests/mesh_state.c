@@ -0,0 +1,80 @@
+#include "mesh_state.h"
+#include "tests.h"
+
+// Chunks from -8 to 7 on every axis, enough to grow the table a few times
+#define TEST_MIN -8
+#define TEST_MAX 8
+
+static bool isOdd(int x, int y, int z) { return (x + y + z) & 1; }
+
+static uint32_t drawIdFor(int x, int y, int z) {
+  return (uint32_t)(x * 3 + y * 5 + z * 7);
+}
+
+// Every entry is found with the values it was given, and removed ones are
+// gone. Stops at the first one that isn't right
+static int checkStates(const MeshStates *states, bool removed) {
+  int failures = 0;
+  for (int y = TEST_MIN; y < TEST_MAX; y++) {
+    for (int z = TEST_MIN; z < TEST_MAX; z++) {
+      for (int x = TEST_MIN; x < TEST_MAX; x++) {
+        const MeshState *state = meshStatesGet(states, x, y, z);
+        bool gone = removed && isOdd(x, y, z);
+        bool found = state != NULL && state->x == x && state->y == y &&
+                     state->z == z && state->drawId == drawIdFor(x, y, z);
+        if (gone ? state != NULL : !found) {
+          printf("  chunk %d %d %d\n", x, y, z);
+          CHECK(gone ? state == NULL : found);
+          return failures;
+        }
+      }
+    }
+  }
+  return failures;
+}
+
+int testMeshStates(void) {
+  int failures = 0;
+  MeshStates states;
+  initMeshStates(&states);
+
+  // New entries have no mesh and nothing queued
+  MeshState *state = meshStatesAdd(&states, 1, 2, 3);
+  CHECK(state->drawId == UINT32_MAX && !state->meshQueued && !state->meshDirty);
+  state->meshQueued = true;
+  CHECK(meshStatesAdd(&states, 1, 2, 3)->meshQueued);
+  CHECK(states.count == 1);
+  CHECK(meshStatesGet(&states, 3, 2, 1) == NULL);
+  meshStatesRemove(&states, 1, 2, 3);
+  CHECK(states.count == 0);
+
+  size_t count = 0;
+  for (int y = TEST_MIN; y < TEST_MAX; y++) {
+    for (int z = TEST_MIN; z < TEST_MAX; z++) {
+      for (int x = TEST_MIN; x < TEST_MAX; x++) {
+        meshStatesAdd(&states, x, y, z)->drawId = drawIdFor(x, y, z);
+        count++;
+      }
+    }
+  }
+  CHECK(states.count == count);
+  failures += checkStates(&states, false);
+
+  // Removing every other one leaves the rest findable, whatever removal
+  // shifted around in the table
+  for (int y = TEST_MIN; y < TEST_MAX; y++) {
+    for (int z = TEST_MIN; z < TEST_MAX; z++) {
+      for (int x = TEST_MIN; x < TEST_MAX; x++) {
+        if (isOdd(x, y, z)) {
+          meshStatesRemove(&states, x, y, z);
+          count--;
+        }
+      }
+    }
+  }
+  CHECK(states.count == count);
+  failures += checkStates(&states, true);
+
+  freeMeshStates(&states);
+  return failures;
+}
@@ -0,0 +1,135 @@
+#include <string.h>
+#include "region.h"
+#include "tests.h"
+
+#define TEST_PATH "test-region.bin"
+#define TEST_CHUNKS 4
+
+// Different blocks in each chunk, from a single one up to more than a
+// palette holds, and different again in each version
+static void fillPattern(Chunk *chunk, int index, uint32_t version) {
+  static const int distinct[TEST_CHUNKS] = {1, 2, 16, 300};
+  BlockId blocks[CHUNK_VOLUME];
+  for (int i = 0; i < CHUNK_VOLUME; i++) {
+    blocks[i] = (BlockId)(1 + (i * 7 + version) % distinct[index]);
+  }
+  chunkSetBlocks(chunk, blocks);
+}
+
+static bool saveVersion(Region *region, uint32_t version) {
+  bool ok = true;
+  for (int i = 0; i < TEST_CHUNKS; i++) {
+    Chunk *chunk = createChunk(i, i & 1, 0);
+    fillPattern(chunk, i, version);
+    ok = ok && regionSaveChunk(region, chunk, REGION_COMPRESS_NONE);
+    destroyChunk(chunk);
+  }
+  return ok && regionFlush(region);
+}
+
+// Every chunk loads back whole with the blocks it had in this version
+static int checkVersion(Region *region, uint32_t version, const char *stage) {
+  int failures = 0;
+  Chunk *expected = createChunk(0, 0, 0);
+  BlockId blocks[CHUNK_VOLUME], expectedBlocks[CHUNK_VOLUME];
+  for (int i = 0; i < TEST_CHUNKS; i++) {
+    Chunk *loaded = regionLoadChunk(region, i, i & 1, 0);
+    CHECK(loaded != NULL);
+    if (loaded == NULL) {
+      continue;
+    }
+
+    fillPattern(expected, i, version);
+    chunkGetBlocks(loaded, blocks);
+    chunkGetBlocks(expected, expectedBlocks);
+    CHECK(memcmp(blocks, expectedBlocks, sizeof(blocks)) == 0);
+    CHECK(!loaded->modified);
+    destroyChunk(loaded);
+  }
+  CHECK(!regionHasChunk(region, 0, 0, 1));
+  CHECK(regionLoadChunk(region, 0, 0, 1) == NULL);
+  destroyChunk(expected);
+
+  if (failures > 0) {
+    printf("  %s, version %u\n", stage, version);
+  }
+  return failures;
+}
+
+// Overwrites part of a header copy, as if power went out while writing it
+static bool tearHeader(int slot) {
+  FILE *file = fopen(TEST_PATH, "r+b");
+  if (file == NULL) {
+    return false;
+  }
+  char garbage[512];
+  memset(garbage, 0x5a, sizeof(garbage));
+  bool ok = fseek(file, (long)slot * REGION_HEADER_SIZE + 1024, SEEK_SET) ==
+                0 &&
+            fwrite(garbage, sizeof(garbage), 1, file) == 1;
+  fclose(file);
+  return ok;
+}
+
+int testRegionFiles(void) {
+  int failures = 0;
+  remove(TEST_PATH);
+
+  // Two flushes, so both header copies hold a generation
+  Region *region = openRegion(TEST_PATH, 0, 0, 0);
+  CHECK(region != NULL);
+  if (region == NULL) {
+    return failures;
+  }
+  CHECK(saveVersion(region, 1));
+  CHECK(saveVersion(region, 2));
+  failures += checkVersion(region, 2, "saved");
+  int newest = region->headerSlot;
+  closeRegion(region);
+
+  region = openRegion(TEST_PATH, 0, 0, 0);
+  CHECK(region != NULL);
+  if (region == NULL) {
+    return failures;
+  }
+  CHECK(region->headerSlot == newest);
+  failures += checkVersion(region, 2, "reopened");
+  closeRegion(region);
+
+  // A torn newest header falls back to the older copy and the last flush
+  // is lost, but nothing before it
+  CHECK(tearHeader(newest));
+  region = openRegion(TEST_PATH, 0, 0, 0);
+  CHECK(region != NULL);
+  if (region == NULL) {
+    remove(TEST_PATH);
+    return failures;
+  }
+  CHECK(region->headerSlot == 1 - newest);
+  failures += checkVersion(region, 1, "torn header");
+
+  // Compacting drops the chunks only the torn header referred to
+  CHECK(regionCompact(region));
+  CHECK(regionFileBytes(region) ==
+        2 * REGION_HEADER_SIZE + regionLiveBytes(region));
+  failures += checkVersion(region, 1, "compacted");
+  closeRegion(region);
+
+  region = openRegion(TEST_PATH, 0, 0, 0);
+  CHECK(region != NULL);
+  if (region != NULL) {
+    failures += checkVersion(region, 1, "reopened after compacting");
+    closeRegion(region);
+  }
+
+  // With both copies torn there is nothing left to trust
+  CHECK(tearHeader(0) && tearHeader(1));
+  region = openRegion(TEST_PATH, 0, 0, 0);
+  CHECK(region == NULL);
+  if (region != NULL) {
+    closeRegion(region);
+  }
+
+  remove(TEST_PATH);
+  return failures;
+}
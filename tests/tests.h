@@ -0,0 +1,22 @@
+#ifndef TESTS_H
+#define TESTS_H
+
+#include <stdio.h>
+
+// Counts a failure in the enclosing function's failures and says where.
+// Tests return how many checks failed
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      printf("  %s:%d: %s\n", __FILE__, __LINE__, #condition);                 \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+int testMeshStates(void);
+int testChunkPalette(void);
+int testRegionFiles(void);
+int testVertexRoundTrip(void);
+int testWorldBlocks(void);
+
+#endif
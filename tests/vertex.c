@@ -0,0 +1,64 @@
+#include "block.h"
+#include "chunk.h"
+#include "tests.h"
+#include "vertex.h"
+
+// Checks every field came back, printing the vertex the first time one
+// doesn't so a broken shift isn't reported millions of times
+static int checkRoundTrip(const VertexFields *fields) {
+  VertexFields back = unpackVertex(packVertex(fields));
+  int failures = 0;
+  CHECK(back.x == fields->x);
+  CHECK(back.y == fields->y);
+  CHECK(back.z == fields->z);
+  CHECK(back.normal == fields->normal);
+  CHECK(back.ao == fields->ao);
+  CHECK(back.skyLight == fields->skyLight);
+  CHECK(back.blockLight == fields->blockLight);
+  CHECK(back.tile == fields->tile);
+  if (failures > 0) {
+    printf("  packing %d %d %d, normal %d, ao %d, light %d %d, tile %d\n",
+           fields->x, fields->y, fields->z, fields->normal, fields->ao,
+           fields->skyLight, fields->blockLight, fields->tile);
+  }
+  return failures;
+}
+
+int testVertexRoundTrip(void) {
+  // Every corner, normal and ao value, with the light and tile varying
+  // along with them so neighbouring fields aren't always zero
+  VertexFields fields;
+  int n = 0;
+  for (fields.y = 0; fields.y <= CHUNK_SIZE; fields.y++) {
+    for (fields.z = 0; fields.z <= CHUNK_SIZE; fields.z++) {
+      for (fields.x = 0; fields.x <= CHUNK_SIZE; fields.x++) {
+        for (fields.normal = 0; fields.normal < FACE_COUNT; fields.normal++) {
+          for (fields.ao = 0; fields.ao <= 3; fields.ao++, n++) {
+            fields.skyLight = n & 15;
+            fields.blockLight = 15 - (n >> 4 & 15);
+            fields.tile = (int)(((uint32_t)n * 40503u) & 0xffffu);
+            if (checkRoundTrip(&fields) > 0) {
+              return 1;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Every tile with every pair of light levels, from a full corner
+  fields.x = fields.y = fields.z = CHUNK_SIZE;
+  fields.normal = FACE_COUNT - 1;
+  fields.ao = 3;
+  for (fields.tile = 0; fields.tile <= 0xffff; fields.tile++) {
+    for (fields.skyLight = 0; fields.skyLight <= 15; fields.skyLight++) {
+      for (fields.blockLight = 0; fields.blockLight <= 15;
+           fields.blockLight++) {
+        if (checkRoundTrip(&fields) > 0) {
+          return 1;
+        }
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,111 @@
+#include "tests.h"
+#include "world.h"
+
+// Blocks from -40 to 39 on every axis, crossing six chunks each way with
+// the origin and the negative chunks in the middle
+#define TEST_MIN -40
+#define TEST_MAX 40
+
+static BlockId pattern(int x, int y, int z) {
+  uint32_t h = (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u ^
+               (uint32_t)z * 83492791u;
+  return (BlockId)(1 + h % (BLOCK_COUNT - 1));
+}
+
+static bool isHole(int x, int y, int z) { return (x + y + z) % 7 == 0; }
+
+static bool isOddChunk(int cx, int cy, int cz) { return (cx + cy + cz) & 1; }
+
+// Every block reads back as the pattern, or air where holes were cut or
+// the odd chunks were removed. Stops at the first one that doesn't
+static int checkPattern(const World *world, bool holes, bool removed) {
+  int failures = 0;
+  for (int y = TEST_MIN; y < TEST_MAX; y++) {
+    for (int z = TEST_MIN; z < TEST_MAX; z++) {
+      for (int x = TEST_MIN; x < TEST_MAX; x++) {
+        int cx = WORLD_TO_CHUNK(x), cy = WORLD_TO_CHUNK(y),
+            cz = WORLD_TO_CHUNK(z);
+        bool gone = removed && isOddChunk(cx, cy, cz);
+        bool air = gone || (holes && isHole(x, y, z));
+        BlockId expected = air ? BLOCK_AIR : pattern(x, y, z);
+        if (worldGetBlock(world, x, y, z) != expected ||
+            (gone && worldGetChunk(world, cx, cy, cz) != NULL)) {
+          printf("  block %d %d %d\n", x, y, z);
+          CHECK(worldGetBlock(world, x, y, z) == expected);
+          CHECK(!gone || worldGetChunk(world, cx, cy, cz) == NULL);
+          return failures;
+        }
+      }
+    }
+  }
+  return failures;
+}
+
+int testWorldBlocks(void) {
+  int failures = 0;
+  World *world = createWorld();
+  int from = WORLD_TO_CHUNK(TEST_MIN), to = WORLD_TO_CHUNK(TEST_MAX - 1);
+  size_t chunkCount = (size_t)(to - from + 1) * (to - from + 1) *
+                      (to - from + 1);
+
+  for (int y = TEST_MIN; y < TEST_MAX; y++) {
+    for (int z = TEST_MIN; z < TEST_MAX; z++) {
+      for (int x = TEST_MIN; x < TEST_MAX; x++) {
+        worldSetBlock(world, x, y, z, pattern(x, y, z));
+      }
+    }
+  }
+  CHECK(world->chunkCount == chunkCount);
+  failures += checkPattern(world, false, false);
+
+  // Outside what was set is air, and reading it creates nothing
+  CHECK(worldGetBlock(world, TEST_MAX + CHUNK_SIZE, 0, 0) == BLOCK_AIR);
+  CHECK(worldGetBlock(world, 0, TEST_MIN - CHUNK_SIZE, 0) == BLOCK_AIR);
+  CHECK(worldGetChunk(world, to + 1, 0, 0) == NULL);
+  CHECK(world->chunkCount == chunkCount);
+
+  // Blocks land in the chunk their coordinates round down to
+  Chunk *chunk = worldGetChunk(world, -1, -1, -1);
+  CHECK(chunk != NULL);
+  if (chunk != NULL) {
+    CHECK(chunkGetBlock(chunk, CHUNK_MASK, CHUNK_MASK, CHUNK_MASK) ==
+          pattern(-1, -1, -1));
+    CHECK(chunkGetBlock(chunk, 0, 0, 0) ==
+          pattern(-CHUNK_SIZE, -CHUNK_SIZE, -CHUNK_SIZE));
+  }
+
+  // Air goes into chunks that exist
+  for (int y = TEST_MIN; y < TEST_MAX; y++) {
+    for (int z = TEST_MIN; z < TEST_MAX; z++) {
+      for (int x = TEST_MIN; x < TEST_MAX; x++) {
+        if (isHole(x, y, z)) {
+          worldSetBlock(world, x, y, z, BLOCK_AIR);
+        }
+      }
+    }
+  }
+  failures += checkPattern(world, true, false);
+
+  // Taking out every other chunk leaves the rest findable, whatever
+  // removal shifted around in the table
+  size_t removed = 0;
+  for (int cy = from; cy <= to; cy++) {
+    for (int cz = from; cz <= to; cz++) {
+      for (int cx = from; cx <= to; cx++) {
+        if (isOddChunk(cx, cy, cz)) {
+          Chunk *taken = worldRemoveChunk(world, cx, cy, cz);
+          CHECK(taken != NULL && taken->x == cx && taken->y == cy &&
+                taken->z == cz);
+          destroyChunk(taken);
+          removed++;
+        }
+      }
+    }
+  }
+  CHECK(world->chunkCount == chunkCount - removed);
+  CHECK(worldRemoveChunk(world, from, from, from) == NULL);
+  failures += checkPattern(world, true, true);
+
+  destroyWorld(world);
+  return failures;
+}